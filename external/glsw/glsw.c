@@ -100,6 +100,24 @@ int glswShutdown()
     return 1;
 }
 
+int glswReloadEffects()
+{
+    glswContext* gc = __glsw__Context;
+
+    if (!gc)
+    {
+        return 0;
+    }
+
+    // Effect files are read again by the next glswGetShader
+    __glsw__FreeList(gc->ShaderMap);
+    __glsw__FreeList(gc->LoadedEffects);
+    gc->ShaderMap = 0;
+    gc->LoadedEffects = 0;
+
+    return 1;
+}
+
 int glswSetPath(const char* pathPrefix, const char* pathSuffix)
 {
     glswContext* gc = __glsw__Context;
@@ -9,26 +9,53 @@ layout (location = 2) in vec2 inTexcoords;
 out vec2 vTexcoords;
 out vec3 vNormalW;
 
-uniform vec3 uCameraPosition;
-uniform mat4 uModelToProj;
+#include "FrameUniforms.glsli"
+#include "SkyRay.glsli"
 
 void main()
 {
+#if FULLSCREEN_ENABLE
+    gl_Position = vec4(inPosition.xy, 1.0, 1.0);
+    vNormalW = -ComputeFullscreenRay(inPosition.xy);
+#else
     vec4 position = uModelToProj*vec4(inPosition + uCameraPosition, 1.0);
     gl_Position = position;
-    vTexcoords = inTexcoords;
     vNormalW = -inPosition;
+#endif
+    vTexcoords = inTexcoords;
 }
 
 -- Fragment
 
+// Defaults, ProgramPermutation defines these per variant
+#ifndef SUN_ENABLE
 #define SUN_ENABLE 1
+#endif
+// Sun disc alone, drawn at full resolution over a reduced resolution sky
+#ifndef SKY_ENABLE
+#define SKY_ENABLE 1
+#endif
+#ifndef CHAPMAN_ENABLE
+#define CHAPMAN_ENABLE 1
+#endif
 // Experimental:
+#ifndef RAYLEIGH_SCTR_ONLY_ENABLE
 #define RAYLEIGH_SCTR_ONLY_ENABLE 0
+#endif
+#ifndef NUM_SCATTERING_SAMPLES
+#define NUM_SCATTERING_SAMPLES 16
+#endif
+// Tone mapped and encoded here when the sky is drawn straight to the backbuffer
+#ifndef TONEMAP_ENABLE
+#define TONEMAP_ENABLE 0
+#endif
 
 #include "Common.glsli"
 #include "Math.glsli"
 #include "PhaseFunctions.glsli"
+#if TONEMAP_ENABLE
+#include "ToneMappingUtility.glsli"
+#endif
 
 // IN
 in vec2 vTexcoords;
@@ -37,7 +64,7 @@ in vec3 vNormalW;
 // OUT
 out vec4 fragColor;
 
-const int numScatteringSamples = 16;
+const int numScatteringSamples = NUM_SCATTERING_SAMPLES;
 const int numLightSamples = 8;
 const int numSamples = 4;
 
@@ -66,20 +93,15 @@ const float mOzoneMass = mOzoneMassParams.x;
 // Ozone scattering with wavelength (680nm, 550nm, 440nm) and 293K
 const vec3 mOzoneScatteringCoeff = vec3(1.36820899679147, 3.31405330400124, 0.13601728252538);
 
-uniform bool uChapman;
+#include "FrameUniforms.glsli"
+
 uniform float uEarthRadius; 
 uniform float uAtmosphereRadius;
 uniform float uAspect;
 uniform float uAngle;
-uniform float uAltitude;
-uniform float uTurbidity;
-uniform float uSunRadius;
-uniform float uSunRadiance;
 uniform vec2 uInvResolution;
 uniform vec3 uEarthCenter;
-uniform vec3 uSunDir;
 uniform vec3 uSunIntensity;
-uniform vec3 uCameraPosition;
 uniform vec3 betaR0; // vec3(5.8e-6, 13.5e-6, 33.1e-6);
 uniform vec3 betaM0; // vec3(21e-6);
 // [Hillaire16]
@@ -107,7 +129,7 @@ float ChapmanApproximation(float X, float h, float coschi)
 
 bool opticalDepthLight(vec3 s, vec2 t, out float rayleigh, out float mie)
 {
-	if (!uChapman)
+#if !CHAPMAN_ENABLE
 	{
 		// start from position 's'
 		float lmin = 0.0;
@@ -127,7 +149,7 @@ bool opticalDepthLight(vec3 s, vec2 t, out float rayleigh, out float mie)
 		mie = m;
 		return true;
 	}
-	else
+#else
 	{
 		// approximate optical depth with chapman function  
 		float x = length(s);
@@ -142,6 +164,7 @@ bool opticalDepthLight(vec3 s, vec2 t, out float rayleigh, out float mie)
 		mie = Hm * ChapmanApproximation(Xm, hm, coschi);
 		return true;
 	}
+#endif
 }
 
 // [ScratchPixel]
@@ -199,7 +222,7 @@ vec3 computeIncidentLight(vec3 pos, vec3 dir, vec3 intensity, float tmin, float
             continue;
         
     #if RAYLEIGH_SCTR_ONLY_ENABLE
-        // But, in 'Time of day.conf' state that ozone also has small scattering factor
+        // But, src/ScatteringParams.cpp states that ozone also has small scattering factor
         // And use rayleigh beta only
         vec3 lambda = betaR0 + betaM0 + mOzoneScatteringCoeff * mOzoneMass;
         vec3 tau = lambda * (opticalDepthR + opticalDepthLightR);
@@ -251,13 +274,21 @@ void main()
     float tmax = inf;
     if (t.y > 0) tmax = max(0.0, t.x);
 
+#if SKY_ENABLE
     vec3 sunIntensity = vec3(uSunRadiance);
     vec3 color = computeIncidentLight(cameraPos, dir, sunIntensity, 0.0, tmax);
+#else
+    vec3 color = vec3(0.0);
+#endif
 
 #if SUN_ENABLE
     float phaseTheta = dot(dir, uSunDir);
 	float intersectionTest = float(t.x < 0.0 && t.y < 0.0);
     float angle = saturate((1 - phaseTheta) * sqrt(abs(uSunDir.y)) * uSunRadius);
+#if !SKY_ENABLE
+    if (angle >= 1.0 || intersectionTest == 0.0)
+        discard;
+#endif
     float cosAngle = cos(angle * PI * 0.5);
     float edge = ((angle >= 0.9) ? smoothstep(0.9, 1.0, angle) : 0.0);;
 
@@ -273,6 +304,9 @@ void main()
     color += limbDarkening;
 #endif
 
+#if TONEMAP_ENABLE
+    color = linear2srgb(ColorToneMapping(color));
+#endif
     fragColor = vec4(color, 1.0);
 }
 
@@ -16,8 +16,6 @@ void main()
 
 -- Fragment
 
-#define HDR_TONEMAP_OPERATOR 4
-
 #include "Common.glsli"
 #include "Math.glsli"
 #include "ToneMappingUtility.glsli"
@@ -25,6 +23,7 @@ void main()
 // IN
 in vec2 vTexcoords;
 uniform sampler2D uTexSource;
+uniform vec2 uTexScale;
 
 // OUT
 out vec3 fragColor;
@@ -32,7 +31,7 @@ out vec3 fragColor;
 // ----------------------------------------------------------------------------
 void main() 
 {
-    vec3 color = texture(uTexSource, vTexcoords).rgb;
+    vec3 color = texture(uTexSource, vTexcoords*uTexScale).rgb;
     color = ColorToneMapping(color);
     color = linear2srgb(color);
 
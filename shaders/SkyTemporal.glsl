@@ -0,0 +1,52 @@
+-- Vertex
+
+// IN
+layout (location = 0) in vec3 inPosition;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec2 inTexcoords;
+
+// Out
+out vec2 vTexcoords;
+
+void main()
+{
+	vTexcoords = inTexcoords;
+	gl_Position = vec4(inPosition, 1.0);
+}
+
+-- Fragment
+
+// IN
+in vec2 vTexcoords;
+uniform sampler2D uTexFresh;    // one in uInterleave pixels, drawn this frame
+uniform sampler2D uTexHistory;  // last frame
+uniform mat4 uReprojection;     // current clip space to the last frame, rotation only
+uniform vec2 uResolution;       // of the viewport
+uniform vec2 uFreshSize;        // of the fresh viewport
+uniform vec2 uHistoryScale;     // texture coordinates of the corner of the last viewport
+uniform vec2 uInterleave;
+uniform vec2 uOffset;           // of the fresh pixel in each uInterleave block
+
+// OUT
+layout (location = 0) out vec4 historyColor;
+layout (location = 1) out vec4 fragColor;
+
+// ----------------------------------------------------------------------------
+// The sky is at infinity, a pixel not drawn this frame is where its view direction
+// was last frame; directions that were off screen take the nearest fresh pixel
+void main()
+{
+    vec2 pixel = floor(gl_FragCoord.xy);
+    vec2 block = floor(pixel / uInterleave);
+    vec4 color = texelFetch(uTexFresh, ivec2(min(block, uFreshSize - 1.0)), 0);
+
+    if (any(notEqual(pixel - block * uInterleave, uOffset)))
+    {
+        vec4 previous = uReprojection * vec4(gl_FragCoord.xy / uResolution * 2.0 - 1.0, 1.0, 1.0);
+        vec2 uv = previous.xy / previous.w * 0.5 + 0.5;
+        if (previous.w > 0.0 && all(greaterThanEqual(uv, vec2(0.0))) && all(lessThanEqual(uv, vec2(1.0))))
+            color = texture(uTexHistory, uv * uHistoryScale);
+    }
+    historyColor = color;
+    fragColor = color;
+}
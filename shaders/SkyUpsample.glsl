@@ -0,0 +1,79 @@
+-- Vertex
+
+// IN
+layout (location = 0) in vec3 inPosition;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec2 inTexcoords;
+
+// Out
+out vec2 vTexcoords;
+
+void main()
+{
+	vTexcoords = inTexcoords;
+	gl_Position = vec4(inPosition, 1.0);
+}
+
+-- Fragment
+
+#include "Common.glsli"
+#include "Math.glsli"
+#include "FrameUniforms.glsli"
+
+// IN
+in vec2 vTexcoords;
+uniform sampler2D uTexSource;   // sky at reduced resolution
+uniform mat4 uInvViewProj;
+uniform vec2 uResolution;       // of the full resolution viewport
+uniform vec2 uSourceSize;       // of the reduced viewport, the texture may be larger
+uniform vec2 uDownsample;       // full resolution pixels per reduced one
+uniform float uHorizon;         // sine of the horizon elevation, below zero off the ground
+
+// OUT
+out vec4 fragColor;
+
+vec3 GetViewDirection(vec2 fragCoord)
+{
+    vec4 position = uInvViewProj * vec4(fragCoord / uResolution * 2.0 - 1.0, 1.0, 1.0);
+    return normalize(position.xyz / position.w - uCameraPosition);
+}
+
+// ----------------------------------------------------------------------------
+// Joint bilateral upsample guided by the view direction: of the four nearest texels
+// those across the horizon from the pixel are dropped, and those far in luminance from
+// the nearest texel are weighted down. The weight is relative, so the sun disc and its
+// limb darkening keep their edge inside the disc while not bleeding into the sky around it
+void main()
+{
+    vec2 p = gl_FragCoord.xy / uDownsample - 0.5;
+    vec2 base = floor(p);
+    vec2 f = p - base;
+    float side = sign(GetViewDirection(gl_FragCoord.xy).y - uHorizon);
+
+    vec4 colors[4];
+    vec2 texels[4];
+    for (int i = 0; i < 4; i++)
+    {
+        texels[i] = clamp(base + vec2(i & 1, i >> 1), vec2(0.0), uSourceSize - 1.0);
+        colors[i] = texelFetch(uTexSource, ivec2(texels[i]), 0);
+    }
+    ivec2 nearest = ivec2(step(0.5, f));
+    float reference = log2(luminance(colors[nearest.x + nearest.y * 2].rgb) + 1e-4);
+
+    vec4 sum = vec4(0.0);
+    float weights = 0.0;
+    for (int i = 0; i < 4; i++)
+    {
+        vec2 offset = vec2(i & 1, i >> 1);
+        vec2 bilinear = mix(1.0 - f, f, offset);
+        float weight = bilinear.x * bilinear.y;
+        float texelSide = sign(GetViewDirection((texels[i] + 0.5) * uDownsample).y - uHorizon);
+        weight *= texelSide == side ? 1.0 : 1e-3;
+        // An octave of luminance apart halves the weight
+        weight *= exp2(-abs(log2(luminance(colors[i].rgb) + 1e-4) - reference));
+
+        sum += colors[i] * weight;
+        weights += weight;
+    }
+    fragColor = sum / max(weights, 1e-8);
+}
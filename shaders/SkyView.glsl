@@ -0,0 +1,58 @@
+-- Vertex
+
+// IN
+layout (location = 0) in vec3 inPosition;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec2 inTexcoords;
+
+// Out
+out vec3 vDirection;
+
+#include "FrameUniforms.glsli"
+
+void main()
+{
+    gl_Position = uModelToProj*vec4(inPosition + uCameraPosition, 1.0);
+    vDirection = inPosition;
+}
+
+-- Fragment
+
+#include "Common.glsli"
+#include "Math.glsli"
+
+// IN
+in vec3 vDirection;
+
+// OUT
+out vec4 fragColor;
+
+#include "FrameUniforms.glsli"
+
+uniform float uSkyViewBlend;
+uniform sampler2D uSkyViewSamp0;
+uniform sampler2D uSkyViewSamp1;
+
+// Must match ComputeSkyViewDirection in SkyViewTable.cpp
+vec2 ComputeSkyViewCoord(vec3 dir, vec3 sunDir)
+{
+    float elevation = asin(clamp(dir.y, -1.0, 1.0));
+
+    // Azimuth relative to the sun, the sky is symmetric around the sun plane
+    vec2 sunH = length(sunDir.xz) > 1e-4 ? normalize(sunDir.xz) : vec2(0.0, -1.0);
+    vec2 dirH = length(dir.xz) > 1e-4 ? normalize(dir.xz) : sunH;
+    float azimuth = acos(clamp(dot(dirH, sunH), -1.0, 1.0));
+
+    float u = azimuth / PI;
+    float v = 0.5 + 0.5 * sign(elevation) * sqrt(abs(elevation) / (PI * 0.5));
+    return vec2(u, v);
+}
+
+void main()
+{
+    vec3 dir = normalize(vDirection);
+    vec2 coord = ComputeSkyViewCoord(dir, uSunDir);
+    vec3 color0 = textureLod(uSkyViewSamp0, coord, 0).rgb;
+    vec3 color1 = textureLod(uSkyViewSamp1, coord, 0).rgb;
+    fragColor = vec4(mix(color0, color1, uSkyViewBlend), 1.0);
+}
@@ -80,7 +80,7 @@ glm::vec4 Atmosphere::computeIncidentLight(const glm::vec3& pos, const glm::vec3
 	return glm::vec4(SunIntensity * color, 1.f);
 }
 
-void Atmosphere::renderSkyDome(std::vector<glm::vec4>& image, int width, int height) const
+bool Atmosphere::renderSkyDome(std::vector<glm::vec4>& image, int width, int height, const std::atomic<uint32_t>* generation, uint32_t current) const
 {
     const float aspect = (float)width / height;
     const float fov = 45.f;
@@ -93,6 +93,10 @@ void Atmosphere::renderSkyDome(std::vector<glm::vec4>& image, int width, int hei
 	for (int y = 0; y < height; y++)
 	for (int x = 0; x < width; x++)
 	{
+        // Cancellation is checked once per row
+        if (x == 0 && generation && generation->load(std::memory_order_relaxed) != current)
+            return false;
+
         float rayx = (2 * x / float(width) - 1) * aspect * angle;
         float rayy = (2 * y / float(height) - 1) * angle;
         glm::vec3 dir = glm::normalize(glm::vec3(rayx, rayy, -1));
@@ -101,4 +105,5 @@ void Atmosphere::renderSkyDome(std::vector<glm::vec4>& image, int width, int hei
         if (t.y > 0) tmax = std::max(0.f, t.x);
         image[y*width + x] += computeIncidentLight(cameraPos, dir, 0.f, tmax);
 	}
+	return true;
 }
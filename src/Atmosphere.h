@@ -1,14 +1,18 @@
 #pragma once
 
 #include <vector>
+#include <atomic>
 #include <glm/glm.hpp>
 
+glm::vec2 ComputeRaySphereIntersection(glm::vec3 pos, glm::vec3 dir, glm::vec3 c, float r);
+
 struct Atmosphere
 {
 public:
 	Atmosphere(glm::vec3 sunDir);
 	glm::vec4 computeIncidentLight(const glm::vec3& orig, const glm::vec3& dir, float tmin, float tmax) const; 
-	void renderSkyDome(std::vector<glm::vec4>& image, int width, int height) const;
+	// Returns false if '*generation' moved away from 'current' before the image was complete
+	bool renderSkyDome(std::vector<glm::vec4>& image, int width, int height, const std::atomic<uint32_t>* generation = nullptr, uint32_t current = 0) const;
 
 	float m_Hr = 7994; // Rayleigh scale height
     float m_Hm = 1200; // Mie scale height
@@ -0,0 +1,62 @@
+#include <DynamicResolution.h>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace
+{
+    const float kSmoothing = 0.1f;
+    // Over budget reacts sooner than under it, a slow frame is worse than a soft one
+    const float kUpperBand = 1.05f;
+    const float kLowerBand = 0.8f;
+    // Scales are kept on a grid so small corrections don't reallocate the pixels for nothing
+    const float kScaleStep = 1.f / 16.f;
+}
+
+DynamicResolution::DynamicResolution() noexcept :
+    m_Budget(4.f),
+    m_MinScale(0.5f),
+    m_MaxScale(1.f)
+{
+    reset();
+}
+
+void DynamicResolution::setBounds(float minScale, float maxScale) noexcept
+{
+    assert(minScale > 0.f && minScale <= maxScale);
+    m_MinScale = minScale;
+    m_MaxScale = maxScale;
+    m_Scale = std::min(std::max(m_Scale, m_MinScale), m_MaxScale);
+}
+
+void DynamicResolution::reset() noexcept
+{
+    m_Scale = m_MaxScale;
+    m_Time = 0.f;
+    m_Hold = 0;
+}
+
+bool DynamicResolution::update(float gpuTime) noexcept
+{
+    m_Time = m_Time > 0.f ? m_Time + (gpuTime - m_Time) * kSmoothing : gpuTime;
+    if (m_Hold > 0)
+    {
+        m_Hold--;
+        return false;
+    }
+    if (m_Time <= 0.f || (m_Time < m_Budget * kUpperBand && m_Time > m_Budget * kLowerBand))
+        return false;
+
+    // The cost goes with the area, the square of the scale
+    float scale = m_Scale * std::sqrt(m_Budget / m_Time);
+    scale = std::floor(scale / kScaleStep + 0.5f) * kScaleStep;
+    scale = std::min(std::max(scale, m_MinScale), m_MaxScale);
+    if (scale == m_Scale)
+        return false;
+
+    // Predict the time at the new scale until it is measured
+    m_Time *= (scale * scale) / (m_Scale * m_Scale);
+    m_Scale = scale;
+    m_Hold = kHoldFrames;
+    return true;
+}
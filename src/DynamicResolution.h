@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+
+// Resolution scale holding the GPU time of the sky under a budget.
+// The measured time is smoothed and compared to the budget with a dead band; outside of it
+// the scale moves in the ratio of the time, assuming the cost follows the pixel count, and
+// is then held for kHoldFrames so the new scale is measured before the next move
+class DynamicResolution
+{
+public:
+
+    DynamicResolution() noexcept;
+
+    // ms
+    void setBudget(float budget) noexcept { m_Budget = budget; }
+    void setBounds(float minScale, float maxScale) noexcept;
+    // Back to the largest scale, the measures so far no longer apply
+    void reset() noexcept;
+
+    // GPU time of a frame drawn at the current scale, true if the scale changed
+    bool update(float gpuTime) noexcept;
+
+    float getScale() const noexcept { return m_Scale; }
+    float getTime() const noexcept { return m_Time; }
+    float getBudget() const noexcept { return m_Budget; }
+
+private:
+
+    static const uint32_t kHoldFrames = 30;
+
+    float m_Budget;
+    float m_MinScale;
+    float m_MaxScale;
+    float m_Scale;
+    float m_Time;           // smoothed
+    uint32_t m_Hold;
+};
@@ -0,0 +1,342 @@
+#include <Ephemeris.h>
+#include <glm/gtc/constants.hpp>
+#include <cmath>
+
+// Sun: low precision formulas of the Astronomical Almanac
+// Moon: Paul Schlyter, "Computing planetary positions", with the main perturbation terms
+// http://www.stjarnhimlen.se/comp/ppcomp.html
+//
+// Every angle of both models is linear in time, the non linear parts (equation of center,
+// perturbations) stay below a few degrees. The batch functions therefore rotate the phasors
+// of the linear angles by a constant step between evenly spaced dates and expand the small
+// corrections in series, which keeps the inner loop free of trigonometric calls.
+
+namespace
+{
+    const double kDegree = glm::pi<double>() / 180.0;
+    const double kJ2000 = 2451545.0;
+    const double kSchlyterEpoch = 2451543.5;
+    const double kDeltaT = 69.0 / 86400.0; // TT - UT, days
+
+    // Reseed the phasors periodically, and whenever the spacing of the dates changes by more than this
+    const size_t kReseedInterval = 1024;
+    const double kStepTolerance = 1e-6; // days, 0.02 arc-minute of sidereal rotation
+
+    // cos + i sin, sums of angles become products
+    struct Phasor
+    {
+        double c, s;
+
+        Phasor operator*(const Phasor& p) const { return { c*p.c - s*p.s, s*p.c + c*p.s }; }
+        Phasor operator/(const Phasor& p) const { return { c*p.c + s*p.s, s*p.c - c*p.s }; }
+    };
+
+    Phasor MakePhasor(double degrees)
+    {
+        double radians = std::fmod(degrees, 360.0) * kDegree;
+        return { std::cos(radians), std::sin(radians) };
+    }
+
+    // Series expansion for |x| < 0.1 rad, error below 1e-12
+    Phasor MakeSmallPhasor(double x)
+    {
+        const double x2 = x * x;
+        const double c = 1.0 + x2 * (-1.0 / 2.0 + x2 * (1.0 / 24.0 - x2 * (1.0 / 720.0)));
+        const double s = x * (1.0 + x2 * (-1.0 / 6.0 + x2 * (1.0 / 120.0 - x2 * (1.0 / 5040.0))));
+        return { c, s };
+    }
+
+    // offset + rate * (julianDate - J2000), degrees
+    struct LinearAngle
+    {
+        double offset, rate;
+
+        double evaluate(double julianDate) const { return offset + rate * (julianDate - kJ2000); }
+    };
+
+    // Angle given for days since 'epoch' in terrestrial time
+    LinearAngle MakeAngleTT(double offset, double rate, double epoch)
+    {
+        return { offset + rate * (kJ2000 + kDeltaT - epoch), rate };
+    }
+
+    LinearAngle operator+(const LinearAngle& a, const LinearAngle& b) { return { a.offset + b.offset, a.rate + b.rate }; }
+    LinearAngle operator-(const LinearAngle& a, const LinearAngle& b) { return { a.offset - b.offset, a.rate - b.rate }; }
+
+    // Phasors of a set of linear angles, advanced by a fixed step
+    template<size_t N>
+    class PhasorSequence
+    {
+    public:
+        PhasorSequence(const LinearAngle (&angles)[N]) : m_Angles(angles) {}
+
+        void seed(double julianDate, double step)
+        {
+            for (size_t k = 0; k < N; k++)
+            {
+                m_Phasors[k] = MakePhasor(m_Angles[k].evaluate(julianDate));
+                m_Steps[k] = MakePhasor(m_Angles[k].rate * step);
+            }
+        }
+
+        void advance()
+        {
+            for (size_t k = 0; k < N; k++)
+                m_Phasors[k] = m_Phasors[k] * m_Steps[k];
+        }
+
+        const Phasor& operator[](size_t k) const { return m_Phasors[k]; }
+
+    private:
+        const LinearAngle (&m_Angles)[N];
+        Phasor m_Phasors[N];
+        Phasor m_Steps[N];
+    };
+
+    // Runs 'evaluate(index, phasors)' over the dates, reseeding 'sequence' when the spacing changes
+    template<size_t N, typename Function>
+    void ForEachDate(const double* julianDates, size_t count, PhasorSequence<N>& sequence, Function evaluate)
+    {
+        size_t first = 0;
+        double step = 0.0;
+        for (size_t i = 0; i < count; i++)
+        {
+            bool bReseed = (i - first) % kReseedInterval == 0;
+            if (!bReseed)
+            {
+                sequence.advance();
+                bReseed = std::abs(julianDates[i] - (julianDates[first] + step * (i - first))) > kStepTolerance;
+            }
+            if (bReseed)
+            {
+                first = i;
+                step = (i + 1 < count) ? julianDates[i + 1] - julianDates[i] : 0.0;
+                sequence.seed(julianDates[i], step);
+            }
+            evaluate(i, sequence);
+        }
+    }
+
+    // Local sidereal time is 'lst' at the observer's longitude
+    struct HorizonFrame
+    {
+        double sinLat, cosLat;
+
+        HorizonFrame(double latitude) :
+            sinLat(std::sin(latitude * kDegree)),
+            cosLat(std::cos(latitude * kDegree))
+        {
+        }
+
+        // Equatorial (X equinox, Y, Z pole) to world, see ComputeEquatorialToHorizon
+        glm::dvec3 transform(const Phasor& lst, double X, double Y, double Z) const
+        {
+            double a = lst.c * X + lst.s * Y; // toward the meridian, on the equator
+            double c = lst.s * X - lst.c * Y; // toward the west
+            return glm::dvec3(-c, cosLat * a + sinLat * Z, sinLat * a - cosLat * Z);
+        }
+    };
+
+    // Greenwich mean sidereal time
+    const LinearAngle kSiderealTime = { 280.46061837, 360.98564736629 };
+
+    LinearAngle MakeLocalSiderealTime(double longitude)
+    {
+        return { kSiderealTime.offset + longitude, kSiderealTime.rate };
+    }
+
+    // Obliquity of the ecliptic, 'reference' is the phasor at 'referenceDate'
+    const double kObliquityRate = -3.563e-7;
+
+    Phasor ComputeObliquity(double julianDate)
+    {
+        return MakePhasor(23.4393 + kObliquityRate * (julianDate - kSchlyterEpoch));
+    }
+
+    Phasor ComputeObliquity(const Phasor& reference, double referenceDate, double julianDate)
+    {
+        return reference * MakeSmallPhasor(kObliquityRate * (julianDate - referenceDate) * kDegree);
+    }
+
+    // Sun
+    enum { kSunLST = 0, kSunL, kSunG, kSunCount };
+
+    void ComputeSunAngles(double longitude, LinearAngle (&angles)[kSunCount])
+    {
+        angles[kSunLST] = MakeLocalSiderealTime(longitude);
+        angles[kSunL] = MakeAngleTT(280.460, 0.9856474, kJ2000);
+        angles[kSunG] = MakeAngleTT(357.528, 0.9856003, kJ2000);
+    }
+
+    template<typename Sequence>
+    glm::vec3 ComputeSun(const Sequence& p, const Phasor& obliquity, const HorizonFrame& frame)
+    {
+        const Phasor& g = p[kSunG];
+        Phasor lambda = p[kSunL] * MakeSmallPhasor((1.915 * g.s + 0.040 * g.s * g.c) * kDegree);
+        return glm::vec3(frame.transform(p[kSunLST], lambda.c, obliquity.c * lambda.s, obliquity.s * lambda.s));
+    }
+
+    // Moon
+    enum { kMoonLST = 0, kMoonN, kMoonW, kMoonM, kMoonMs, kMoonD, kMoonF, kMoonCount };
+
+    void ComputeMoonAngles(double longitude, LinearAngle (&angles)[kMoonCount])
+    {
+        const LinearAngle N = MakeAngleTT(125.1228, -0.0529538083, kSchlyterEpoch);
+        const LinearAngle w = MakeAngleTT(318.0634, 0.1643573223, kSchlyterEpoch);
+        const LinearAngle M = MakeAngleTT(115.3654, 13.0649929509, kSchlyterEpoch);
+        const LinearAngle Ms = MakeAngleTT(356.0470, 0.9856002585, kSchlyterEpoch);
+        const LinearAngle Ls = Ms + MakeAngleTT(282.9404, 4.70935e-5, kSchlyterEpoch);
+        const LinearAngle Lm = N + w + M;
+
+        angles[kMoonLST] = MakeLocalSiderealTime(longitude);
+        angles[kMoonN] = N;
+        angles[kMoonW] = w;
+        angles[kMoonM] = M;
+        angles[kMoonMs] = Ms;
+        angles[kMoonD] = Lm - Ls;
+        angles[kMoonF] = Lm - N;
+    }
+
+    template<typename Sequence>
+    glm::vec3 ComputeMoon(const Sequence& p, const Phasor& obliquity, const HorizonFrame& frame)
+    {
+        const double a = 60.2666; // earth radii
+        const double e = 0.054900;
+        const double cosI = 0.99597022, sinI = 0.08968344; // inclination 5.1454
+
+        // Kepler equation relative to M, one Newton step is enough for e = 0.055
+        const Phasor& pM = p[kMoonM];
+        double dE = e * pM.s * (1.0 + e * pM.c);
+        Phasor pE = pM * MakeSmallPhasor(dE);
+        dE -= (dE - e * pE.s) / (1.0 - e * pE.c);
+        pE = pM * MakeSmallPhasor(dE);
+
+        const double xv = a * (pE.c - e);
+        const double yv = a * std::sqrt(1.0 - e * e) * pE.s;
+        double r = std::sqrt(xv * xv + yv * yv);
+
+        // Direction in the ecliptic frame
+        const Phasor& pN = p[kMoonN];
+        Phasor vw = Phasor{ xv / r, yv / r } * p[kMoonW];
+        const double xh = pN.c * vw.c - pN.s * vw.s * cosI;
+        const double yh = pN.s * vw.c + pN.c * vw.s * cosI;
+        const double zh = vw.s * sinI;
+        const double rxy = std::sqrt(xh * xh + yh * yh);
+
+        // Perturbations
+        const Phasor& pMs = p[kMoonMs];
+        const Phasor& pD = p[kMoonD];
+        const Phasor& pF = p[kMoonF];
+        const Phasor p2D = pD * pD;
+
+        const double dLon =
+            - 1.274 * (pM / p2D).s
+            + 0.658 * p2D.s
+            - 0.186 * pMs.s
+            - 0.059 * (pM * pM / p2D).s
+            - 0.057 * (pM / p2D * pMs).s
+            + 0.053 * (pM * p2D).s
+            + 0.046 * (p2D / pMs).s
+            + 0.041 * (pM / pMs).s
+            - 0.035 * pD.s
+            - 0.031 * (pM * pMs).s
+            - 0.015 * (pF * pF / p2D).s
+            + 0.011 * (pM / (p2D * p2D)).s;
+        const double dLat =
+            - 0.173 * (pF / p2D).s
+            - 0.055 * (pM / pF / p2D).s
+            - 0.046 * (pM * pF / p2D).s
+            + 0.033 * (pF * p2D).s
+            + 0.017 * (pM * pM * pF).s;
+        r += - 0.58 * (pM / p2D).c - 0.46 * p2D.c;
+
+        Phasor lon = Phasor{ xh / rxy, yh / rxy } * MakeSmallPhasor(dLon * kDegree);
+        Phasor lat = Phasor{ rxy, zh } * MakeSmallPhasor(dLat * kDegree);
+
+        // Ecliptic to equatorial
+        const double xe = lat.c * lon.c;
+        const double ye = lat.c * lon.s;
+        const double ze = lat.s;
+
+        // Topocentric position, observer one earth radius above the center
+        glm::dvec3 position = frame.transform(p[kMoonLST], xe, ye * obliquity.c - ze * obliquity.s, ye * obliquity.s + ze * obliquity.c) * r;
+        return glm::vec3(glm::normalize(position - glm::dvec3(0.0, 1.0, 0.0)));
+    }
+}
+
+double ComputeJulianDate(int year, int month, int day, double hours)
+{
+    // Gregorian calendar, Meeus chapter 7
+    if (month <= 2)
+        year -= 1, month += 12;
+    const int A = year / 100;
+    const int B = 2 - A + A / 4;
+    return std::floor(365.25 * (year + 4716)) + std::floor(30.6001 * (month + 1)) + day + B - 1524.5 + hours / 24.0;
+}
+
+double ComputeJulianDateFromUnixTime(double seconds)
+{
+    return seconds / 86400.0 + 2440587.5;
+}
+
+double ComputeSiderealTime(double julianDate)
+{
+    return std::fmod(kSiderealTime.evaluate(julianDate), 360.0);
+}
+
+glm::mat3 ComputeEquatorialToHorizon(double julianDate, double latitude, double longitude)
+{
+    // StarCatalogue stores (X, Z, -Y) of the equatorial frame
+    HorizonFrame frame(latitude);
+    Phasor lst = MakePhasor(MakeLocalSiderealTime(longitude).evaluate(julianDate));
+    glm::vec3 x(frame.transform(lst, 1.0, 0.0, 0.0));
+    glm::vec3 y(frame.transform(lst, 0.0, 0.0, 1.0));
+    glm::vec3 z(frame.transform(lst, 0.0, -1.0, 0.0));
+    return glm::mat3(x, y, z);
+}
+
+void ComputeSunDirections(const double* julianDates, size_t count, double latitude, double longitude, glm::vec3* directions)
+{
+    if (count == 0)
+        return;
+
+    LinearAngle angles[kSunCount];
+    ComputeSunAngles(longitude, angles);
+    PhasorSequence<kSunCount> sequence(angles);
+
+    const Phasor obliquity = ComputeObliquity(julianDates[0]);
+    const HorizonFrame frame(latitude);
+    ForEachDate(julianDates, count, sequence, [&](size_t i, const PhasorSequence<kSunCount>& p) {
+        directions[i] = ComputeSun(p, ComputeObliquity(obliquity, julianDates[0], julianDates[i]), frame);
+    });
+}
+
+void ComputeMoonDirections(const double* julianDates, size_t count, double latitude, double longitude, glm::vec3* directions)
+{
+    if (count == 0)
+        return;
+
+    LinearAngle angles[kMoonCount];
+    ComputeMoonAngles(longitude, angles);
+    PhasorSequence<kMoonCount> sequence(angles);
+
+    const Phasor obliquity = ComputeObliquity(julianDates[0]);
+    const HorizonFrame frame(latitude);
+    ForEachDate(julianDates, count, sequence, [&](size_t i, const PhasorSequence<kMoonCount>& p) {
+        directions[i] = ComputeMoon(p, ComputeObliquity(obliquity, julianDates[0], julianDates[i]), frame);
+    });
+}
+
+glm::vec3 ComputeSunDirection(double julianDate, double latitude, double longitude)
+{
+    glm::vec3 direction;
+    ComputeSunDirections(&julianDate, 1, latitude, longitude, &direction);
+    return direction;
+}
+
+glm::vec3 ComputeMoonDirection(double julianDate, double latitude, double longitude)
+{
+    glm::vec3 direction;
+    ComputeMoonDirections(&julianDate, 1, latitude, longitude, &direction);
+    return direction;
+}
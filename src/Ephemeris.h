@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <glm/glm.hpp>
+
+// Low precision sun and moon ephemeris (about 1 arc-minute for the sun, 2 for the moon)
+//
+// Dates are Julian dates in UT, latitude and longitude in degrees (east positive).
+// Directions are in the world horizon frame: y up, +x east, -z north.
+// Atmospheric refraction is not applied, the moon includes the topocentric parallax.
+
+double ComputeJulianDate(int year, int month, int day, double hours);
+double ComputeJulianDateFromUnixTime(double seconds);
+
+// Greenwich mean sidereal time, in degrees
+double ComputeSiderealTime(double julianDate);
+
+// Rotation from the equatorial frame of StarCatalogue (y = celestial pole,
+// x = vernal equinox) to the world horizon frame
+glm::mat3 ComputeEquatorialToHorizon(double julianDate, double latitude, double longitude);
+
+// Batch versions: 'julianDates' and 'directions' hold 'count' entries
+void ComputeSunDirections(const double* julianDates, size_t count, double latitude, double longitude, glm::vec3* directions);
+void ComputeMoonDirections(const double* julianDates, size_t count, double latitude, double longitude, glm::vec3* directions);
+
+glm::vec3 ComputeSunDirection(double julianDate, double latitude, double longitude);
+glm::vec3 ComputeMoonDirection(double julianDate, double latitude, double longitude);
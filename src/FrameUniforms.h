@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <glm/glm.hpp>
+
+// CPU side of the std140 block in shaders/FrameUniforms.glsli
+struct FrameUniforms
+{
+    glm::mat4 modelToProj;
+    glm::vec3 cameraPosition;
+    float time;
+    glm::vec3 sunDir;
+    float altitude;
+    glm::vec3 moonDir;
+    float turbidity;
+    float sunRadius;
+    float sunRadiance;
+    float moonBrightness;
+    float padding;
+};
+
+static_assert(offsetof(FrameUniforms, cameraPosition) == 64, "FrameUniforms : std140 layout mismatch");
+static_assert(offsetof(FrameUniforms, time) == 76, "FrameUniforms : std140 layout mismatch");
+static_assert(offsetof(FrameUniforms, sunDir) == 80, "FrameUniforms : std140 layout mismatch");
+static_assert(offsetof(FrameUniforms, altitude) == 92, "FrameUniforms : std140 layout mismatch");
+static_assert(offsetof(FrameUniforms, moonDir) == 96, "FrameUniforms : std140 layout mismatch");
+static_assert(offsetof(FrameUniforms, turbidity) == 108, "FrameUniforms : std140 layout mismatch");
+static_assert(offsetof(FrameUniforms, sunRadius) == 112, "FrameUniforms : std140 layout mismatch");
+static_assert(offsetof(FrameUniforms, moonBrightness) == 120, "FrameUniforms : std140 layout mismatch");
+static_assert(sizeof(FrameUniforms) == 128, "FrameUniforms : std140 layout mismatch");
@@ -0,0 +1,334 @@
+#include <GLType/GraphicsCommandList.h>
+#include <GLType/OGLGraphicsData.h>
+#include <GLType/OGLCoreGraphicsData.h>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <type_traits>
+#include <cassert>
+#include <cstring>
+#include <new>
+
+namespace
+{
+    const uint32_t kDefaultFramebuffer = ~0u;
+    const size_t kHeaderSize = sizeof(uint64_t);
+
+    struct FramebufferCommand { uint32_t index; };
+    struct ViewportCommand { GLint x, y; GLsizei width, height; };
+    struct ClearCommand { glm::vec4 color; GLfloat depth; GLbitfield mask; };
+    struct ProgramCommand { ProgramShader* program; };
+    struct UniformCommand { UniformHandle handle; GLenum type; };     // value follows
+    struct TextureCommand { UniformHandle handle; GLint unit; uint32_t index; };
+    struct UniformBufferCommand { GLintptr offset; GLsizeiptr size; GLuint point; uint32_t index; };
+    struct DrawCommand { GLuint vao; GLenum mode; GLint first; GLsizei count; GLsizei instances; GLuint baseInstance; GLenum indexType; };
+    struct BlitCommand { glm::ivec4 sourceRect, targetRect; uint32_t source, target; GLbitfield mask; GLenum filter; };
+    struct CallCommand { uint32_t index; };
+
+    size_t AlignSize(size_t size)
+    {
+        return (size + kHeaderSize - 1) & ~(kHeaderSize - 1);
+    }
+
+    GLuint GetBufferID(OGLDevice& device, const GraphicsDataPtr& data)
+    {
+        auto type = device.getGraphicsDeviceDesc().getDeviceType();
+        if (type == GraphicsDeviceType::GraphicsDeviceTypeOpenGLCore)
+            return data->downcast_pointer<OGLCoreGraphicsData>()->getInstanceID();
+        else if (type == GraphicsDeviceType::GraphicsDeviceTypeOpenGL)
+            return data->downcast_pointer<OGLGraphicsData>()->getInstanceID();
+        return GL_NONE;
+    }
+}
+
+GraphicsCommandList::GraphicsCommandList() noexcept :
+    m_Size(0),
+    m_Program(nullptr)
+{
+}
+
+GraphicsCommandList::~GraphicsCommandList() noexcept
+{
+}
+
+void GraphicsCommandList::reset() noexcept
+{
+    m_Size = 0;
+    m_Program = nullptr;
+    m_Framebuffers.clear();
+    m_Textures.clear();
+    m_Data.clear();
+    m_Calls.clear();
+    m_Stats = Stats();
+}
+
+template<typename T>
+T& GraphicsCommandList::push(CommandType type, size_t payload)
+{
+    static_assert(std::is_trivially_destructible<T>::value, "commands are never destroyed");
+
+    const size_t size = kHeaderSize + AlignSize(sizeof(T) + payload);
+    assert(size <= UINT16_MAX);
+
+    const size_t offset = m_Size;
+    m_Size += size;
+    if (m_Arena.size() * sizeof(uint64_t) < m_Size)
+        m_Arena.resize(std::max(m_Arena.size() * 2, m_Size / sizeof(uint64_t)));
+
+    uint8_t* command = reinterpret_cast<uint8_t*>(m_Arena.data()) + offset;
+    Header header = { type, uint16_t(size) };
+    std::memcpy(command, &header, sizeof(header));
+
+    m_Stats.commands++;
+    m_Stats.bytes = uint32_t(m_Size);
+    m_Stats.counts[type]++;
+    return *new (command + kHeaderSize) T();
+}
+
+uint32_t GraphicsCommandList::retain(const GraphicsFramebufferPtr& framebuffer)
+{
+    if (!framebuffer)
+        return kDefaultFramebuffer;
+    m_Framebuffers.push_back(framebuffer);
+    return uint32_t(m_Framebuffers.size() - 1);
+}
+
+void GraphicsCommandList::setFramebuffer(const GraphicsFramebufferPtr& framebuffer)
+{
+    uint32_t index = retain(framebuffer);
+    push<FramebufferCommand>(kCommandFramebuffer).index = index;
+}
+
+void GraphicsCommandList::setViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    push<ViewportCommand>(kCommandViewport) = ViewportCommand{ x, y, width, height };
+}
+
+void GraphicsCommandList::setPipelineState(const GraphicsPipelineState& state)
+{
+    push<GraphicsPipelineState>(kCommandPipelineState) = state;
+}
+
+void GraphicsCommandList::clear(GLbitfield mask, const glm::vec4& color, GLfloat depth)
+{
+    push<ClearCommand>(kCommandClear) = ClearCommand{ color, depth, mask };
+}
+
+void GraphicsCommandList::setProgram(ProgramShader& program)
+{
+    m_Program = &program;
+    push<ProgramCommand>(kCommandProgram).program = &program;
+}
+
+void GraphicsCommandList::pushUniform(UniformHandle handle, GLenum type, const void* data, size_t size)
+{
+    // Inactive uniforms are dropped here rather than on the GL thread
+    if (!handle.isValid())
+        return;
+    auto& command = push<UniformCommand>(kCommandUniform, size);
+    command.handle = handle;
+    command.type = type;
+    std::memcpy(&command + 1, data, size);
+}
+
+void GraphicsCommandList::setUniform(UniformHandle handle, GLint v)
+{
+    pushUniform(handle, GL_INT, &v, sizeof(v));
+}
+
+void GraphicsCommandList::setUniform(UniformHandle handle, GLfloat v)
+{
+    pushUniform(handle, GL_FLOAT, &v, sizeof(v));
+}
+
+void GraphicsCommandList::setUniform(UniformHandle handle, const glm::vec2& v)
+{
+    pushUniform(handle, GL_FLOAT_VEC2, glm::value_ptr(v), sizeof(v));
+}
+
+void GraphicsCommandList::setUniform(UniformHandle handle, const glm::vec3& v)
+{
+    pushUniform(handle, GL_FLOAT_VEC3, glm::value_ptr(v), sizeof(v));
+}
+
+void GraphicsCommandList::setUniform(UniformHandle handle, const glm::vec4& v)
+{
+    pushUniform(handle, GL_FLOAT_VEC4, glm::value_ptr(v), sizeof(v));
+}
+
+void GraphicsCommandList::setUniform(UniformHandle handle, const glm::mat3& v)
+{
+    pushUniform(handle, GL_FLOAT_MAT3, glm::value_ptr(v), sizeof(v));
+}
+
+void GraphicsCommandList::setUniform(UniformHandle handle, const glm::mat4& v)
+{
+    pushUniform(handle, GL_FLOAT_MAT4, glm::value_ptr(v), sizeof(v));
+}
+
+void GraphicsCommandList::bindTexture(UniformHandle handle, const GraphicsTexturePtr& texture, GLint unit)
+{
+    assert(texture);
+    assert(unit >= 0);
+
+    m_Textures.push_back(texture);
+    push<TextureCommand>(kCommandTexture) = TextureCommand{ handle, unit, uint32_t(m_Textures.size() - 1) };
+}
+
+bool GraphicsCommandList::bindBuffer(const std::string& block, const GraphicsDataPtr& data, GLintptr offset, GLsizeiptr size)
+{
+    // Block points are assigned at startup, the program set last knows them
+    if (!m_Program || !data)
+        return false;
+    GLint point = m_Program->getBlockPoint(block);
+    if (point < 0)
+        return false;
+
+    m_Data.push_back(data);
+    push<UniformBufferCommand>(kCommandUniformBuffer) = UniformBufferCommand{ offset, size, GLuint(point), uint32_t(m_Data.size() - 1) };
+    return true;
+}
+
+void GraphicsCommandList::draw(GLuint vao, GLenum mode, GLint first, GLsizei count, GLsizei instances, GLuint baseInstance)
+{
+    assert(instances > 0);
+    push<DrawCommand>(kCommandDraw) = DrawCommand{ vao, mode, first, count, instances, baseInstance, GL_NONE };
+}
+
+void GraphicsCommandList::drawIndexed(GLuint vao, GLenum mode, GLenum indexType, GLint first, GLsizei count, GLsizei instances, GLuint baseInstance)
+{
+    assert(instances > 0);
+    assert(indexType == GL_UNSIGNED_SHORT || indexType == GL_UNSIGNED_INT);
+    push<DrawCommand>(kCommandDraw) = DrawCommand{ vao, mode, first, count, instances, baseInstance, indexType };
+}
+
+void GraphicsCommandList::blit(const GraphicsFramebufferPtr& source, const glm::ivec4& sourceRect,
+                               const GraphicsFramebufferPtr& target, const glm::ivec4& targetRect,
+                               GLbitfield mask, GLenum filter)
+{
+    uint32_t sourceIndex = retain(source);
+    uint32_t targetIndex = retain(target);
+    push<BlitCommand>(kCommandBlit) = BlitCommand{ sourceRect, targetRect, sourceIndex, targetIndex, mask, filter };
+}
+
+void GraphicsCommandList::call(std::function<void()> function)
+{
+    m_Calls.push_back(std::move(function));
+    push<CallCommand>(kCommandCall).index = uint32_t(m_Calls.size() - 1);
+}
+
+void GraphicsCommandList::execute(OGLDevice& device) const
+{
+    const GraphicsFramebufferPtr kDefault;
+    auto framebuffer = [&](uint32_t index) -> const GraphicsFramebufferPtr& {
+        return index == kDefaultFramebuffer ? kDefault : m_Framebuffers[index];
+    };
+
+    ProgramShader* program = nullptr;
+    const uint8_t* command = reinterpret_cast<const uint8_t*>(m_Arena.data());
+    const uint8_t* end = command + m_Size;
+    while (command < end)
+    {
+        Header header;
+        std::memcpy(&header, command, sizeof(header));
+        const void* body = command + kHeaderSize;
+        command += header.size;
+
+        switch (header.type)
+        {
+        case kCommandFramebuffer:
+            device.setFramebuffer(framebuffer(static_cast<const FramebufferCommand*>(body)->index));
+            break;
+        case kCommandViewport:
+        {
+            auto& viewport = *static_cast<const ViewportCommand*>(body);
+            device.setViewport(viewport.x, viewport.y, viewport.width, viewport.height);
+            break;
+        }
+        case kCommandPipelineState:
+            device.setPipelineState(*static_cast<const GraphicsPipelineState*>(body));
+            break;
+        case kCommandClear:
+        {
+            auto& clear = *static_cast<const ClearCommand*>(body);
+            glClearColor(clear.color.r, clear.color.g, clear.color.b, clear.color.a);
+            glClearDepthf(clear.depth);
+            glClear(clear.mask);
+            break;
+        }
+        case kCommandProgram:
+            program = static_cast<const ProgramCommand*>(body)->program;
+            program->bind();
+            break;
+        case kCommandUniform:
+        {
+            assert(program);
+            auto& uniform = *static_cast<const UniformCommand*>(body);
+            const void* value = &uniform + 1;
+            switch (uniform.type)
+            {
+            case GL_INT: program->setUniform(uniform.handle, *static_cast<const GLint*>(value)); break;
+            case GL_FLOAT: program->setUniform(uniform.handle, *static_cast<const GLfloat*>(value)); break;
+            case GL_FLOAT_VEC2: program->setUniform(uniform.handle, *static_cast<const glm::vec2*>(value)); break;
+            case GL_FLOAT_VEC3: program->setUniform(uniform.handle, *static_cast<const glm::vec3*>(value)); break;
+            case GL_FLOAT_VEC4: program->setUniform(uniform.handle, *static_cast<const glm::vec4*>(value)); break;
+            case GL_FLOAT_MAT3: program->setUniform(uniform.handle, *static_cast<const glm::mat3*>(value)); break;
+            case GL_FLOAT_MAT4: program->setUniform(uniform.handle, *static_cast<const glm::mat4*>(value)); break;
+            default: assert(false); break;
+            }
+            break;
+        }
+        case kCommandTexture:
+        {
+            assert(program);
+            auto& texture = *static_cast<const TextureCommand*>(body);
+            program->bindTexture(texture.handle, m_Textures[texture.index], texture.unit);
+            break;
+        }
+        case kCommandUniformBuffer:
+        {
+            auto& binding = *static_cast<const UniformBufferCommand*>(body);
+            GLuint buffer = GetBufferID(device, m_Data[binding.index]);
+            if (binding.size == 0)
+                glBindBufferBase(GL_UNIFORM_BUFFER, binding.point, buffer);
+            else
+                glBindBufferRange(GL_UNIFORM_BUFFER, binding.point, buffer, binding.offset, binding.size);
+            break;
+        }
+        case kCommandDraw:
+        {
+            auto& draw = *static_cast<const DrawCommand*>(body);
+            device.setVertexArray(draw.vao);
+            if (draw.indexType != GL_NONE)
+            {
+                const size_t indexSize = draw.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+                const void* offset = reinterpret_cast<const void*>(draw.first * indexSize);
+                if (draw.baseInstance != 0)
+                    glDrawElementsInstancedBaseInstance(draw.mode, draw.count, draw.indexType, offset, draw.instances, draw.baseInstance);
+                else if (draw.instances != 1)
+                    glDrawElementsInstanced(draw.mode, draw.count, draw.indexType, offset, draw.instances);
+                else
+                    glDrawElements(draw.mode, draw.count, draw.indexType, offset);
+            }
+            else if (draw.baseInstance != 0)
+                glDrawArraysInstancedBaseInstance(draw.mode, draw.first, draw.count, draw.instances, draw.baseInstance);
+            else if (draw.instances != 1)
+                glDrawArraysInstanced(draw.mode, draw.first, draw.count, draw.instances);
+            else
+                glDrawArrays(draw.mode, draw.first, draw.count);
+            break;
+        }
+        case kCommandBlit:
+        {
+            auto& blit = *static_cast<const BlitCommand*>(body);
+            device.blitFramebuffer(framebuffer(blit.source), blit.sourceRect, framebuffer(blit.target), blit.targetRect, blit.mask, blit.filter);
+            break;
+        }
+        case kCommandCall:
+            m_Calls[static_cast<const CallCommand*>(body)->index]();
+            break;
+        default:
+            assert(false);
+            break;
+        }
+    }
+}
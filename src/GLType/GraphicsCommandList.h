@@ -0,0 +1,106 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <GraphicsTypes.h>
+#include <GLType/OGLDevice.h>
+#include <GLType/ProgramShader.h>
+#include <functional>
+#include <cstdint>
+#include <vector>
+
+// Draw calls and the state they need, recorded on any thread and executed on the GL thread.
+// Commands are packed into one arena reused by every frame; the resources they reference
+// are held until reset(). Uniforms and textures apply to the program set before them
+class GraphicsCommandList
+{
+public:
+
+    enum CommandType : uint16_t
+    {
+        kCommandFramebuffer,
+        kCommandViewport,
+        kCommandPipelineState,
+        kCommandClear,
+        kCommandProgram,
+        kCommandUniform,
+        kCommandTexture,
+        kCommandUniformBuffer,
+        kCommandDraw,
+        kCommandBlit,
+        kCommandCall,
+        kCommandCount
+    };
+
+    struct Stats
+    {
+        uint32_t commands = 0;
+        uint32_t bytes = 0;
+        uint32_t counts[kCommandCount] = {};
+    };
+
+    GraphicsCommandList() noexcept;
+    ~GraphicsCommandList() noexcept;
+
+    // Drop the commands and release the resources, the arena keeps its memory
+    void reset() noexcept;
+    bool empty() const noexcept { return m_Stats.commands == 0; }
+
+    // nullptr is the default framebuffer
+    void setFramebuffer(const GraphicsFramebufferPtr& framebuffer);
+    void setViewport(GLint x, GLint y, GLsizei width, GLsizei height);
+    void setPipelineState(const GraphicsPipelineState& state);
+    void clear(GLbitfield mask, const glm::vec4& color = glm::vec4(0.f), GLfloat depth = 1.f);
+
+    // The program must outlive the list
+    void setProgram(ProgramShader& program);
+    void setUniform(UniformHandle handle, GLint v);
+    void setUniform(UniformHandle handle, GLfloat v);
+    void setUniform(UniformHandle handle, const glm::vec2& v);
+    void setUniform(UniformHandle handle, const glm::vec3& v);
+    void setUniform(UniformHandle handle, const glm::vec4& v);
+    void setUniform(UniformHandle handle, const glm::mat3& v);
+    void setUniform(UniformHandle handle, const glm::mat4& v);
+    void bindTexture(UniformHandle handle, const GraphicsTexturePtr& texture, GLint unit);
+    // A zero size binds the whole buffer
+    bool bindBuffer(const std::string& block, const GraphicsDataPtr& data, GLintptr offset = 0, GLsizeiptr size = 0);
+
+    void draw(GLuint vao, GLenum mode, GLint first, GLsizei count, GLsizei instances = 1, GLuint baseInstance = 0);
+    // From the element buffer bound to the VAO, 'first' counts indices
+    void drawIndexed(GLuint vao, GLenum mode, GLenum indexType, GLint first, GLsizei count, GLsizei instances = 1, GLuint baseInstance = 0);
+    // Copy between framebuffers, nullptr is the default framebuffer
+    void blit(const GraphicsFramebufferPtr& source, const glm::ivec4& sourceRect,
+              const GraphicsFramebufferPtr& target, const glm::ivec4& targetRect,
+              GLbitfield mask = GL_COLOR_BUFFER_BIT, GLenum filter = GL_NEAREST);
+    // Escape hatch for work the commands above can't express, run in order on the GL thread
+    void call(std::function<void()> function);
+
+    void execute(OGLDevice& device) const;
+
+    const Stats& getStats() const noexcept { return m_Stats; }
+
+private:
+
+    GraphicsCommandList(const GraphicsCommandList&) = delete;
+    GraphicsCommandList& operator=(const GraphicsCommandList&) = delete;
+
+    struct Header
+    {
+        CommandType type;
+        uint16_t size;      // of the whole command, header included
+    };
+
+    template<typename T>
+    T& push(CommandType type, size_t payload = 0);
+    void pushUniform(UniformHandle handle, GLenum type, const void* data, size_t size);
+    uint32_t retain(const GraphicsFramebufferPtr& framebuffer);
+
+    std::vector<uint64_t> m_Arena;  // 8 byte granularity keeps every command aligned
+    size_t m_Size;
+    ProgramShader* m_Program;       // set last, for block lookups
+    std::vector<GraphicsFramebufferPtr> m_Framebuffers;
+    std::vector<GraphicsTexturePtr> m_Textures;
+    std::vector<GraphicsDataPtr> m_Data;
+    std::vector<std::function<void()>> m_Calls;
+    Stats m_Stats;
+};
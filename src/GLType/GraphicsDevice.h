@@ -29,6 +29,7 @@ public:
     virtual GraphicsTexturePtr createTexture(const GraphicsTextureDesc& desc) noexcept = 0;
     virtual GraphicsFramebufferPtr createFramebuffer(const GraphicsFramebufferDesc& desc) noexcept = 0;
 
+    // nullptr binds the default framebuffer
     virtual void setFramebuffer(const GraphicsFramebufferPtr& framebuffer) noexcept = 0;
 
 	virtual const GraphicsDeviceDesc& getGraphicsDeviceDesc() const noexcept = 0;
@@ -1,6 +1,7 @@
 #include "GLType/OGLCoreFramebuffer.h"
 #include <GL/glew.h>
 #include <GLType/OGLCoreTexture.h>
+#include <GLType/OGLDevice.h>
 #include <cassert>
 
 __ImplementSubInterface(OGLCoreFramebuffer, GraphicsFramebuffer)
@@ -65,6 +66,9 @@ void OGLCoreFramebuffer::destroy() noexcept
 {
     if (m_FBO != GL_NONE)
     {
+        auto device = m_Device.lock();
+        if (device)
+            device->downcast_pointer<OGLDevice>()->invalidateFramebuffer(m_FBO);
         glDeleteFramebuffers(1, &m_FBO);
         m_FBO = 0;
     }
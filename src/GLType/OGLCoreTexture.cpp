@@ -4,6 +4,7 @@
 #include <tools/FileUtility.h>
 #include <GLType/OGLTypes.h>
 #include <GLType/OGLCoreTexture.h>
+#include <GLType/OGLDevice.h>
 
 __ImplementSubInterface(OGLCoreTexture, GraphicsTexture)
 
@@ -157,6 +158,9 @@ void OGLCoreTexture::destroy() noexcept
 {
 	if (m_TextureID != GL_NONE)
 	{
+		auto device = m_Device.lock();
+		if (device)
+			device->downcast_pointer<OGLDevice>()->invalidateTexture(m_TextureID);
 		glDeleteTextures(1, &m_TextureID);
 		m_TextureID = GL_NONE;
 
@@ -175,12 +179,20 @@ void OGLCoreTexture::destroy() noexcept
 void OGLCoreTexture::bind(GLuint unit) const
 {
 	assert( 0u != m_TextureID );  
-    glBindTextureUnit(unit, m_TextureID);
+    auto device = m_Device.lock();
+    if (device)
+        device->downcast_pointer<OGLDevice>()->setTexture(unit, m_Target, m_TextureID);
+    else
+        glBindTextureUnit(unit, m_TextureID);
 }
 
 void OGLCoreTexture::unbind(GLuint unit) const
 {
-    glBindTextureUnit(unit, 0);
+    auto device = m_Device.lock();
+    if (device)
+        device->downcast_pointer<OGLDevice>()->setTexture(unit, m_Target, 0);
+    else
+        glBindTextureUnit(unit, 0);
 }
 
 void OGLCoreTexture::generateMipmap()
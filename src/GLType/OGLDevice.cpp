@@ -5,11 +5,41 @@
 #include <GLType/OGLCoreTexture.h>
 #include <GLType/OGLFramebuffer.h>
 #include <GLType/OGLCoreFramebuffer.h>
+#include <array>
+#include <cstring>
 
 __ImplementSubInterface(OGLDevice, GraphicsDevice)
 
-OGLDevice::OGLDevice() noexcept
+namespace
 {
+    // Everything a render target is created from, names and streams excluded
+    std::array<uint64_t, 11> GetTextureFields(const GraphicsTextureDesc& desc)
+    {
+        return {{
+            uint64_t(desc.getWidth()), uint64_t(desc.getHeight()), uint64_t(desc.getDepth()),
+            uint64_t(desc.getLevels()), uint64_t(desc.getTarget()), uint64_t(desc.getFormat()),
+            desc.getWrapS(), desc.getWrapT(), desc.getWrapR(),
+            desc.getMinFilter(), desc.getMagFilter()
+        }};
+    }
+
+    uint64_t HashTextureDesc(const GraphicsTextureDesc& desc)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (uint64_t field : GetTextureFields(desc))
+        {
+            hash ^= field;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+}
+
+OGLDevice::OGLDevice() noexcept :
+    m_PoolFrame(0),
+    m_PoolBudget(kPoolDefaultBudget)
+{
+    invalidateState();
 }
 
 OGLDevice::~OGLDevice() noexcept
@@ -90,7 +120,10 @@ GraphicsFramebufferPtr OGLDevice::createFramebuffer(const GraphicsFramebufferDes
         auto fbo = std::make_shared<OGLFramebuffer>();
         if (!fbo) return nullptr;
 		fbo->setDevice(this->downcast_pointer<OGLDevice>());
-        if (fbo->create(desc))
+        bool bCreated = fbo->create(desc);
+        // Attached through the binding point, which is left on the new framebuffer
+        m_State.fbo = ~0u;
+        if (bCreated)
             return fbo;
         return nullptr;
     }
@@ -99,21 +132,311 @@ GraphicsFramebufferPtr OGLDevice::createFramebuffer(const GraphicsFramebufferDes
 
 void OGLDevice::setFramebuffer(const GraphicsFramebufferPtr& framebuffer) noexcept
 {
-    assert(framebuffer);
+    setFramebufferID(getFramebufferID(framebuffer));
+}
+
+GLuint OGLDevice::getFramebufferID(const GraphicsFramebufferPtr& framebuffer) const noexcept
+{
+    if (!framebuffer)
+        return 0;
 
     if (m_Desc.getDeviceType() == GraphicsDeviceType::GraphicsDeviceTypeOpenGLCore)
     {
         auto fbo = framebuffer->downcast_pointer<OGLCoreFramebuffer>();
-        if (fbo) fbo->bind();
+        if (fbo) return fbo->m_FBO;
     }
     else if (m_Desc.getDeviceType() == GraphicsDeviceType::GraphicsDeviceTypeOpenGL)
     {
         auto fbo = framebuffer->downcast_pointer<OGLFramebuffer>();
-        if (fbo) fbo->bind();
+        if (fbo) return fbo->m_FBO;
     }
+    return 0;
+}
+
+void OGLDevice::blitFramebuffer(const GraphicsFramebufferPtr& source, const glm::ivec4& sourceRect,
+                                const GraphicsFramebufferPtr& target, const glm::ivec4& targetRect,
+                                GLbitfield mask, GLenum filter) noexcept
+{
+    GLuint read = getFramebufferID(source), draw = getFramebufferID(target);
+    m_StateStats.calls++;
+    if (m_Desc.getDeviceType() == GraphicsDeviceType::GraphicsDeviceTypeOpenGLCore)
+    {
+        glBlitNamedFramebuffer(read, draw,
+            sourceRect.x, sourceRect.y, sourceRect.z, sourceRect.w,
+            targetRect.x, targetRect.y, targetRect.z, targetRect.w, mask, filter);
+        return;
+    }
+
+    // Both binding points move, the next setFramebuffer binds again
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, read);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, draw);
+    glBlitFramebuffer(
+        sourceRect.x, sourceRect.y, sourceRect.z, sourceRect.w,
+        targetRect.x, targetRect.y, targetRect.z, targetRect.w, mask, filter);
+    m_State.fbo = ~0u;
 }
 
 const GraphicsDeviceDesc& OGLDevice::getGraphicsDeviceDesc() const noexcept
 {
     return m_Desc;
 }
+
+bool OGLDevice::setFramebufferID(GLuint fbo) noexcept
+{
+    assert(fbo != ~0u);
+    if (m_State.fbo == fbo)
+    {
+        m_StateStats.elided++;
+        return false;
+    }
+    m_State.fbo = fbo;
+    m_StateStats.calls++;
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    return true;
+}
+
+void OGLDevice::setCapability(GLenum capability, bool bEnable, GLuint& cached) noexcept
+{
+    if (cached == GLuint(bEnable))
+    {
+        m_StateStats.elided++;
+        return;
+    }
+    cached = GLuint(bEnable);
+    m_StateStats.calls++;
+    if (bEnable)
+        glEnable(capability);
+    else
+        glDisable(capability);
+}
+
+void OGLDevice::setPipelineState(const GraphicsPipelineState& state) noexcept
+{
+    setCapability(GL_DEPTH_TEST, state.bDepthTest, m_State.depthTest);
+    setCapability(GL_CULL_FACE, state.bCullFace, m_State.cullFace);
+    setCapability(GL_BLEND, state.bBlend, m_State.blend);
+
+    if (m_State.depthWrite == GLuint(state.bDepthWrite))
+        m_StateStats.elided++;
+    else
+    {
+        m_State.depthWrite = GLuint(state.bDepthWrite);
+        m_StateStats.calls++;
+        glDepthMask(state.bDepthWrite ? GL_TRUE : GL_FALSE);
+    }
+
+    // Like the blend factors, the function only matters while testing
+    if (state.bDepthTest)
+    {
+        if (m_State.depthFunc == state.depthFunc)
+            m_StateStats.elided++;
+        else
+        {
+            m_State.depthFunc = state.depthFunc;
+            m_StateStats.calls++;
+            glDepthFunc(state.depthFunc);
+        }
+    }
+
+    // Factors only matter while blending, keep the last ones until then
+    if (!state.bBlend)
+        return;
+    if (m_State.blendSrc == state.blendSrc && m_State.blendDst == state.blendDst)
+        m_StateStats.elided++;
+    else
+    {
+        m_State.blendSrc = state.blendSrc;
+        m_State.blendDst = state.blendDst;
+        m_StateStats.calls++;
+        glBlendFunc(state.blendSrc, state.blendDst);
+    }
+}
+
+void OGLDevice::setViewport(GLint x, GLint y, GLsizei width, GLsizei height) noexcept
+{
+    const GLint viewport[4] = { x, y, width, height };
+    if (std::memcmp(m_State.viewport, viewport, sizeof(viewport)) == 0)
+    {
+        m_StateStats.elided++;
+        return;
+    }
+    std::memcpy(m_State.viewport, viewport, sizeof(viewport));
+    m_StateStats.calls++;
+    glViewport(x, y, width, height);
+}
+
+void OGLDevice::setProgram(GLuint program) noexcept
+{
+    if (m_State.program == program)
+    {
+        m_StateStats.elided++;
+        return;
+    }
+    m_State.program = program;
+    m_StateStats.calls++;
+    glUseProgram(program);
+}
+
+void OGLDevice::setVertexArray(GLuint vao) noexcept
+{
+    if (m_State.vao == vao)
+    {
+        m_StateStats.elided++;
+        return;
+    }
+    m_State.vao = vao;
+    m_StateStats.calls++;
+    glBindVertexArray(vao);
+}
+
+void OGLDevice::setTexture(GLuint unit, GLenum target, GLuint texture) noexcept
+{
+    // Without DSA, texture edits bind through the active unit and the shadow can't be trusted
+    if (m_Desc.getDeviceType() != GraphicsDeviceType::GraphicsDeviceTypeOpenGLCore)
+    {
+        m_StateStats.calls++;
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(target, texture);
+        return;
+    }
+
+    if (unit < kTextureUnitCount)
+    {
+        if (m_State.textures[unit] == texture)
+        {
+            m_StateStats.elided++;
+            return;
+        }
+        m_State.textures[unit] = texture;
+    }
+    m_StateStats.calls++;
+    glBindTextureUnit(unit, texture);
+}
+
+void OGLDevice::invalidateState() noexcept
+{
+    std::memset(&m_State, 0xff, sizeof(m_State));
+}
+
+void OGLDevice::invalidateProgram(GLuint program) noexcept
+{
+    if (m_State.program == program)
+        m_State.program = ~0u;
+}
+
+void OGLDevice::invalidateVertexArray(GLuint vao) noexcept
+{
+    if (m_State.vao == vao)
+        m_State.vao = ~0u;
+}
+
+void OGLDevice::invalidateTexture(GLuint texture) noexcept
+{
+    for (auto& unit : m_State.textures)
+    {
+        if (unit == texture)
+            unit = ~0u;
+    }
+}
+
+void OGLDevice::invalidateFramebuffer(GLuint fbo) noexcept
+{
+    if (m_State.fbo == fbo)
+        m_State.fbo = ~0u;
+}
+
+GraphicsTexturePtr OGLDevice::acquireTexture(const GraphicsTextureDesc& desc) noexcept
+{
+    auto& entries = m_TexturePool[HashTextureDesc(desc)];
+    for (auto& entry : entries)
+    {
+        // The hash only buckets, a collision must not hand out another size or format
+        if (!entry.bFree || GetTextureFields(entry.texture->getGraphicsTextureDesc()) != GetTextureFields(desc))
+            continue;
+        entry.bFree = false;
+        entry.lastFrame = m_PoolFrame;
+        m_PoolStats.reuses++;
+        return entry.texture;
+    }
+
+    auto texture = createTexture(desc);
+    if (!texture)
+        return nullptr;
+    PooledTexture entry = { texture, computeTextureSize(desc), m_PoolFrame, false };
+    entries.push_back(entry);
+    m_PoolStats.allocations++;
+    m_PoolStats.bytes += entry.bytes;
+    return texture;
+}
+
+void OGLDevice::releaseTexture(const GraphicsTexturePtr& texture) noexcept
+{
+    if (!texture)
+        return;
+    auto& entries = m_TexturePool[HashTextureDesc(texture->getGraphicsTextureDesc())];
+    for (auto& entry : entries)
+    {
+        if (entry.texture == texture)
+        {
+            assert(!entry.bFree);
+            entry.bFree = true;
+            entry.lastFrame = m_PoolFrame;
+            return;
+        }
+    }
+    assert(false);
+}
+
+void OGLDevice::trimTexturePool() noexcept
+{
+    m_PoolFrame++;
+    for (auto it = m_TexturePool.begin(); it != m_TexturePool.end(); )
+    {
+        auto& entries = it->second;
+        for (size_t i = 0; i < entries.size(); )
+        {
+            auto& entry = entries[i];
+            if (entry.bFree && m_PoolFrame - entry.lastFrame > kPoolIdleFrames)
+            {
+                m_PoolStats.bytes -= entry.bytes;
+                entries[i] = entries.back();
+                entries.pop_back();
+                continue;
+            }
+            i++;
+        }
+        if (entries.empty())
+            it = m_TexturePool.erase(it);
+        else
+            ++it;
+    }
+
+    while (m_PoolStats.bytes > m_PoolBudget)
+    {
+        std::vector<PooledTexture>* oldest = nullptr;
+        size_t index = 0;
+        for (auto& bucket : m_TexturePool)
+        {
+            for (size_t i = 0; i < bucket.second.size(); i++)
+            {
+                const auto& entry = bucket.second[i];
+                if (entry.bFree && (!oldest || m_PoolFrame - entry.lastFrame > m_PoolFrame - (*oldest)[index].lastFrame))
+                    oldest = &bucket.second, index = i;
+            }
+        }
+        if (!oldest)
+            break;
+        m_PoolStats.bytes -= (*oldest)[index].bytes;
+        m_PoolStats.evictions++;
+        (*oldest)[index] = oldest->back();
+        oldest->pop_back();
+    }
+}
+
+size_t OGLDevice::computeTextureSize(const GraphicsTextureDesc& desc) noexcept
+{
+    const auto extent = gli::block_extent(desc.getFormat());
+    const size_t blocksX = (desc.getWidth() + extent.x - 1) / extent.x;
+    const size_t blocksY = (desc.getHeight() + extent.y - 1) / extent.y;
+    return blocksX * blocksY * gli::block_size(desc.getFormat());
+}
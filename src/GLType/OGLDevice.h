@@ -1,6 +1,38 @@
 #pragma once
 
+#include <GL/glew.h>
+#include <glm/glm.hpp>
 #include <GLType/GraphicsDevice.h>
+#include <GLType/GraphicsTexture.h>
+#include <unordered_map>
+#include <vector>
+
+// Fixed function state set together before a draw
+struct GraphicsPipelineState
+{
+    bool bDepthTest = true;
+    bool bDepthWrite = true;
+    GLenum depthFunc = GL_LEQUAL;
+    bool bCullFace = true;
+    bool bBlend = false;
+    GLenum blendSrc = GL_ONE;
+    GLenum blendDst = GL_ZERO;
+};
+
+// GL calls issued and skipped by the state cache since resetStateStats
+struct GraphicsStateStats
+{
+    uint32_t calls = 0;
+    uint32_t elided = 0;
+};
+
+struct GraphicsTexturePoolStats
+{
+    uint32_t allocations = 0;   // textures created by acquireTexture
+    uint32_t reuses = 0;
+    uint32_t evictions = 0;     // free textures dropped to stay under the budget
+    size_t bytes = 0;           // held by the pool, in use or free
+};
 
 class OGLDevice final : public GraphicsDevice
 {
@@ -21,7 +53,86 @@ public:
 
 	const GraphicsDeviceDesc& getGraphicsDeviceDesc() const noexcept override;
 
+    // The state below is shadowed, only changes reach the driver.
+    // Code binding behind the cache's back must call invalidateState afterwards
+    void setPipelineState(const GraphicsPipelineState& state) noexcept;
+    void setViewport(GLint x, GLint y, GLsizei width, GLsizei height) noexcept;
+    void setProgram(GLuint program) noexcept;
+    void setVertexArray(GLuint vao) noexcept;
+    void setTexture(GLuint unit, GLenum target, GLuint texture) noexcept;
+
+    // Rects are (x0, y0, x1, y1), nullptr is the default framebuffer
+    void blitFramebuffer(const GraphicsFramebufferPtr& source, const glm::ivec4& sourceRect,
+                         const GraphicsFramebufferPtr& target, const glm::ivec4& targetRect,
+                         GLbitfield mask, GLenum filter) noexcept;
+
+    // Forget everything, the next set of each state reaches the driver
+    void invalidateState() noexcept;
+
+    // Deleted objects are unbound by GL, their names can be reused
+    void invalidateProgram(GLuint program) noexcept;
+    void invalidateVertexArray(GLuint vao) noexcept;
+    void invalidateTexture(GLuint texture) noexcept;
+    void invalidateFramebuffer(GLuint fbo) noexcept;
+
+    const GraphicsStateStats& getStateStats() const noexcept { return m_StateStats; }
+    void resetStateStats() noexcept { m_StateStats = GraphicsStateStats(); }
+
+    // Render targets recycled by descriptor, a released texture is handed to the next
+    // acquire of the same descriptor. trimTexturePool is called once per frame and
+    // frees the released textures no acquire wanted for kPoolIdleFrames, then the least
+    // recently released ones while the pool is over budget
+    GraphicsTexturePtr acquireTexture(const GraphicsTextureDesc& desc) noexcept;
+    void releaseTexture(const GraphicsTexturePtr& texture) noexcept;
+    void trimTexturePool() noexcept;
+    // Textures in use are never evicted, the pool may exceed it by those
+    void setTexturePoolBudget(size_t bytes) noexcept { m_PoolBudget = bytes; }
+
+    static size_t computeTextureSize(const GraphicsTextureDesc& desc) noexcept;
+
+    const GraphicsTexturePoolStats& getTexturePoolStats() const noexcept { return m_PoolStats; }
+
 private:
 
+    struct PooledTexture
+    {
+        GraphicsTexturePtr texture;
+        size_t bytes;
+        uint32_t lastFrame;     // of the last acquire or release
+        bool bFree;
+    };
+
+    static const uint32_t kPoolIdleFrames = 240;
+    static const size_t kPoolDefaultBudget = 256 << 20;
+
+    enum { kTextureUnitCount = 16 };
+
+    // ~0u is never a valid name or enum, the first set always goes through
+    struct StateCache
+    {
+        GLuint depthTest;
+        GLuint depthWrite;
+        GLenum depthFunc;
+        GLuint cullFace;
+        GLuint blend;
+        GLenum blendSrc;
+        GLenum blendDst;
+        GLint viewport[4];
+        GLuint program;
+        GLuint vao;
+        GLuint fbo;
+        GLuint textures[kTextureUnitCount];
+    };
+
+    void setCapability(GLenum capability, bool bEnable, GLuint& cached) noexcept;
+    bool setFramebufferID(GLuint fbo) noexcept;
+    GLuint getFramebufferID(const GraphicsFramebufferPtr& framebuffer) const noexcept;
+
     GraphicsDeviceDesc m_Desc;
+    StateCache m_State;
+    GraphicsStateStats m_StateStats;
+    std::unordered_map<uint64_t, std::vector<PooledTexture>> m_TexturePool;    // by descriptor hash
+    GraphicsTexturePoolStats m_PoolStats;
+    uint32_t m_PoolFrame;
+    size_t m_PoolBudget;
 };
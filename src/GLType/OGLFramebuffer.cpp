@@ -1,6 +1,7 @@
 #include "GLType/OGLFramebuffer.h"
 #include <GL/glew.h>
 #include <GLType/OGLTexture.h>
+#include <GLType/OGLDevice.h>
 #include <cassert>
 
 __ImplementSubInterface(OGLFramebuffer, GraphicsFramebuffer)
@@ -66,6 +67,9 @@ void OGLFramebuffer::destroy() noexcept
 {
     if (m_FBO != GL_NONE)
     {
+        auto device = m_Device.lock();
+        if (device)
+            device->downcast_pointer<OGLDevice>()->invalidateFramebuffer(m_FBO);
         glDeleteFramebuffers(1, &m_FBO);
         m_FBO = 0;
     }
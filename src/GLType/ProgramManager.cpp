@@ -31,7 +31,10 @@
 #include <GL/glew.h>
 #include <GLType/ProgramManager.h>
 #include <tools/misc.hpp>
+#include <tools/FileUtility.h>
 #include <cstdarg>
+#include <memory>
+#include <mutex>
 
 namespace nv_helpers_gl
 {
@@ -100,24 +103,133 @@ namespace nv_helpers_gl
         }
     }
 
+    namespace
+    {
+        using util::FileStamp;
+        using util::GetFileStamp;
+
+        struct CachedFile
+        {
+            FileStamp stamp;
+            std::shared_ptr<const std::string> content;
+        };
+
+        struct CachedText
+        {
+            std::string text;
+            std::vector<std::pair<std::string, FileStamp>> dependencies;
+        };
+
+        std::mutex s_CacheMutex;
+        std::unordered_map<std::string, CachedFile> s_Files;   // by path
+        std::unordered_map<std::string, std::string> s_Paths;  // by search directories and name
+        std::unordered_map<uint64_t, CachedText> s_Texts;      // by manualInclude inputs
+        IncludeCacheStats s_Stats = {};
+
+        uint64_t HashBytes(uint64_t hash, const void* data, size_t size)
+        {
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+            for (size_t i = 0; i < size; i++)
+            {
+                hash ^= bytes[i];
+                hash *= 1099511628211ull;
+            }
+            return hash;
+        }
+
+        uint64_t HashString(uint64_t hash, const std::string& str)
+        {
+            // Length first, so that ("ab", "c") and ("a", "bc") differ
+            uint64_t size = str.size();
+            hash = HashBytes(hash, &size, sizeof(size));
+            return HashBytes(hash, str.data(), str.size());
+        }
+
+        // findFile opens a stream per directory, remember where the name was found
+        std::string resolveFile(const std::string& name, const std::vector<std::string>& directories)
+        {
+            std::string key;
+            for (const auto& dir : directories)
+                key += dir + "|";
+            key += name;
+            {
+                std::lock_guard<std::mutex> lock(s_CacheMutex);
+                auto it = s_Paths.find(key);
+                if (it != s_Paths.end())
+                    return it->second;
+            }
+            std::string filename = nv_helpers::findFile(name, directories);
+            // Not found is not remembered, the file may appear later
+            if (GetFileStamp(filename).size >= 0)
+            {
+                std::lock_guard<std::mutex> lock(s_CacheMutex);
+                s_Paths[key] = filename;
+            }
+            return filename;
+        }
+
+        CachedFile loadFile(const std::string& filename, bool throwwarning)
+        {
+            const FileStamp stamp = GetFileStamp(filename);
+            {
+                std::lock_guard<std::mutex> lock(s_CacheMutex);
+                auto it = s_Files.find(filename);
+                if (it != s_Files.end() && it->second.stamp == stamp)
+                {
+                    s_Stats.fileHits++;
+                    return it->second;
+                }
+                s_Stats.fileMisses++;
+            }
+            CachedFile file;
+            file.stamp = stamp;
+            file.content = std::make_shared<const std::string>(nv_helpers::loadFile(filename, throwwarning));
+            if (stamp.size >= 0)
+            {
+                std::lock_guard<std::mutex> lock(s_CacheMutex);
+                s_Files[filename] = file;
+            }
+            return file;
+        }
+    }
+
     std::string getContent(std::string const & name, const std::vector<std::string>& directories, 
         const IncludeRegistry &includes,
-        std::string & filename)
+        std::string & filename,
+        FileStamp & stamp)
     {
         // check registered includes first
-        for(std::size_t i = 0; i < includes.size(); ++i)
+        auto it = includes.find(name);
+        if (it != includes.end())
         {
-            if(includes[i].name != name) continue;
-
-            filename = nv_helpers::findFile(includes[i].filename, directories);
-            std::string content = nv_helpers::loadFile(filename, includes[i].content.empty());
-            if(content.empty()) return includes[i].content;
-            return content;
+            const IncludeEntry& entry = it->second;
+            filename = resolveFile(entry.filename, directories);
+            CachedFile file = loadFile(filename, entry.content.empty());
+            stamp = file.stamp;
+            if(file.content->empty()) return entry.content;
+            return *file.content;
         }
 
         // fall back
-        filename = nv_helpers::findFile(name, directories);
-        return nv_helpers::loadFile(filename);
+        filename = resolveFile(name, directories);
+        CachedFile file = loadFile(filename, true);
+        stamp = file.stamp;
+        return *file.content;
+    }
+
+    IncludeCacheStats getIncludeCacheStats()
+    {
+        std::lock_guard<std::mutex> lock(s_CacheMutex);
+        return s_Stats;
+    }
+
+    void clearIncludeCache()
+    {
+        std::lock_guard<std::mutex> lock(s_CacheMutex);
+        s_Files.clear();
+        s_Paths.clear();
+        s_Texts.clear();
+        s_Stats = IncludeCacheStats();
     }
 
     std::string manualInclude (
@@ -125,7 +237,8 @@ namespace nv_helpers_gl
         std::string const & source,
         std::string const & prepend,
         const std::vector<std::string>& directories,
-        const IncludeRegistry &includes)
+        const IncludeRegistry &includes,
+        std::vector<std::string>* dependencies)
     {
         std::string filename = filenameorig;
 
@@ -133,6 +246,49 @@ namespace nv_helpers_gl
             return std::string();
         }
 
+        // Same inputs give the same text as long as the included files are unchanged
+        uint64_t key = 14695981039346656037ull;
+        key = HashString(key, filenameorig);
+        key = HashString(key, source);
+        key = HashString(key, prepend);
+        for (const auto& dir : directories)
+            key = HashString(key, dir);
+        for (const auto& include : includes)
+        {
+            key = HashString(key, include.second.name);
+            key = HashString(key, include.second.filename);
+            key = HashString(key, include.second.content);
+        }
+        {
+            std::lock_guard<std::mutex> lock(s_CacheMutex);
+            auto it = s_Texts.find(key);
+            if (it != s_Texts.end())
+            {
+                bool bValid = true;
+                for (const auto& dependency : it->second.dependencies)
+                {
+                    if (GetFileStamp(dependency.first) != dependency.second)
+                    {
+                        bValid = false;
+                        break;
+                    }
+                }
+                if (bValid)
+                {
+                    if (dependencies)
+                    {
+                        for (const auto& dependency : it->second.dependencies)
+                            dependencies->push_back(dependency.first);
+                    }
+                    s_Stats.textHits++;
+                    return it->second.text;
+                }
+                s_Texts.erase(it);
+            }
+            s_Stats.textMisses++;
+        }
+        std::vector<std::pair<std::string, FileStamp>> stamps;
+
         std::stringstream stream;
         stream << source;
         std::string line, text;
@@ -179,7 +335,9 @@ namespace nv_helpers_gl
                         dirs.push_back(it + "/" + path);
                     dirs.insert(dirs.end(), directories.begin(), directories.end());
                     std::string PathName;
-                    std::string Source = getContent(Include, dirs, includes, PathName);
+                    FileStamp Stamp;
+                    std::string Source = getContent(Include, dirs, includes, PathName, Stamp);
+                    stamps.emplace_back(PathName, Stamp);
 
                     assert(!Source.empty());
 
@@ -201,6 +359,15 @@ namespace nv_helpers_gl
             text += line + "\n";
         }
 
+        {
+            std::lock_guard<std::mutex> lock(s_CacheMutex);
+            s_Texts[key] = CachedText{ text, stamps };
+        }
+        if (dependencies)
+        {
+            for (const auto& stamp : stamps)
+                dependencies->push_back(stamp.first);
+        }
         return text;
     }
 }
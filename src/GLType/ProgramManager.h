@@ -1,5 +1,7 @@
 #include <string>
 #include <vector>
+#include <cstdint>
+#include <unordered_map>
 
 namespace nv_helpers_gl
 {
@@ -9,12 +11,28 @@ namespace nv_helpers_gl
       std::string   content;
     };
 
-    typedef std::vector<IncludeEntry> IncludeRegistry;
+    // Keyed by IncludeEntry::name
+    typedef std::unordered_map<std::string, IncludeEntry> IncludeRegistry;
 
+    // Included files are read once and kept in memory, revalidated by modification time;
+    // the expanded text is memoized by its inputs and reused while no dependency changed.
+    // 'dependencies' receives the paths of the included files
     std::string manualInclude (
         std::string const & filenameorig,
         std::string const & source,
         std::string const & prepend,
         const std::vector<std::string>& directories,
-        const IncludeRegistry &includes);
+        const IncludeRegistry &includes,
+        std::vector<std::string>* dependencies = nullptr);
+
+    struct IncludeCacheStats
+    {
+        uint32_t fileHits;
+        uint32_t fileMisses;
+        uint32_t textHits;
+        uint32_t textMisses;
+    };
+
+    IncludeCacheStats getIncludeCacheStats();
+    void clearIncludeCache();
 }
@@ -0,0 +1,189 @@
+#include <GLType/ProgramPermutation.h>
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+
+ProgramPermutation::ProgramPermutation() noexcept :
+    m_Bits(0),
+    m_Key(0),
+    m_ReadyKey(~0u),
+    m_Ready(nullptr)
+{
+}
+
+ProgramPermutation::~ProgramPermutation() noexcept
+{
+}
+
+void ProgramPermutation::setDevice(const GraphicsDevicePtr& device)
+{
+    m_Device = device;
+}
+
+void ProgramPermutation::addShader(GLenum shaderType, const std::string& tag)
+{
+    assert(m_Variants.empty());
+    m_Shaders.emplace_back(shaderType, tag);
+}
+
+uint32_t ProgramPermutation::addOption(const std::string& name, std::initializer_list<int> values)
+{
+    assert(m_Variants.empty());
+    assert(values.size() > 0);
+
+    uint32_t bits = 0;
+    while ((size_t(1) << bits) < values.size())
+        bits++;
+    assert(m_Bits + bits <= 32);
+
+    // The first value is index 0, already in the key
+    Option option;
+    option.name = name;
+    option.values = values;
+    option.shift = m_Bits;
+    option.mask = bits ? ((1u << bits) - 1) << m_Bits : 0;
+    m_Options.push_back(option);
+    m_Bits += bits;
+    return uint32_t(m_Options.size() - 1);
+}
+
+uint32_t ProgramPermutation::addOption(const std::string& name, bool bDefault)
+{
+    return bDefault ? addOption(name, { 1, 0 }) : addOption(name, { 0, 1 });
+}
+
+void ProgramPermutation::setOption(uint32_t option, int value)
+{
+    assert(option < m_Options.size());
+    const Option& o = m_Options[option];
+    auto it = std::find(o.values.begin(), o.values.end(), value);
+    assert(it != o.values.end());
+    if (it == o.values.end())
+        return;
+
+    const uint32_t index = uint32_t(it - o.values.begin());
+    const uint32_t key = (m_Key & ~o.mask) | (index << o.shift);
+    if (key == m_Key)
+        return;
+    m_Key = key;
+
+    // Coming back to options that failed tries them again
+    auto variant = m_Variants.find(m_Key);
+    if (variant != m_Variants.end() && variant->second.bFailed)
+        retry(variant->second, m_Key);
+}
+
+bool ProgramPermutation::isPending() const
+{
+    if (m_ReadyKey == m_Key)
+        return false;
+    auto it = m_Variants.find(m_Key);
+    return it == m_Variants.end() || !it->second.bFailed;
+}
+
+void ProgramPermutation::retryFailed()
+{
+    for (auto& variant : m_Variants)
+    {
+        if (variant.second.bFailed)
+            retry(variant.second, variant.first);
+    }
+}
+
+int ProgramPermutation::getSelectedOption(uint32_t option) const
+{
+    assert(option < m_Options.size());
+    const Option& o = m_Options[option];
+    const uint32_t key = m_Ready ? m_ReadyKey : m_Key;
+    return o.values[(key & o.mask) >> o.shift];
+}
+
+void ProgramPermutation::setCallback(const Callback& callback)
+{
+    m_Callback = callback;
+}
+
+void ProgramPermutation::setValidator(const ProgramShader::Validator& validator)
+{
+    assert(m_Variants.empty());
+    m_Validator = validator;
+}
+
+std::string ProgramPermutation::getDefines(uint32_t key) const
+{
+    std::string defines;
+    for (const auto& option : m_Options)
+    {
+        const uint32_t index = (key & option.mask) >> option.shift;
+        defines += "#define " + option.name + " " + std::to_string(option.values[index]) + "\n";
+    }
+    return defines;
+}
+
+ProgramPermutation::Variant& ProgramPermutation::getVariant(uint32_t key)
+{
+    auto it = m_Variants.find(key);
+    if (it != m_Variants.end())
+        return it->second;
+
+    std::unique_ptr<ProgramShader> program(new ProgramShader);
+    program->setDevice(m_Device.lock());
+    program->initialize();
+    for (const auto& shader : m_Shaders)
+        program->addShader(shader.first, shader.second);
+    program->setDefines(getDefines(key));
+    program->setValidator(m_Validator);
+
+    Variant& variant = m_Variants[key];
+    variant.program = std::move(program);
+    variant.bReady = false;
+    variant.bFailed = false;
+    return variant;
+}
+
+void ProgramPermutation::retry(Variant& variant, uint32_t key)
+{
+    // The failed program may still be referenced when there was nothing to fall back on
+    m_Retired.push_back(std::move(variant.program));
+    m_Variants.erase(key);
+    getVariant(key);
+}
+
+ProgramShader& ProgramPermutation::prepare()
+{
+    return *getVariant(m_Key).program;
+}
+
+ProgramShader& ProgramPermutation::select()
+{
+    Variant& variant = getVariant(m_Key);
+    ProgramShader& program = *variant.program;
+    if (!variant.bReady && !variant.bFailed)
+    {
+        // Nothing to fall back on for the first variant, wait for it
+        if (!m_Ready)
+            program.link();
+        else if (!program.isSubmitted())
+            program.submit();
+        else
+            program.poll();
+
+        if (program.isLinked())
+        {
+            if (m_Callback)
+                m_Callback(program);
+            variant.bReady = true;
+        }
+        else if (program.isFailed())
+        {
+            variant.bFailed = true;
+            printf("ProgramPermutation : variant %08x failed, keeping the previous one.\n", m_Key);
+        }
+    }
+    if (variant.bReady)
+    {
+        m_Ready = &program;
+        m_ReadyKey = m_Key;
+    }
+    return m_Ready ? *m_Ready : program;
+}
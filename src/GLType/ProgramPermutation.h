@@ -0,0 +1,89 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <GraphicsTypes.h>
+#include <GLType/ProgramShader.h>
+#include <initializer_list>
+#include <unordered_map>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// Variants of one program compiled with different #defines instead of branching on uniforms.
+// Each option is a define taking one of a few values, packed into a key of option bits;
+// select() compiles the variant for the current key on first use and keeps the
+// last ready variant in use until it links
+class ProgramPermutation
+{
+public:
+
+    using Callback = std::function<void(ProgramShader&)>;
+
+    ProgramPermutation() noexcept;
+    ~ProgramPermutation() noexcept;
+
+    void setDevice(const GraphicsDevicePtr& device);
+    void addShader(GLenum shaderType, const std::string& tag);
+
+    /** Declare a define taking one of 'values', the first is the default. Returns its index */
+    uint32_t addOption(const std::string& name, std::initializer_list<int> values);
+    /** Declare a define set to 0 or 1 */
+    uint32_t addOption(const std::string& name, bool bDefault);
+
+    /** 'value' must be one of the declared values */
+    void setOption(uint32_t option, int value);
+
+    /** Called once for each variant after it links, before select() returns it */
+    void setCallback(const Callback& callback);
+    /** Given to every variant, one it rejects counts as failed */
+    void setValidator(const ProgramShader::Validator& validator);
+
+    /** The variant for the current options, not compiled yet so it can be linked along other programs */
+    ProgramShader& prepare();
+    /** The variant for the current options, or the last ready one while it compiles */
+    ProgramShader& select();
+
+    /** The current options have no ready variant yet, and it didn't fail */
+    bool isPending() const;
+    /** Compile the failed variants again, after their sources were edited */
+    void retryFailed();
+    /** Value of 'option' in the variant select() returned last, which differs from the current one while pending */
+    int getSelectedOption(uint32_t option) const;
+    uint32_t getKey() const { return m_Key; }
+    size_t getVariantCount() const { return m_Variants.size(); }
+
+private:
+
+    struct Option
+    {
+        std::string name;
+        std::vector<int> values;
+        uint32_t shift;
+        uint32_t mask;
+    };
+
+    struct Variant
+    {
+        std::unique_ptr<ProgramShader> program;
+        bool bReady;
+        bool bFailed;       // settled on the previous variant until retried
+    };
+
+    Variant& getVariant(uint32_t key);
+    void retry(Variant& variant, uint32_t key);
+    std::string getDefines(uint32_t key) const;
+
+    GraphicsDeviceWeakPtr m_Device;
+    std::vector<std::pair<GLenum, std::string>> m_Shaders;
+    std::vector<Option> m_Options;
+    std::unordered_map<uint32_t, Variant> m_Variants;
+    std::vector<std::unique_ptr<ProgramShader>> m_Retired;     // failed programs replaced by a retry
+    Callback m_Callback;
+    ProgramShader::Validator m_Validator;
+    uint32_t m_Bits;
+    uint32_t m_Key;
+    uint32_t m_ReadyKey;
+    ProgramShader* m_Ready;
+};
@@ -0,0 +1,48 @@
+#include <GLType/ProgramReloader.h>
+#include <GLType/ProgramShader.h>
+#include <algorithm>
+#include <cstdio>
+
+void ProgramReloader::add(ProgramShader& program, const Callback& callback)
+{
+    m_Programs.push_back(Entry{ &program, callback, {} });
+    watch(m_Programs.back());
+}
+
+void ProgramReloader::watch(Entry& entry)
+{
+    // A rebuilt program may include different files
+    entry.dependencies = entry.program->getDependencies();
+    for (const auto& path : entry.dependencies)
+        m_Watcher.addFile(path);
+}
+
+bool ProgramReloader::update()
+{
+    m_Changed.clear();
+    m_Watcher.poll(m_Changed);
+
+    for (auto& entry : m_Programs)
+    {
+        for (const auto& path : m_Changed)
+        {
+            if (!std::binary_search(entry.dependencies.begin(), entry.dependencies.end(), path))
+                continue;
+            printf("ProgramReloader : \"%s\" changed, rebuilding.\n", path.c_str());
+            entry.program->reload();
+            break;
+        }
+    }
+
+    bool bReloaded = false;
+    for (auto& entry : m_Programs)
+    {
+        if (!entry.program->pollReload())
+            continue;
+        watch(entry);
+        if (entry.callback)
+            entry.callback(*entry.program);
+        bReloaded = true;
+    }
+    return bReloaded;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <tools/FileWatcher.h>
+#include <functional>
+#include <vector>
+
+class ProgramShader;
+
+// Watches the files linked programs were built from and rebuilds the programs that changed.
+// A rebuilt program replaces the old one only if it links, uniform handles resolved
+// against it must be refreshed by the callback
+class ProgramReloader
+{
+public:
+
+    using Callback = std::function<void(ProgramShader&)>;
+
+    void add(ProgramShader& program, const Callback& callback = nullptr);
+
+    // On the GL thread once per frame, true if a program was replaced
+    bool update();
+
+private:
+
+    struct Entry
+    {
+        ProgramShader* program;
+        Callback callback;
+        std::vector<std::string> dependencies;  // sorted
+    };
+
+    void watch(Entry& entry);
+
+    util::FileWatcher m_Watcher;
+    std::vector<Entry> m_Programs;
+    std::vector<std::string> m_Changed;
+};
@@ -1,5 +1,10 @@
 #include <cstdio>
 #include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <chrono>
 
 #include <GL/glew.h>
 #include <glm/gtc/type_ptr.hpp>
@@ -10,6 +15,7 @@
 #include <tools/FileUtility.h>
 #include <GLType/ProgramManager.h>
 #include <GLType/GraphicsDevice.h>
+#include <GLType/OGLDevice.h>
 #include <GLType/OGLGraphicsData.h>
 #include <GLType/OGLCoreGraphicsData.h>
 #include <GLType/OGLTexture.h>
@@ -19,9 +25,86 @@
 
 static std::vector<std::string> directory = { ".", "./shaders" };
 
+namespace
+{
+    // FNV-1a of a uniform name
+    uint32_t HashUniformName(const char* name) noexcept
+    {
+        uint32_t hash = 2166136261u;
+        for (; *name; ++name)
+            hash = (hash ^ uint8_t(*name)) * 16777619u;
+        return hash;
+    }
+
+    const char kBinaryMagic[4] = { 'G', 'L', 'P', 'B' };
+    const uint32_t kBinaryVersion = 1;
+
+    struct BinaryHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t key;
+        uint32_t format;
+        uint32_t size;
+    };
+
+    uint64_t HashBytes(uint64_t hash, const void* data, size_t size)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // A binary is only valid for the driver that produced it
+    const std::string& GetDriverString()
+    {
+        static std::string driver;
+        if (driver.empty())
+        {
+            for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+            {
+                const GLubyte* value = glGetString(name);
+                driver += value ? reinterpret_cast<const char*>(value) : "";
+                driver += '\n';
+            }
+        }
+        return driver;
+    }
+
+    // manualInclude places the defines right after the #version line
+    std::string InsertDefines(const std::string& source, const std::string& defines)
+    {
+        if (defines.empty())
+            return source;
+        size_t line = source.find('\n');
+        if (line == std::string::npos)
+            return source + "\n" + defines;
+        return source.substr(0, line + 1) + defines + source.substr(line + 1);
+    }
+
+    std::string GetBinaryPath(const std::string& directory, uint64_t key)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+        return directory + "/" + name;
+    }
+}
+
+std::mutex ProgramShader::s_GlswMutex;
+ShaderBlob ProgramShader::s_ShaderBlob;
+std::string ProgramShader::s_BinaryCacheDirectory;
+ProgramShader::BinaryCacheStats ProgramShader::s_BinaryCacheStats;
+
 ProgramShader::ProgramShader() noexcept
     : m_ShaderID(0u)
     , m_BlockPointCounter(0u)
+    , m_State(kStateIdle)
+    , m_bBinaryCache(false)
+    , m_BinaryKey(0)
 {
 }
 
@@ -39,7 +122,7 @@ bool ProgramShader::initialize() noexcept
     m_ShaderID = glCreateProgram();
 
 #ifdef GL_ARB_separate_shader_objects
-    glProgramParameteri(m_ShaderID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_FALSE);
+    glProgramParameteri(m_ShaderID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glProgramParameteri(m_ShaderID, GL_PROGRAM_SEPARABLE, GL_FALSE);
 #endif
     return true;
@@ -47,7 +130,21 @@ bool ProgramShader::initialize() noexcept
 
 void ProgramShader::destroy()
 {
+    if (m_ReloadTask.valid())
+        m_ReloadTask.wait();
+    m_Reload.reset();
+
+    for (auto& stage : m_Stages)
+    {
+        if (stage.shader) {
+            glDeleteShader(stage.shader);
+            stage.shader = GL_NONE;
+        }
+    }
     if (m_ShaderID) {
+        auto device = m_Device.lock();
+        if (device)
+            device->downcast_pointer<OGLDevice>()->invalidateProgram(m_ShaderID);
         glDeleteProgram(m_ShaderID);
         m_ShaderID = 0;
     }
@@ -57,45 +154,97 @@ void ProgramShader::addShader(GLenum shaderType, const std::string &tag)
 {
     // require initialization
     assert(m_ShaderID > 0);
+    assert(m_State == kStateIdle);
 
-    if (glswGetError() != 0) {
-        fprintf(stderr, "GLSW : %s", glswGetError());
-    }
-    assert(glswGetError() == 0);
+    // Loaded and preprocessed by submit(), or by preprocessPrograms() on worker threads
+    m_Stages.push_back(ShaderStage{ shaderType, tag, std::string(), GL_NONE, false, {} });
+}
 
-    util::BytesArray source = util::ReadFileSync("./shaders/" + tag);
-    if (source != util::NullFile)
-    {
-        std::string content((const char*)source->data());
-        buildShader(shaderType, tag, content);
-        return;
-    }
-    else
+void ProgramShader::setDefines(const std::string& defines)
+{
+    assert(m_State == kStateIdle);
+    m_Defines = defines;
+    for (auto& stage : m_Stages)
+        stage.bPreprocessed = false;
+}
+
+void ProgramShader::setValidator(const Validator& validator)
+{
+    assert(m_State == kStateIdle);
+    m_Validator = validator;
+}
+
+bool ProgramShader::preprocess()
+{
+    for (auto& stage : m_Stages)
     {
-        const GLchar *source = glswGetShader(tag.c_str());
-        if (0 != source)
+        if (stage.bPreprocessed)
+            continue;
+
+        stage.dependencies.clear();
+
+        // Flattened at build time, unless a source was edited since
+        const ShaderBlob::Entry* flattened = s_ShaderBlob.find(stage.tag);
+        if (flattened && flattened->isCurrent())
         {
-            std::string content(source);
-            buildShader(shaderType, tag, content);
-            return;
+            stage.source = InsertDefines(flattened->source, m_Defines);
+            for (const auto& dependency : flattened->dependencies)
+                stage.dependencies.push_back(dependency.path);
+            stage.bPreprocessed = true;
+            continue;
         }
+
+        std::string content;
+        util::BytesArray source = util::ReadFileSync("./shaders/" + stage.tag);
+        if (source != util::NullFile)
+        {
+            content.assign(source->data(), source->size());
+            stage.dependencies.push_back("./shaders/" + stage.tag);
+        }
+        else
+        {
+            // glsw keeps its effect files in global lists
+            std::lock_guard<std::mutex> lock(s_GlswMutex);
+            if (glswGetError() != 0) {
+                fprintf(stderr, "GLSW : %s", glswGetError());
+            }
+            assert(glswGetError() == 0);
+
+            const GLchar *source = glswGetShader(stage.tag.c_str());
+            if (0 == source)
+            {
+                fprintf(stderr, "Error : shader \"%s\" not found, check your directory.\n", stage.tag.c_str());
+                return false;
+            }
+            content = source;
+
+            // Effect file as set by glswSetPath in GameCore
+            stage.dependencies.push_back("./shaders/" + stage.tag.substr(0, stage.tag.find('.')) + ".glsl");
+        }
+        stage.source = buildShader(stage.tag, content, m_Defines, &stage.dependencies);
+        stage.bPreprocessed = true;
     }
+    return true;
+}
 
-    fprintf(stderr, "Error : shader \"%s\" not found, check your directory.\n", tag.c_str());
-    fprintf(stderr, "Execution terminated.\n");
-    exit(EXIT_FAILURE);
+std::string ProgramShader::buildShader(const std::string& tag, const std::string& content, const std::string& defines, std::vector<std::string>* dependencies)
+{
+    static const nv_helpers_gl::IncludeRegistry m_includes;
+    static const std::vector<std::string> directory = { ".", "./shaders" };
+    return nv_helpers_gl::manualInclude(tag, content, defines, directory, m_includes, dependencies);
 }
 
-void ProgramShader::buildShader(GLenum shaderType, const std::string& tag, const std::string& content)
+GLuint ProgramShader::compileShader(GLenum shaderType, const std::string& source) const
 {
-    static nv_helpers_gl::IncludeRegistry m_includes;
-    static std::vector<std::string> directory = { ".", "./shaders" };
-    const std::string preprocessed = nv_helpers_gl::manualInclude(tag, content, "", directory, m_includes);
-    char const* sourcePointer = preprocessed.c_str();
+    char const* sourcePointer = source.c_str();
     GLuint shader = glCreateShader(shaderType);
     glShaderSource(shader, 1, &sourcePointer, 0);
     glCompileShader(shader);
+    return shader;
+}
 
+bool ProgramShader::checkShader(GLuint shader, const std::string& tag) const
+{
     GLint status = 0;
     glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
 
@@ -104,33 +253,393 @@ void ProgramShader::buildShader(GLenum shaderType, const std::string& tag, const
         //Logger::getInstance().write( "shader \"%s\" compilation failed.\n", cTag);
         fprintf(stderr, "%s compilation failed.\n", tag.c_str());
         gltools::printShaderLog(shader);
-        exit(EXIT_FAILURE);
+        return false;
     }
 
     //Logger::getInstance().write( "%s compiled.\n", cTag);
     fprintf(stderr, "%s compiled.\n", tag.c_str());
+    return true;
+}
 
-    glAttachShader(m_ShaderID, shader);
-    glDeleteShader(shader);     //flag for deletion
+bool ProgramShader::submit()
+{
+    assert(m_State == kStateIdle);
+    if (!preprocess())
+    {
+        m_State = kStateFailed;
+        return false;
+    }
+
+    GLint formats = 0;
+    if (!s_BinaryCacheDirectory.empty() && GLEW_ARB_get_program_binary)
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+
+    m_bBinaryCache = formats > 0;
+    m_BinaryKey = m_bBinaryCache ? computeBinaryKey() : 0;
+    if (m_bBinaryCache)
+    {
+        if (loadBinary(m_BinaryKey))
+        {
+            s_BinaryCacheStats.hits++;
+            reflectUniforms();
+            m_State = (!m_Validator || m_Validator(*this)) ? kStateLinked : kStateFailed;
+            return true;
+        }
+        s_BinaryCacheStats.misses++;
+    }
+
+    // The driver may compile these on its own threads, nothing waits here
+    for (auto& stage : m_Stages)
+    {
+        stage.shader = compileShader(stage.type, stage.source);
+        glAttachShader(m_ShaderID, stage.shader);
+    }
+    m_State = kStateCompiling;
+    return true;
+}
+
+bool ProgramShader::poll()
+{
+    const bool bParallel = GLEW_ARB_parallel_shader_compile != GL_FALSE;
+
+    if (m_State == kStateCompiling)
+    {
+        if (bParallel)
+        {
+            for (const auto& stage : m_Stages)
+            {
+                GLint bCompleted = GL_FALSE;
+                glGetShaderiv(stage.shader, GL_COMPLETION_STATUS_ARB, &bCompleted);
+                if (!bCompleted)
+                    return false;
+            }
+        }
+
+        bool bCompiled = true;
+        for (auto& stage : m_Stages)
+            bCompiled &= checkShader(stage.shader, stage.tag);
+
+        if (bCompiled)
+            glLinkProgram(m_ShaderID);
+
+        for (auto& stage : m_Stages)
+        {
+            glDetachShader(m_ShaderID, stage.shader);
+            glDeleteShader(stage.shader);
+            stage.shader = GL_NONE;
+        }
+        if (!bCompiled)
+        {
+            m_State = kStateFailed;
+            return true;
+        }
+        m_State = kStateLinking;
+    }
+
+    if (m_State == kStateLinking)
+    {
+        if (bParallel)
+        {
+            GLint bCompleted = GL_FALSE;
+            glGetProgramiv(m_ShaderID, GL_COMPLETION_STATUS_ARB, &bCompleted);
+            if (!bCompleted)
+                return false;
+        }
+
+        // Test linking
+        GLint status = 0;
+        glGetProgramiv(m_ShaderID, GL_LINK_STATUS, &status);
+
+        if(status != GL_TRUE)
+        {
+            fprintf(stderr, "program linking failed.\n");
+            m_State = kStateFailed;
+            return true;
+        }
+
+        reflectUniforms();
+        if (m_Validator && !m_Validator(*this))
+        {
+            fprintf(stderr, "program rejected by its validator.\n");
+            m_State = kStateFailed;
+            return true;
+        }
+
+        if (m_bBinaryCache)
+            saveBinary(m_BinaryKey);
+        m_State = kStateLinked;
+    }
+    return m_State != kStateIdle;
 }
 
 bool ProgramShader::link()
 {
-    glLinkProgram(m_ShaderID);
+    if (m_State == kStateIdle)
+        submit();
+    while (!poll())
+        std::this_thread::yield();
+    return isLinked();
+}
 
-    // Test linking
-    GLint status = 0;
-    glGetProgramiv(m_ShaderID, GL_LINK_STATUS, &status);
+void ProgramShader::preprocessPrograms(ProgramShader* const* programs, size_t count)
+{
+    // File reads and include expansion don't touch GL, spread them over workers
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < count; i = next++)
+            programs[i]->preprocess();
+    };
+    std::vector<std::thread> threads(std::min<size_t>(count, std::max(1u, std::thread::hardware_concurrency())));
+    for (auto& thread : threads)
+        thread = std::thread(worker);
+    for (auto& thread : threads)
+        thread.join();
+}
+
+bool ProgramShader::linkPrograms(ProgramShader* const* programs, size_t count)
+{
+    if (GLEW_ARB_parallel_shader_compile)
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
 
-    if(status != GL_TRUE)
+    preprocessPrograms(programs, count);
+
+    // Submit everything first so the driver can overlap the compiles
+    for (size_t i = 0; i < count; i++)
+        programs[i]->submit();
+
+    size_t pending = count;
+    std::vector<bool> bDone(count, false);
+    while (pending > 0)
     {
-        fprintf(stderr, "program linking failed.\n");
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!bDone[i] && programs[i]->poll())
+            {
+                bDone[i] = true;
+                pending--;
+            }
+        }
+        if (pending > 0)
+            std::this_thread::yield();
+    }
+
+    bool bLinked = true;
+    for (size_t i = 0; i < count; i++)
+        bLinked &= programs[i]->isLinked();
+    return bLinked;
+}
+
+void ProgramShader::reload()
+{
+    assert(m_ShaderID != GL_NONE);
+
+    // A rebuild in flight is restarted with the newer sources
+    if (m_ReloadTask.valid())
+        m_ReloadTask.wait();
+    m_Reload.reset(new ProgramShader);
+    m_Reload->m_Device = m_Device;
+    m_Reload->initialize();
+    for (const auto& stage : m_Stages)
+        m_Reload->addShader(stage.type, stage.tag);
+    m_Reload->m_Defines = m_Defines;
+    m_Reload->m_Validator = m_Validator;
+
+    {
+        std::lock_guard<std::mutex> lock(s_GlswMutex);
+        glswReloadEffects();
+    }
+
+    ProgramShader* program = m_Reload.get();
+    m_ReloadTask = std::async(std::launch::async, [program]() { return program->preprocess(); });
+}
+
+bool ProgramShader::pollReload()
+{
+    if (!m_Reload)
         return false;
+
+    if (m_ReloadTask.valid())
+    {
+        if (m_ReloadTask.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return false;
+        m_ReloadTask.get();
+        m_Reload->submit();
     }
+    if (!m_Reload->poll())
+        return false;
 
+    if (!m_Reload->isLinked())
+    {
+        fprintf(stderr, "ProgramShader : reload failed, keeping the previous program.\n");
+        m_Reload.reset();
+        return false;
+    }
+
+    // Block bindings are program state, give the new program the same binding points
+    for (const auto& block : m_BlockPoints)
+    {
+        GLuint index = glGetUniformBlockIndex(m_Reload->m_ShaderID, block.first.c_str());
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(m_Reload->m_ShaderID, index, block.second);
+    }
+
+    std::swap(m_ShaderID, m_Reload->m_ShaderID);
+    std::swap(m_Stages, m_Reload->m_Stages);
+    std::swap(m_Uniforms, m_Reload->m_Uniforms);
+    m_State = kStateLinked;
+
+    // Deletes the previous program
+    m_Reload.reset();
+    return true;
+}
+
+std::vector<std::string> ProgramShader::getDependencies() const
+{
+    std::vector<std::string> dependencies;
+    for (const auto& stage : m_Stages)
+        dependencies.insert(dependencies.end(), stage.dependencies.begin(), stage.dependencies.end());
+    std::sort(dependencies.begin(), dependencies.end());
+    dependencies.erase(std::unique(dependencies.begin(), dependencies.end()), dependencies.end());
+    return dependencies;
+}
+
+void ProgramShader::setBinaryCacheDirectory(const std::string& directory)
+{
+    s_BinaryCacheDirectory = directory;
+}
+
+bool ProgramShader::loadShaderBlob(const std::string& filename)
+{
+    if (!s_ShaderBlob.read(filename))
+        return false;
+    printf("ProgramShader : %u flattened shaders from \"%s\".\n", uint32_t(s_ShaderBlob.size()), filename.c_str());
     return true;
 }
 
+uint64_t ProgramShader::computeBinaryKey() const
+{
+    const std::string& driver = GetDriverString();
+    uint64_t hash = HashBytes(14695981039346656037ull, driver.data(), driver.size());
+    for (const auto& stage : m_Stages)
+    {
+        // The defines are part of the preprocessed source
+        const uint64_t size = stage.source.size();
+        hash = HashBytes(hash, &stage.type, sizeof(stage.type));
+        hash = HashBytes(hash, &size, sizeof(size));
+        hash = HashBytes(hash, stage.source.data(), stage.source.size());
+    }
+    return hash;
+}
+
+bool ProgramShader::loadBinary(uint64_t key)
+{
+    util::BytesArray data = util::ReadFileSync(GetBinaryPath(s_BinaryCacheDirectory, key), std::ios::binary);
+    if (data == util::NullFile || data->size() < sizeof(BinaryHeader))
+        return false;
+
+    BinaryHeader header;
+    std::memcpy(&header, data->data(), sizeof(header));
+    if (std::memcmp(header.magic, kBinaryMagic, sizeof(kBinaryMagic)) != 0
+        || header.version != kBinaryVersion
+        || header.key != key
+        || header.size != data->size() - sizeof(header))
+        return false;
+
+    glProgramBinary(m_ShaderID, header.format, data->data() + sizeof(header), header.size);
+
+    // Rejected after a driver update, compile from source instead
+    GLint status = 0;
+    glGetProgramiv(m_ShaderID, GL_LINK_STATUS, &status);
+    return status == GL_TRUE;
+}
+
+void ProgramShader::saveBinary(uint64_t key) const
+{
+    GLint length = 0;
+    glGetProgramiv(m_ShaderID, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    auto data = std::make_shared<util::FileContainer>(sizeof(BinaryHeader) + length);
+
+    GLenum format = GL_NONE;
+    GLsizei written = 0;
+    glGetProgramBinary(m_ShaderID, length, &written, &format, data->data() + sizeof(BinaryHeader));
+    if (written <= 0)
+        return;
+    data->resize(sizeof(BinaryHeader) + written);
+
+    BinaryHeader header;
+    std::memcpy(header.magic, kBinaryMagic, sizeof(kBinaryMagic));
+    header.version = kBinaryVersion;
+    header.key = key;
+    header.format = format;
+    header.size = uint32_t(written);
+    std::memcpy(data->data(), &header, sizeof(header));
+
+    const std::string path = GetBinaryPath(s_BinaryCacheDirectory, key);
+    if (!util::MakeDirectory(s_BinaryCacheDirectory) || !util::WriteFileSync(path, data))
+        printf("ProgramShader : can't write \"%s\".\n", path.c_str());
+}
+
+void ProgramShader::reflectUniforms()
+{
+    m_Uniforms.clear();
+
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(m_ShaderID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(m_ShaderID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+    std::vector<GLchar> buffer(std::max(maxLength, 1));
+    for (GLint i = 0; i < count; i++)
+    {
+        GLsizei length = 0;
+        glGetActiveUniformName(m_ShaderID, GLuint(i), GLsizei(buffer.size()), &length, buffer.data());
+        std::string name(buffer.data(), length);
+
+        // Members of uniform blocks have no location
+        GLint location = glGetUniformLocation(m_ShaderID, name.c_str());
+        if (location == -1)
+            continue;
+
+        m_Uniforms.push_back(UniformEntry{ HashUniformName(name.c_str()), location, name });
+
+        // Arrays are reported as "name[0]", also accept the bare name
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+        {
+            name.resize(name.size() - 3);
+            m_Uniforms.push_back(UniformEntry{ HashUniformName(name.c_str()), location, name });
+        }
+    }
+
+    std::sort(m_Uniforms.begin(), m_Uniforms.end(), [](const UniformEntry& a, const UniformEntry& b) {
+        return a.hash < b.hash;
+    });
+}
+
+GLint ProgramShader::findUniformLocation(const std::string& name) const
+{
+    const uint32_t hash = HashUniformName(name.c_str());
+    auto it = std::lower_bound(m_Uniforms.begin(), m_Uniforms.end(), hash, [](const UniformEntry& entry, uint32_t hash) {
+        return entry.hash < hash;
+    });
+    for (; it != m_Uniforms.end() && it->hash == hash; ++it)
+    {
+        if (it->name == name)
+            return it->location;
+    }
+    return -1;
+}
+
+UniformHandle ProgramShader::getUniformHandle(const std::string& name) const
+{
+    UniformHandle handle;
+    handle.location = findUniformLocation(name);
+    if (!handle.isValid())
+        printf("ProgramShader : can't find uniform \"%s\".\n", name.c_str());
+    return handle;
+}
+
 bool ProgramShader::initBlockBinding(const std::string& name)
 {
     GLint block = glGetUniformBlockIndex(m_ShaderID, name.c_str());
@@ -146,14 +655,38 @@ bool ProgramShader::initBlockBinding(const std::string& name)
     return true;
 }
 
+GLint ProgramShader::getBlockPoint(const std::string& name) const
+{
+    auto it = m_BlockPoints.find(name);
+    return it == m_BlockPoints.end() ? -1 : GLint(it->second);
+}
+
 void ProgramShader::setDevice(const GraphicsDevicePtr& device)
 {
     m_Device = device;
 }
 
+void ProgramShader::bind() const
+{
+    auto device = m_Device.lock();
+    if (device)
+        device->downcast_pointer<OGLDevice>()->setProgram(m_ShaderID);
+    else
+        glUseProgram(m_ShaderID);
+}
+
+void ProgramShader::unbind() const
+{
+    auto device = m_Device.lock();
+    if (device)
+        device->downcast_pointer<OGLDevice>()->setProgram(0u);
+    else
+        glUseProgram(0u);
+}
+
 bool ProgramShader::setUniform(const std::string &name, GLint v) const
 {
-    GLint loc = glGetUniformLocation(m_ShaderID, name.c_str());
+    GLint loc = findUniformLocation(name);
 
     if(-1 == loc)
     {
@@ -168,7 +701,7 @@ bool ProgramShader::setUniform(const std::string &name, GLint v) const
 
 bool ProgramShader::setUniform(const std::string &name, GLfloat v) const
 {
-    GLint loc = glGetUniformLocation(m_ShaderID, name.c_str());
+    GLint loc = findUniformLocation(name);
 
     if(-1 == loc)
     {
@@ -182,7 +715,7 @@ bool ProgramShader::setUniform(const std::string &name, GLfloat v) const
 
 bool ProgramShader::setUniform(const std::string& name, const glm::vec2& v) const
 {
-    GLint loc = glGetUniformLocation(m_ShaderID, name.c_str());
+    GLint loc = findUniformLocation(name);
 
     if(-1 == loc)
     {
@@ -196,7 +729,7 @@ bool ProgramShader::setUniform(const std::string& name, const glm::vec2& v) cons
 
 bool ProgramShader::setUniform(const std::string &name, const glm::vec3 &v) const
 {
-    GLint loc = glGetUniformLocation(m_ShaderID, name.c_str());
+    GLint loc = findUniformLocation(name);
 
     if(-1 == loc)
     {
@@ -210,7 +743,7 @@ bool ProgramShader::setUniform(const std::string &name, const glm::vec3 &v) cons
 
 bool ProgramShader::setUniform(const std::string &name, const glm::vec4 &v) const
 {
-    GLint loc = glGetUniformLocation(m_ShaderID, name.c_str());
+    GLint loc = findUniformLocation(name);
 
     if(-1 == loc)
     {
@@ -224,7 +757,7 @@ bool ProgramShader::setUniform(const std::string &name, const glm::vec4 &v) cons
 
 bool ProgramShader::setUniform(const std::string& name, const glm::vec2* v, size_t count) const
 {
-    GLint loc = glGetUniformLocation(m_ShaderID, name.c_str());
+    GLint loc = findUniformLocation(name);
     if (-1 == loc)
     {
         printf("ProgramShader : can't find uniform \"%s\".\n", name.c_str());
@@ -240,7 +773,7 @@ bool ProgramShader::setUniform(const std::string& name, const glm::vec2* v, size
 
 bool ProgramShader::setUniform(const std::string& name, const glm::vec4* v, size_t count) const
 {
-    GLint loc = glGetUniformLocation(m_ShaderID, name.c_str());
+    GLint loc = findUniformLocation(name);
     if (-1 == loc)
     {
         printf("ProgramShader : can't find uniform \"%s\".\n", name.c_str());
@@ -256,7 +789,7 @@ bool ProgramShader::setUniform(const std::string& name, const glm::vec4* v, size
 
 bool ProgramShader::setUniform(const std::string& name, const glm::mat3& v) const
 {
-    GLint loc = glGetUniformLocation(m_ShaderID, name.c_str());
+    GLint loc = findUniformLocation(name);
 
     if(-1 == loc)
     {
@@ -270,7 +803,7 @@ bool ProgramShader::setUniform(const std::string& name, const glm::mat3& v) cons
 
 bool ProgramShader::setUniform(const std::string &name, const glm::mat4 &v) const
 {
-    GLint loc = glGetUniformLocation(m_ShaderID, name.c_str());
+    GLint loc = findUniformLocation(name);
 
     if(-1 == loc)
     {
@@ -284,16 +817,25 @@ bool ProgramShader::setUniform(const std::string &name, const glm::mat4 &v) cons
 
 bool ProgramShader::bindTexture(const std::string& name, const GraphicsTexturePtr& texture, GLint unit)
 {
-    assert(texture);
-    assert(unit >= 0);
+    UniformHandle handle;
+    handle.location = findUniformLocation(name);
 
-    GLint loc = glGetUniformLocation(m_ShaderID, name.c_str());
-
-    if (-1 == loc)
+    if (!handle.isValid())
     {
         printf("ProgramShader : can't find texture \"%s\".\n", name.c_str());
         return false;
     }
+    return bindTexture(handle, texture, unit);
+}
+
+bool ProgramShader::bindTexture(UniformHandle handle, const GraphicsTexturePtr& texture, GLint unit)
+{
+    assert(texture);
+    assert(unit >= 0);
+
+    GLint loc = handle.location;
+    if (-1 == loc)
+        return false;
 
     auto device = m_Device.lock();
     assert(device);
@@ -319,6 +861,11 @@ bool ProgramShader::bindTexture(const std::string& name, const GraphicsTexturePt
 }
 
 bool ProgramShader::bindBuffer(const std::string& name, const GraphicsDataPtr& data)
+{
+    return bindBuffer(name, data, 0, 0);
+}
+
+bool ProgramShader::bindBuffer(const std::string& name, const GraphicsDataPtr& data, GLintptr offset, GLsizeiptr size)
 {
     auto device = m_Device.lock();
     if (!device) return false;
@@ -329,26 +876,26 @@ bool ProgramShader::bindBuffer(const std::string& name, const GraphicsDataPtr& d
     auto blockPoint = it->second;
     auto type = device->getGraphicsDeviceDesc().getDeviceType();
 
-    // Bind the buffer object to the uniform block
+    GLuint buffer = GL_NONE;
     if (type == GraphicsDeviceType::GraphicsDeviceTypeOpenGLCore)
-    {
-        auto ubo = data->downcast_pointer<OGLCoreGraphicsData>();
-        glBindBufferBase(GL_UNIFORM_BUFFER, blockPoint, ubo->getInstanceID());
-        return true;
-    }
+        buffer = data->downcast_pointer<OGLCoreGraphicsData>()->getInstanceID();
     else if (type == GraphicsDeviceType::GraphicsDeviceTypeOpenGL)
-    {
-        auto ubo = data->downcast_pointer<OGLGraphicsData>();
-        glBindBufferBase(GL_UNIFORM_BUFFER, blockPoint, ubo->getInstanceID());
-        return true;
-    }
-    return false;
+        buffer = data->downcast_pointer<OGLGraphicsData>()->getInstanceID();
+    else
+        return false;
+
+    // Bind the buffer object to the uniform block, a zero size binds all of it
+    if (size == 0)
+        glBindBufferBase(GL_UNIFORM_BUFFER, blockPoint, buffer);
+    else
+        glBindBufferRange(GL_UNIFORM_BUFFER, blockPoint, buffer, offset, size);
+    return true;
 }
 
 bool ProgramShader::bindImage(const std::string &name, const OGLCoreTexturePtr &texture,
     GLint unit, GLint level, GLboolean layered, GLint layer, GLenum access)
 {
-    GLint loc = glGetUniformLocation(m_ShaderID, name.c_str());
+    GLint loc = findUniformLocation(name);
 
     if (-1 == loc)
     {
@@ -5,13 +5,29 @@
 #include <Math/Common.h>
 #include <string>
 #include <GraphicsTypes.h>
+#include <GLType/ShaderBlob.h>
 #include <vector>
 #include <map>
+#include <functional>
 #include <string_view>
+#include <cstdint>
+#include <mutex>
+#include <memory>
+#include <future>
+
+// Uniform location resolved once after link(), for callers setting it every frame
+struct UniformHandle
+{
+    GLint location = -1;
+
+    bool isValid() const noexcept { return location != -1; }
+};
 
 class ProgramShader
 {
 public:
+    using Validator = std::function<bool(const ProgramShader&)>;
+
     ProgramShader() noexcept;
     virtual ~ProgramShader() noexcept;
     
@@ -21,23 +37,55 @@ public:
     /** Destroy the program id */
     void destroy();        
     
-    /** Add a shader and compile it */
+    /** Add a shader, compiled by link() unless the binary cache has the program */
     void addShader(GLenum shaderType, const std::string &tag);
+
+    /** #define lines inserted after #version in every stage, set before linking */
+    void setDefines(const std::string& defines);
+
+    /** Checked once linked, a rejected program counts as failed and a rejected reload is dropped */
+    void setValidator(const Validator& validator);
+
+    /** Start compiling the stages, the driver may finish them in the background */
+    bool submit();
+    /** Advance a submitted program, false while the driver is still busy */
+    bool poll();
+    /** submit() and poll() until done */
+    bool link();
+
+    bool isLinked() const { return m_State == kStateLinked; }
+    bool isFailed() const { return m_State == kStateFailed; }
+    bool isSubmitted() const { return m_State != kStateIdle; }
+
+    /** Link several programs at once, overlapping their compiles */
+    static bool linkPrograms(ProgramShader* const* programs, size_t count);
+
+    /** Rebuild from the current sources, preprocessed on a worker thread */
+    void reload();
+    /** Advance a reload, true once the rebuilt program replaced this one.
+        A failed rebuild is dropped and the previous program kept */
+    bool pollReload();
+    bool isReloading() const { return m_Reload != nullptr; }
+
+    /** Files the stages were built from, including the included ones */
+    std::vector<std::string> getDependencies() const;
     
-    //bool compile(); //static (with param)?
-    
-    bool link(); //static (with param)?
-    
-    void bind() const { glUseProgram( m_ShaderID ); }
-    void unbind() const { glUseProgram( 0u ); }
+    /** Goes through the device state cache once setDevice was called */
+    void bind() const;
+    void unbind() const;
     
     /** Return the program id */
     GLuint getShaderID() const { return m_ShaderID; }
     
     bool initBlockBinding(const std::string& name);
+    /** Binding point given by initBlockBinding, -1 if there is none */
+    GLint getBlockPoint(const std::string& name) const;
 
     void setDevice(const GraphicsDevicePtr& device);
 
+    /** Look up a reflected uniform, invalid if it isn't active */
+    UniformHandle getUniformHandle(const std::string& name) const;
+
     bool setUniform(const std::string& name, GLint v) const;
     bool setUniform(const std::string& name, GLfloat v) const;
     bool setUniform(const std::string& name, const glm::vec2& v) const;
@@ -48,7 +96,17 @@ public:
     bool setUniform(const std::string& name, const glm::mat3& v) const;
     bool setUniform(const std::string& name, const glm::mat4& v) const;
     bool bindTexture(const std::string& name, const GraphicsTexturePtr& texture, GLint unit);
+    bool bindTexture(UniformHandle handle, const GraphicsTexturePtr& texture, GLint unit);
+
+    void setUniform(UniformHandle handle, GLint v) const;
+    void setUniform(UniformHandle handle, GLfloat v) const;
+    void setUniform(UniformHandle handle, const glm::vec2& v) const;
+    void setUniform(UniformHandle handle, const glm::vec3& v) const;
+    void setUniform(UniformHandle handle, const glm::vec4& v) const;
+    void setUniform(UniformHandle handle, const glm::mat3& v) const;
+    void setUniform(UniformHandle handle, const glm::mat4& v) const;
     bool bindBuffer(const std::string& name, const GraphicsDataPtr& data);
+    bool bindBuffer(const std::string& name, const GraphicsDataPtr& data, GLintptr offset, GLsizeiptr size);
 
     // Compute
     bool bindImage(const std::string &name, const OGLCoreTexturePtr &texture, GLint unit, GLint level, GLboolean layered, GLint layer, GLenum access);
@@ -58,12 +116,34 @@ public:
     void Dispatch2D( GLuint ThreadCountX, GLuint ThreadCountY, GLuint GroupSizeX = 8, GLuint GroupSizeY = 8);
     void Dispatch3D( GLuint ThreadCountX, GLuint ThreadCountY, GLuint ThreadCountZ, GLuint GroupSizeX = 4, GLuint GroupSizeY = 4, GLuint GroupSizeZ = 4 );
   
+    struct BinaryCacheStats
+    {
+        uint32_t hits = 0;
+        uint32_t misses = 0;
+    };
+
+    /** Directory of the program binary cache, empty disables it */
+    static void setBinaryCacheDirectory(const std::string& directory);
+    static BinaryCacheStats getBinaryCacheStats() { return s_BinaryCacheStats; }
+
+    /** Stages flattened at build time, used instead of the sources they are current with */
+    static bool loadShaderBlob(const std::string& filename);
+
     static bool setIncludeFromFile(const std::string &includeName, const std::string &filename);
     static std::vector<char> readTextFile(const std::string &filename);
 
 protected:
 
-    void buildShader(GLenum shaderType, const std::string& tag, const std::string& content);
+    bool preprocess();
+    static void preprocessPrograms(ProgramShader* const* programs, size_t count);
+    static std::string buildShader(const std::string& tag, const std::string& content, const std::string& defines, std::vector<std::string>* dependencies);
+    GLuint compileShader(GLenum shaderType, const std::string& source) const;
+    bool checkShader(GLuint shader, const std::string& tag) const;
+    uint64_t computeBinaryKey() const;
+    bool loadBinary(uint64_t key);
+    void saveBinary(uint64_t key) const;
+    void reflectUniforms();
+    GLint findUniformLocation(const std::string& name) const;
 
     static std::vector<std::string> directory;
 
@@ -71,8 +151,80 @@ protected:
     GLuint m_BlockPointCounter;
     GraphicsDeviceWeakPtr m_Device;
     std::map<std::string, GLuint> m_BlockPoints;
+
+    enum State { kStateIdle, kStateCompiling, kStateLinking, kStateLinked, kStateFailed };
+
+    struct ShaderStage
+    {
+        GLenum type;
+        std::string tag;
+        std::string source;     // after manualInclude
+        GLuint shader;
+        bool bPreprocessed;
+        std::vector<std::string> dependencies;
+    };
+
+    std::vector<ShaderStage> m_Stages;
+    std::string m_Defines;
+    Validator m_Validator;
+    State m_State;
+    bool m_bBinaryCache;
+    uint64_t m_BinaryKey;
+
+    std::unique_ptr<ProgramShader> m_Reload;
+    std::future<bool> m_ReloadTask;
+
+    static std::mutex s_GlswMutex;
+    static ShaderBlob s_ShaderBlob;
+    static std::string s_BinaryCacheDirectory;
+    static BinaryCacheStats s_BinaryCacheStats;
+
+    struct UniformEntry
+    {
+        uint32_t hash;
+        GLint location;
+        std::string name;
+    };
+
+    // Active uniforms outside of blocks, sorted by hash
+    std::vector<UniformEntry> m_Uniforms;
 };
 
+inline void ProgramShader::setUniform(UniformHandle handle, GLint v) const
+{
+    glUniform1i(handle.location, v);
+}
+
+inline void ProgramShader::setUniform(UniformHandle handle, GLfloat v) const
+{
+    glUniform1f(handle.location, v);
+}
+
+inline void ProgramShader::setUniform(UniformHandle handle, const glm::vec2& v) const
+{
+    glUniform2fv(handle.location, 1, &v[0]);
+}
+
+inline void ProgramShader::setUniform(UniformHandle handle, const glm::vec3& v) const
+{
+    glUniform3fv(handle.location, 1, &v[0]);
+}
+
+inline void ProgramShader::setUniform(UniformHandle handle, const glm::vec4& v) const
+{
+    glUniform4fv(handle.location, 1, &v[0]);
+}
+
+inline void ProgramShader::setUniform(UniformHandle handle, const glm::mat3& v) const
+{
+    glUniformMatrix3fv(handle.location, 1, GL_FALSE, &v[0][0]);
+}
+
+inline void ProgramShader::setUniform(UniformHandle handle, const glm::mat4& v) const
+{
+    glUniformMatrix4fv(handle.location, 1, GL_FALSE, &v[0][0]);
+}
+
 inline void ProgramShader::Dispatch( GLuint GroupCountX, GLuint GroupCountY, GLuint GroupCountZ )
 {
     glDispatchCompute(GroupCountX, GroupCountY, GroupCountZ);
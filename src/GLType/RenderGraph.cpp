@@ -0,0 +1,324 @@
+#include <GLType/RenderGraph.h>
+#include <GLType/OGLDevice.h>
+#include <GLType/GraphicsFramebuffer.h>
+#include <GLType/GraphicsCommandList.h>
+#include <algorithm>
+#include <cassert>
+
+RenderGraph::Resource RenderGraph::Builder::create(const std::string& name, const GraphicsTextureDesc& desc, int32_t width, int32_t height)
+{
+    ResourceNode node;
+    node.name = name;
+    node.desc = desc;
+    node.width = width > 0 ? width : desc.getWidth();
+    node.height = height > 0 ? height : desc.getHeight();
+    node.bImported = false;
+    node.bBackbuffer = false;
+    m_Graph.m_Resources.push_back(node);
+    return Resource(m_Graph.m_Resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::Builder::read(Resource resource)
+{
+    assert(resource < m_Graph.m_Resources.size());
+    m_Graph.m_Passes[m_Pass].reads.push_back(resource);
+    return resource;
+}
+
+RenderGraph::Resource RenderGraph::Builder::write(Resource resource, Access access)
+{
+    assert(resource < m_Graph.m_Resources.size());
+    assert(access == kAccessRenderTarget || !m_Graph.m_Resources[resource].bBackbuffer);
+    m_Graph.m_Passes[m_Pass].writes.emplace_back(resource, access);
+    return resource;
+}
+
+void RenderGraph::Builder::setSideEffect()
+{
+    m_Graph.m_Passes[m_Pass].bSideEffect = true;
+}
+
+const GraphicsTexturePtr& RenderGraph::Resources::getTexture(Resource resource) const
+{
+    assert(resource < m_Graph.m_Resources.size());
+    return m_Graph.m_Resources[resource].texture;
+}
+
+RenderGraph::RenderGraph() noexcept :
+    m_QueryFrame(0),
+    m_Frame(0)
+{
+}
+
+RenderGraph::~RenderGraph() noexcept
+{
+    for (auto& frame : m_Queries)
+    {
+        if (!frame.queries.empty())
+            glDeleteQueries(GLsizei(frame.queries.size()), frame.queries.data());
+    }
+}
+
+void RenderGraph::addPass(const std::string& name, const Setup& setup, const Execute& execute)
+{
+    PassNode pass;
+    pass.name = name;
+    pass.execute = execute;
+    pass.bAlive = false;
+    pass.bSideEffect = false;
+    pass.bBarrier = false;
+    m_Passes.push_back(pass);
+
+    Builder builder(*this, uint32_t(m_Passes.size() - 1));
+    setup(builder);
+}
+
+RenderGraph::Resource RenderGraph::import(const std::string& name, const GraphicsTexturePtr& texture, int32_t width, int32_t height)
+{
+    assert(texture);
+    ResourceNode node;
+    node.name = name;
+    node.desc = texture->getGraphicsTextureDesc();
+    node.texture = texture;
+    node.width = width > 0 ? width : node.desc.getWidth();
+    node.height = height > 0 ? height : node.desc.getHeight();
+    node.bImported = true;
+    node.bBackbuffer = false;
+    m_Resources.push_back(node);
+    return Resource(m_Resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::importBackbuffer(int32_t width, int32_t height)
+{
+    ResourceNode node;
+    node.name = "Backbuffer";
+    node.desc.setWidth(width);
+    node.desc.setHeight(height);
+    node.width = width;
+    node.height = height;
+    node.bImported = true;
+    node.bBackbuffer = true;
+    m_Resources.push_back(node);
+    return Resource(m_Resources.size() - 1);
+}
+
+void RenderGraph::compile(OGLDevice& device)
+{
+    m_Stats = Stats();
+    m_Stats.passes = uint32_t(m_Passes.size());
+
+    // Walk back from the outputs, a pass lives if a live pass reads what it writes
+    for (auto& resource : m_Resources)
+    {
+        resource.bNeeded = resource.bImported;
+        resource.firstPass = ~0u;
+        resource.lastPass = 0;
+    }
+    for (size_t i = m_Passes.size(); i-- > 0; )
+    {
+        auto& pass = m_Passes[i];
+        pass.bAlive = pass.bSideEffect;
+        for (const auto& write : pass.writes)
+            pass.bAlive |= m_Resources[write.first].bNeeded;
+        if (!pass.bAlive)
+        {
+            m_Stats.culled++;
+            continue;
+        }
+        for (Resource read : pass.reads)
+            m_Resources[read].bNeeded = true;
+    }
+
+    // Lifetimes and barriers over the live passes, in execution order
+    std::vector<Access> lastAccess(m_Resources.size(), kAccessRenderTarget);
+    for (uint32_t i = 0; i < m_Passes.size(); i++)
+    {
+        auto& pass = m_Passes[i];
+        if (!pass.bAlive)
+            continue;
+
+        pass.bBarrier = false;
+        for (Resource read : pass.reads)
+        {
+            pass.bBarrier |= lastAccess[read] == kAccessStorage;
+            m_Resources[read].firstPass = std::min(m_Resources[read].firstPass, i);
+            m_Resources[read].lastPass = std::max(m_Resources[read].lastPass, i);
+        }
+        for (const auto& write : pass.writes)
+        {
+            lastAccess[write.first] = write.second;
+            m_Resources[write.first].firstPass = std::min(m_Resources[write.first].firstPass, i);
+            m_Resources[write.first].lastPass = std::max(m_Resources[write.first].lastPass, i);
+        }
+    }
+
+    // A transient is given back after its last pass, the next one created with the same descriptor aliases it
+    std::vector<GraphicsTexture*> allocated;
+    for (uint32_t i = 0; i < m_Passes.size(); i++)
+    {
+        if (!m_Passes[i].bAlive)
+            continue;
+        for (auto& resource : m_Resources)
+        {
+            if (resource.bImported || resource.firstPass != i)
+                continue;
+            resource.texture = device.acquireTexture(resource.desc);
+            assert(resource.texture);
+
+            const size_t size = OGLDevice::computeTextureSize(resource.desc);
+            m_Stats.transients++;
+            m_Stats.unaliasedBytes += size;
+            if (std::find(allocated.begin(), allocated.end(), resource.texture.get()) == allocated.end())
+            {
+                allocated.push_back(resource.texture.get());
+                m_Stats.transientBytes += size;
+            }
+        }
+        for (auto& resource : m_Resources)
+        {
+            if (!resource.bImported && resource.texture && resource.lastPass == i)
+                device.releaseTexture(resource.texture);
+        }
+    }
+}
+
+const GraphicsFramebufferPtr& RenderGraph::getFramebuffer(OGLDevice& device, const PassNode& pass)
+{
+    std::vector<GraphicsTexture*> attachments;
+    for (const auto& write : pass.writes)
+    {
+        if (write.second == kAccessRenderTarget)
+            attachments.push_back(m_Resources[write.first].texture.get());
+    }
+
+    for (auto& cached : m_Framebuffers)
+    {
+        if (cached.attachments == attachments)
+        {
+            cached.lastFrame = m_Frame;
+            return cached.framebuffer;
+        }
+    }
+
+    GraphicsFramebufferDesc desc;
+    uint32_t color = 0;
+    for (const auto& write : pass.writes)
+    {
+        if (write.second != kAccessRenderTarget)
+            continue;
+        const auto& texture = m_Resources[write.first].texture;
+        if (gli::is_depth(texture->getGraphicsTextureDesc().getFormat()))
+            desc.addComponent(GraphicsAttachmentBinding(texture, GL_DEPTH_ATTACHMENT));
+        else
+            desc.addComponent(GraphicsAttachmentBinding(texture, GL_COLOR_ATTACHMENT0 + color++));
+    }
+
+    CachedFramebuffer cached;
+    cached.attachments = attachments;
+    cached.framebuffer = device.createFramebuffer(desc);
+    cached.lastFrame = m_Frame;
+    if (!cached.framebuffer)
+        printf("RenderGraph : can't create the framebuffer of \"%s\".\n", pass.name.c_str());
+    m_Framebuffers.push_back(cached);
+    return m_Framebuffers.back().framebuffer;
+}
+
+void RenderGraph::readTimings()
+{
+    auto& frame = m_Queries[m_QueryFrame];
+    if (!frame.bPending)
+        return;
+
+    GLuint last = frame.queries[frame.names.size()];
+    GLint available = GL_FALSE;
+    glGetQueryObjectiv(last, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return;
+
+    m_Timings.clear();
+    GLuint64 previous = 0;
+    glGetQueryObjectui64v(frame.queries[0], GL_QUERY_RESULT, &previous);
+    for (size_t i = 0; i < frame.names.size(); i++)
+    {
+        GLuint64 now = 0;
+        glGetQueryObjectui64v(frame.queries[i + 1], GL_QUERY_RESULT, &now);
+        m_Timings.push_back(PassTiming{ frame.names[i], float((now - previous) / 1e6) });
+        previous = now;
+    }
+    frame.bPending = false;
+}
+
+void RenderGraph::execute(OGLDevice& device, GraphicsCommandList& commands)
+{
+    // The slot about to be reused still holds results if the GPU lags more than kQueryLatency frames
+    readTimings();
+    QueryFrame* frame = &m_Queries[m_QueryFrame];
+    if (frame->bPending)
+        frame = nullptr;
+    else
+        frame->names.clear();
+
+    m_Frame++;
+    Resources resources(*this);
+    for (auto& pass : m_Passes)
+    {
+        if (!pass.bAlive)
+            continue;
+
+        if (frame)
+        {
+            const size_t index = frame->names.size();
+            while (frame->queries.size() < index + 2)
+            {
+                GLuint query = 0;
+                glGenQueries(1, &query);
+                frame->queries.push_back(query);
+            }
+            frame->names.push_back(pass.name);
+            GLuint query = frame->queries[index];
+            commands.call([query]() { glQueryCounter(query, GL_TIMESTAMP); });
+        }
+        if (pass.bBarrier)
+            commands.call([]() { glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT); });
+
+        // Render targets come from the writes, the backbuffer is exclusive
+        const ResourceNode* target = nullptr;
+        for (const auto& write : pass.writes)
+        {
+            if (write.second == kAccessRenderTarget)
+            {
+                target = &m_Resources[write.first];
+                break;
+            }
+        }
+        if (target)
+        {
+            if (target->bBackbuffer)
+                commands.setFramebuffer(nullptr);
+            else
+                commands.setFramebuffer(getFramebuffer(device, pass));
+            commands.setViewport(0, 0, target->width, target->height);
+        }
+        pass.execute(resources, commands);
+    }
+
+    if (frame && !frame->names.empty())
+    {
+        GLuint query = frame->queries[frame->names.size()];
+        commands.call([query]() { glQueryCounter(query, GL_TIMESTAMP); });
+        frame->bPending = true;
+    }
+    m_QueryFrame = (m_QueryFrame + 1) % kQueryLatency;
+
+    // Framebuffers hold their attachments, let idle ones go back with them; the commands retain those in flight
+    const uint32_t now = m_Frame;
+    m_Framebuffers.erase(std::remove_if(m_Framebuffers.begin(), m_Framebuffers.end(),
+        [now](const CachedFramebuffer& cached) { return now - cached.lastFrame > kFramebufferIdleFrames; }), m_Framebuffers.end());
+}
+
+void RenderGraph::reset(OGLDevice& device)
+{
+    m_Passes.clear();
+    m_Resources.clear();
+    device.trimTexturePool();
+}
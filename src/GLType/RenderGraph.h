@@ -0,0 +1,158 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <GraphicsTypes.h>
+#include <GLType/GraphicsTexture.h>
+#include <functional>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class OGLDevice;
+class GraphicsCommandList;
+
+// Frame description rebuilt every frame: passes declare the textures they read and write,
+// compile() culls the passes nothing depends on and gives each transient texture a pooled one
+// for its lifetime, so transients used by disjoint passes share memory.
+// execute() records the passes in declaration order, binding their render targets and
+// inserting the memory barriers storage writes need; each pass is timed on the GPU
+class RenderGraph
+{
+public:
+
+    typedef uint32_t Resource;
+    static const Resource kInvalidResource = ~0u;
+
+    enum Access
+    {
+        kAccessRenderTarget,    // attached to the pass framebuffer
+        kAccessStorage,         // written with image stores, readers need a barrier
+    };
+
+    class Builder
+    {
+    public:
+        // Passes rendering into it get a width x height viewport, zero is the whole texture
+        Resource create(const std::string& name, const GraphicsTextureDesc& desc, int32_t width = 0, int32_t height = 0);
+        Resource read(Resource resource);
+        Resource write(Resource resource, Access access = kAccessRenderTarget);
+        // Keep the pass even if nothing reads its outputs
+        void setSideEffect();
+
+    private:
+        friend class RenderGraph;
+        Builder(RenderGraph& graph, uint32_t pass) : m_Graph(graph), m_Pass(pass) {}
+
+        RenderGraph& m_Graph;
+        uint32_t m_Pass;
+    };
+
+    class Resources
+    {
+    public:
+        const GraphicsTexturePtr& getTexture(Resource resource) const;
+
+    private:
+        friend class RenderGraph;
+        explicit Resources(const RenderGraph& graph) : m_Graph(graph) {}
+
+        const RenderGraph& m_Graph;
+    };
+
+    typedef std::function<void(Builder&)> Setup;
+    typedef std::function<void(const Resources&, GraphicsCommandList&)> Execute;
+
+    struct Stats
+    {
+        uint32_t passes = 0;
+        uint32_t culled = 0;
+        uint32_t transients = 0;
+        size_t transientBytes = 0;      // textures actually allocated for transients
+        size_t unaliasedBytes = 0;      // what one texture per transient would take
+    };
+
+    struct PassTiming
+    {
+        std::string name;
+        float gpuTime;                  // ms, a few frames old
+    };
+
+    RenderGraph() noexcept;
+    ~RenderGraph() noexcept;
+
+    // Setup runs immediately, execute from execute()
+    void addPass(const std::string& name, const Setup& setup, const Execute& execute);
+
+    // Textures owned outside the graph, writing one keeps the writer alive.
+    // Passes rendering into it get a width x height viewport, zero is the whole texture
+    Resource import(const std::string& name, const GraphicsTexturePtr& texture, int32_t width = 0, int32_t height = 0);
+    Resource importBackbuffer(int32_t width, int32_t height);
+
+    void compile(OGLDevice& device);
+    void execute(OGLDevice& device, GraphicsCommandList& commands);
+    // Give the transients back and drop the passes, framebuffers and queries are kept
+    void reset(OGLDevice& device);
+
+    const Stats& getStats() const noexcept { return m_Stats; }
+    const std::vector<PassTiming>& getPassTimings() const noexcept { return m_Timings; }
+
+private:
+
+    RenderGraph(const RenderGraph&) = delete;
+    RenderGraph& operator=(const RenderGraph&) = delete;
+
+    static const uint32_t kQueryLatency = 3;
+    // Passes may skip frames, keep their framebuffers a while
+    static const uint32_t kFramebufferIdleFrames = 240;
+
+    struct ResourceNode
+    {
+        std::string name;
+        GraphicsTextureDesc desc;
+        GraphicsTexturePtr texture;
+        int32_t width;          // of the viewport
+        int32_t height;
+        bool bImported;
+        bool bBackbuffer;
+        bool bNeeded;           // read by a live pass, or imported
+        uint32_t firstPass;
+        uint32_t lastPass;
+    };
+
+    struct PassNode
+    {
+        std::string name;
+        Execute execute;
+        std::vector<Resource> reads;
+        std::vector<std::pair<Resource, Access>> writes;
+        bool bAlive;
+        bool bSideEffect;
+        bool bBarrier;          // reads a storage write
+    };
+
+    struct CachedFramebuffer
+    {
+        std::vector<GraphicsTexture*> attachments;
+        GraphicsFramebufferPtr framebuffer;
+        uint32_t lastFrame;
+    };
+
+    struct QueryFrame
+    {
+        std::vector<GLuint> queries;    // one before each pass and one after the last
+        std::vector<std::string> names;
+        bool bPending = false;
+    };
+
+    const GraphicsFramebufferPtr& getFramebuffer(OGLDevice& device, const PassNode& pass);
+    void readTimings();
+
+    std::vector<PassNode> m_Passes;
+    std::vector<ResourceNode> m_Resources;
+    std::vector<CachedFramebuffer> m_Framebuffers;
+    QueryFrame m_Queries[kQueryLatency];
+    uint32_t m_QueryFrame;
+    uint32_t m_Frame;
+    std::vector<PassTiming> m_Timings;
+    Stats m_Stats;
+};
@@ -0,0 +1,113 @@
+#include <GLType/ResizableRenderTarget.h>
+#include <GLType/OGLDevice.h>
+#include <GLType/GraphicsTexture.h>
+#include <Math/Common.h>
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+
+namespace
+{
+    // Growth while resizing, a quarter more rounded to 64 texels
+    int32_t GrowSize(int32_t size) noexcept
+    {
+        return Math::AlignUp(size + size / 4, 64);
+    }
+}
+
+const std::chrono::milliseconds ResizableRenderTarget::kSettleTime(250);
+
+ResizableRenderTarget::ResizableRenderTarget() noexcept :
+    m_Format(gli::FORMAT_UNDEFINED),
+    m_Width(0),
+    m_Height(0)
+{
+}
+
+ResizableRenderTarget::~ResizableRenderTarget() noexcept
+{
+    destroy();
+}
+
+void ResizableRenderTarget::create(const GraphicsDevicePtr& device, GraphicsFormat format) noexcept
+{
+    assert(device);
+    destroy();
+    m_Device = device;
+    m_Format = format;
+}
+
+void ResizableRenderTarget::destroy() noexcept
+{
+    auto device = m_Device.lock();
+    if (device && m_Texture)
+        device->downcast_pointer<OGLDevice>()->releaseTexture(m_Texture);
+    m_Texture = nullptr;
+    m_Width = m_Height = 0;
+}
+
+void ResizableRenderTarget::resize(int32_t width, int32_t height) noexcept
+{
+    m_Width = width;
+    m_Height = height;
+    m_LastResize = std::chrono::steady_clock::now();
+    if (!m_Texture)
+    {
+        allocate(width, height);
+        return;
+    }
+
+    // A smaller size keeps the texture until it settles, a larger one can't wait
+    const auto& desc = m_Texture->getGraphicsTextureDesc();
+    if (width > desc.getWidth() || height > desc.getHeight())
+        allocate(std::max(desc.getWidth(), GrowSize(width)), std::max(desc.getHeight(), GrowSize(height)));
+}
+
+bool ResizableRenderTarget::update() noexcept
+{
+    if (!m_Texture || m_Width <= 0 || m_Height <= 0)
+        return false;
+    if (!isSettled() && std::chrono::steady_clock::now() - m_LastResize >= kSettleTime)
+        return allocate(m_Width, m_Height);
+    return false;
+}
+
+glm::vec2 ResizableRenderTarget::getScale() const noexcept
+{
+    if (!m_Texture)
+        return glm::vec2(1.f);
+    const auto& desc = m_Texture->getGraphicsTextureDesc();
+    return glm::vec2(m_Width, m_Height) / glm::vec2(desc.getWidth(), desc.getHeight());
+}
+
+bool ResizableRenderTarget::isSettled() const noexcept
+{
+    if (!m_Texture)
+        return false;
+    const auto& desc = m_Texture->getGraphicsTextureDesc();
+    return desc.getWidth() == m_Width && desc.getHeight() == m_Height;
+}
+
+bool ResizableRenderTarget::allocate(int32_t width, int32_t height) noexcept
+{
+    auto device = m_Device.lock();
+    assert(device);
+    if (!device || width <= 0 || height <= 0)
+        return false;
+
+    auto ogl = device->downcast_pointer<OGLDevice>();
+    if (m_Texture)
+        ogl->releaseTexture(m_Texture);
+
+    GraphicsTextureDesc desc;
+    desc.setWidth(width);
+    desc.setHeight(height);
+    desc.setFormat(m_Format);
+    m_Texture = ogl->acquireTexture(desc);
+    if (!m_Texture)
+    {
+        printf("ResizableRenderTarget : can't allocate %dx%d.\n", width, height);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <GraphicsTypes.h>
+#include <chrono>
+#include <cstdint>
+
+// Window sized render target backed by the device texture pool.
+// While the window is being resized the texture only grows, with headroom, and the
+// frame renders into its lower left corner; the exact size is allocated once the size
+// stopped changing for kSettleTime
+class ResizableRenderTarget
+{
+public:
+
+    ResizableRenderTarget() noexcept;
+    ~ResizableRenderTarget() noexcept;
+
+    void create(const GraphicsDevicePtr& device, GraphicsFormat format) noexcept;
+    void destroy() noexcept;
+
+    // From the size callback, the first size is allocated as is and growing reallocates at once
+    void resize(int32_t width, int32_t height) noexcept;
+    // Once per frame, true if the settled size was allocated and the content lost
+    bool update() noexcept;
+
+    const GraphicsTexturePtr& getTexture() const noexcept { return m_Texture; }
+    // The area in use, the texture may be larger
+    int32_t getWidth() const noexcept { return m_Width; }
+    int32_t getHeight() const noexcept { return m_Height; }
+    // Texture coordinates of the corner of the area in use
+    glm::vec2 getScale() const noexcept;
+    bool isSettled() const noexcept;
+
+private:
+
+    ResizableRenderTarget(const ResizableRenderTarget&) = delete;
+    ResizableRenderTarget& operator=(const ResizableRenderTarget&) = delete;
+
+    static const std::chrono::milliseconds kSettleTime;
+
+    bool allocate(int32_t width, int32_t height) noexcept;
+
+    GraphicsDeviceWeakPtr m_Device;
+    GraphicsFormat m_Format;
+    GraphicsTexturePtr m_Texture;
+    int32_t m_Width;
+    int32_t m_Height;
+    std::chrono::steady_clock::time_point m_LastResize;
+};
@@ -0,0 +1,147 @@
+#include <GLType/ShaderBlob.h>
+#include <cstring>
+#include <cstdio>
+
+namespace
+{
+    const char kMagic[4] = { 'S', 'H', 'D', 'B' };
+    const uint32_t kVersion = 1;
+
+    struct Writer
+    {
+        util::FileContainer& data;
+
+        void bytes(const void* src, size_t size)
+        {
+            const char* p = static_cast<const char*>(src);
+            data.insert(data.end(), p, p + size);
+        }
+
+        template <typename T>
+        void value(const T& v) { bytes(&v, sizeof(v)); }
+
+        void string(const std::string& str)
+        {
+            value(uint32_t(str.size()));
+            bytes(str.data(), str.size());
+        }
+    };
+
+    struct Reader
+    {
+        const char* data;
+        size_t size;
+        size_t offset;
+
+        bool bytes(void* dst, size_t count)
+        {
+            if (size - offset < count)
+                return false;
+            std::memcpy(dst, data + offset, count);
+            offset += count;
+            return true;
+        }
+
+        template <typename T>
+        bool value(T& v) { return bytes(&v, sizeof(v)); }
+
+        bool string(std::string& str)
+        {
+            uint32_t length = 0;
+            if (!value(length) || size - offset < length)
+                return false;
+            str.assign(data + offset, length);
+            offset += length;
+            return true;
+        }
+    };
+}
+
+bool ShaderBlob::Entry::isCurrent() const
+{
+    for (const auto& dependency : dependencies)
+    {
+        if (util::GetFileStamp(dependency.path) != dependency.stamp)
+            return false;
+    }
+    return true;
+}
+
+void ShaderBlob::add(const std::string& tag, const std::string& source, const std::vector<std::string>& dependencies)
+{
+    Entry& entry = m_Entries[tag];
+    entry.source = source;
+    entry.dependencies.clear();
+    for (const auto& path : dependencies)
+        entry.dependencies.push_back(Dependency{ path, util::GetFileStamp(path) });
+}
+
+const ShaderBlob::Entry* ShaderBlob::find(const std::string& tag) const
+{
+    auto it = m_Entries.find(tag);
+    return it != m_Entries.end() ? &it->second : nullptr;
+}
+
+bool ShaderBlob::read(const std::string& filename)
+{
+    m_Entries.clear();
+
+    util::BytesArray data = util::ReadFileSync(filename, std::ios::binary);
+    if (data == util::NullFile)
+        return false;
+
+    Reader reader{ data->data(), data->size(), 0 };
+    char magic[4];
+    uint32_t version = 0, count = 0;
+    bool bValid = reader.bytes(magic, sizeof(magic))
+        && std::memcmp(magic, kMagic, sizeof(kMagic)) == 0
+        && reader.value(version) && version == kVersion
+        && reader.value(count);
+
+    for (uint32_t i = 0; bValid && i < count; i++)
+    {
+        std::string tag;
+        Entry entry;
+        uint32_t dependencyCount = 0;
+        bValid = reader.string(tag) && reader.string(entry.source) && reader.value(dependencyCount);
+        for (uint32_t k = 0; bValid && k < dependencyCount; k++)
+        {
+            Dependency dependency;
+            bValid = reader.string(dependency.path)
+                && reader.value(dependency.stamp.mtime)
+                && reader.value(dependency.stamp.size);
+            entry.dependencies.push_back(dependency);
+        }
+        if (bValid)
+            m_Entries[tag] = std::move(entry);
+    }
+
+    if (!bValid)
+    {
+        printf("ShaderBlob : \"%s\" is not a valid blob.\n", filename.c_str());
+        m_Entries.clear();
+    }
+    return bValid;
+}
+
+bool ShaderBlob::write(const std::string& filename) const
+{
+    auto data = std::make_shared<util::FileContainer>();
+    Writer writer{ *data };
+    writer.bytes(kMagic, sizeof(kMagic));
+    writer.value(kVersion);
+    writer.value(uint32_t(m_Entries.size()));
+    for (const auto& it : m_Entries)
+    {
+        writer.string(it.first);
+        writer.string(it.second.source);
+        writer.value(uint32_t(it.second.dependencies.size()));
+        for (const auto& dependency : it.second.dependencies)
+        {
+            writer.string(dependency.path);
+            writer.value(dependency.stamp.mtime);
+            writer.value(dependency.stamp.size);
+        }
+    }
+    return util::WriteFileSync(filename, data);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <tools/FileUtility.h>
+#include <unordered_map>
+#include <string>
+#include <vector>
+
+// Shader stages flattened at build time by tools/ShaderFlatten: the glsw section or
+// file is resolved and its includes expanded, so loading a stage is a lookup.
+// Each entry keeps the stamps of the files it came from; one edited since the build
+// no longer matches and the stage is preprocessed from the sources as usual
+class ShaderBlob
+{
+public:
+
+    struct Dependency
+    {
+        std::string path;
+        util::FileStamp stamp;
+    };
+
+    struct Entry
+    {
+        std::string source;     // manualInclude output without defines
+        std::vector<Dependency> dependencies;
+
+        bool isCurrent() const;
+    };
+
+    void add(const std::string& tag, const std::string& source, const std::vector<std::string>& dependencies);
+    const Entry* find(const std::string& tag) const;
+
+    bool read(const std::string& filename);
+    bool write(const std::string& filename) const;
+
+    size_t size() const { return m_Entries.size(); }
+    bool empty() const { return m_Entries.empty(); }
+
+private:
+
+    std::unordered_map<std::string, Entry> m_Entries;   // by tag
+};
@@ -0,0 +1,117 @@
+#include <GLType/UniformRingBuffer.h>
+#include <GLType/GraphicsDevice.h>
+#include <GLType/GraphicsData.h>
+#include <Math/Common.h>
+#include <cstring>
+#include <cassert>
+#include <cstdio>
+
+UniformRingBuffer::UniformRingBuffer() noexcept :
+    m_Mapped(nullptr),
+    m_Size(0),
+    m_Stride(0),
+    m_SlotCount(0),
+    m_Slot(0)
+{
+    for (auto& fence : m_Fences)
+        fence = nullptr;
+}
+
+UniformRingBuffer::~UniformRingBuffer() noexcept
+{
+    destroy();
+}
+
+bool UniformRingBuffer::create(const GraphicsDevicePtr& device, uint32_t size) noexcept
+{
+    assert(device);
+    assert(size > 0);
+    destroy();
+
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+
+    const bool bPersistent = device->getGraphicsDeviceDesc().getDeviceType() == GraphicsDeviceType::GraphicsDeviceTypeOpenGLCore;
+    const GraphicsUsageFlags mapFlags = GraphicsUsageFlagWriteBit | GraphicsUsageFlagPersistentBit | GraphicsUsageFlagCoherentBit;
+
+    m_Size = size;
+    m_Stride = uint32_t(Math::AlignUp(size, size_t(alignment)));
+    m_SlotCount = bPersistent ? kSlotCount : 1;
+    m_Slot = m_SlotCount - 1;
+
+    GraphicsDataDesc desc;
+    desc.setType(GraphicsDataType::UniformBuffer);
+    desc.setUsage(bPersistent ? mapFlags : GraphicsUsageFlags(GraphicsUsageFlagWriteBit));
+    desc.setStream(nullptr);
+    desc.setStreamSize(m_Stride * m_SlotCount);
+    m_Data = device->createGraphicsData(desc);
+    if (!m_Data)
+    {
+        printf("UniformRingBuffer : can't create the buffer.\n");
+        return false;
+    }
+
+    if (bPersistent)
+    {
+        void* mapped = nullptr;
+        if (!m_Data->map(0, m_Stride * m_SlotCount, &mapped, mapFlags))
+        {
+            printf("UniformRingBuffer : can't map the buffer.\n");
+            m_Data = nullptr;
+            return false;
+        }
+        m_Mapped = static_cast<uint8_t*>(mapped);
+    }
+    return true;
+}
+
+void UniformRingBuffer::destroy() noexcept
+{
+    for (auto& fence : m_Fences)
+    {
+        if (fence) glDeleteSync(fence);
+        fence = nullptr;
+    }
+    if (m_Data && m_Mapped)
+        m_Data->unmap();
+    m_Mapped = nullptr;
+    m_Data = nullptr;
+}
+
+bool UniformRingBuffer::update(const void* data, uint32_t size) noexcept
+{
+    assert(m_Data);
+    assert(size <= m_Size);
+    if (!m_Data || size > m_Size)
+        return false;
+
+    m_Slot = (m_Slot + 1) % m_SlotCount;
+    if (!m_Mapped)
+    {
+        m_Data->update(0, size, const_cast<void*>(data));
+        return true;
+    }
+
+    // Only blocks when the GPU is kSlotCount frames behind
+    GLsync& fence = m_Fences[m_Slot];
+    if (fence)
+    {
+        GLenum result = glClientWaitSync(fence, 0, 0);
+        while (result == GL_TIMEOUT_EXPIRED)
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+    std::memcpy(m_Mapped + getOffset(), data, size);
+    return true;
+}
+
+void UniformRingBuffer::fence() noexcept
+{
+    if (!m_Mapped)
+        return;
+
+    GLsync& fence = m_Fences[m_Slot];
+    if (fence) glDeleteSync(fence);
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <GraphicsTypes.h>
+#include <cstdint>
+
+// Uniform data rewritten by the CPU every frame.
+// On the core device the buffer is persistently mapped and split into kSlotCount slots;
+// a fence per slot keeps the CPU from overwriting a slot the GPU is still reading.
+// The GL 4.1 device has no buffer storage and falls back to a single updated slot
+class UniformRingBuffer
+{
+public:
+
+    static const uint32_t kSlotCount = 3;
+
+    UniformRingBuffer() noexcept;
+    ~UniformRingBuffer() noexcept;
+
+    bool create(const GraphicsDevicePtr& device, uint32_t size) noexcept;
+    void destroy() noexcept;
+
+    // Copy 'data' to the next free slot, the slot stays current until fence()
+    bool update(const void* data, uint32_t size) noexcept;
+    // Call after the last draw reading the current slot
+    void fence() noexcept;
+
+    const GraphicsDataPtr& getData() const noexcept { return m_Data; }
+    GLintptr getOffset() const noexcept { return GLintptr(m_Slot) * m_Stride; }
+    GLsizeiptr getSize() const noexcept { return m_Size; }
+
+private:
+
+    UniformRingBuffer(const UniformRingBuffer&) = delete;
+    UniformRingBuffer& operator=(const UniformRingBuffer&) = delete;
+
+    GraphicsDataPtr m_Data;
+    uint8_t* m_Mapped;
+    uint32_t m_Size;
+    uint32_t m_Stride;
+    uint32_t m_SlotCount;
+    uint32_t m_Slot;
+    GLsync m_Fences[kSlotCount];
+};
@@ -1,18 +1,165 @@
 /**
- * 
- *    \file VertexBuffer.cpp  
- * 
+ *
+ *    \file VertexBuffer.cpp
+ *
  */
- 
+
 
 #include <GL/glew.h>
 #include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
 #include <vector>
 
 #include "VertexBuffer.h"
 
 
-    
+namespace
+{
+  // [Forsyth06] Linear-speed vertex cache optimisation
+  // Vertices score by their position in a simulated LRU cache and by the triangles
+  // left using them, the best scored triangle around the cache is emitted next
+  const int kCacheSize = 32;
+
+  float ScoreVertex(int cachePosition, int valence)
+  {
+    if (valence == 0)
+      return -1.f;
+
+    float score = 0.f;
+    if (cachePosition >= 0)
+    {
+      // The last triangle's vertices score the same, whatever order they were added in
+      if (cachePosition < 3)
+        score = 0.75f;
+      else
+        score = std::pow(1.f - float(cachePosition - 3) / float(kCacheSize - 3), 1.5f);
+    }
+    // Vertices with few triangles left are finished first, they don't strand them
+    return score + 2.f / std::sqrt(float(valence));
+  }
+
+  std::vector<uint16_t> OptimizeVertexCache(const std::vector<uint16_t>& indices, size_t vertexCount)
+  {
+    const size_t triangleCount = indices.size() / 3;
+
+    struct Vertex
+    {
+      int cachePosition = -1;
+      int valence = 0;            // triangles not emitted yet
+      float score = 0.f;
+      std::vector<uint32_t> triangles;
+    };
+    std::vector<Vertex> vertices(vertexCount);
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+      for (size_t k = 0; k < 3; ++k)
+      {
+        Vertex& v = vertices[indices[3*t + k]];
+        v.triangles.push_back(uint32_t(t));
+        v.valence++;
+      }
+    }
+    for (auto& v : vertices)
+      v.score = ScoreVertex(v.cachePosition, v.valence);
+
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<bool> bEmitted(triangleCount, false);
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+      triangleScores[t] = vertices[indices[3*t]].score + vertices[indices[3*t + 1]].score + vertices[indices[3*t + 2]].score;
+    }
+
+    std::vector<uint16_t> result;
+    result.reserve(indices.size());
+    std::vector<uint16_t> cache;
+    cache.reserve(kCacheSize + 3);
+    size_t scan = 0;
+    int best = -1;
+    while (result.size() < indices.size())
+    {
+      // Nothing around the cache, the best of the whole mesh starts over
+      if (best < 0)
+      {
+        float bestScore = -1.f;
+        for (size_t t = scan; t < triangleCount; ++t)
+        {
+          if (!bEmitted[t] && triangleScores[t] > bestScore)
+          {
+            bestScore = triangleScores[t];
+            best = int(t);
+          }
+        }
+        while (scan < triangleCount && bEmitted[scan])
+          ++scan;
+      }
+      assert(best >= 0);
+
+      bEmitted[best] = true;
+      for (size_t k = 0; k < 3; ++k)
+      {
+        const uint16_t index = indices[3*best + k];
+        result.push_back(index);
+
+        Vertex& v = vertices[index];
+        v.valence--;
+        v.triangles.erase(std::find(v.triangles.begin(), v.triangles.end(), uint32_t(best)));
+
+        auto it = std::find(cache.begin(), cache.end(), index);
+        if (it != cache.end())
+          cache.erase(it);
+        cache.insert(cache.begin(), index);
+      }
+
+      // Evicted vertices lose their cache score, the others move down
+      for (size_t i = 0; i < cache.size(); ++i)
+      {
+        Vertex& v = vertices[cache[i]];
+        v.cachePosition = i < size_t(kCacheSize) ? int(i) : -1;
+        v.score = ScoreVertex(v.cachePosition, v.valence);
+      }
+
+      best = -1;
+      float bestScore = -1.f;
+      for (const uint16_t index : cache)
+      {
+        for (const uint32_t t : vertices[index].triangles)
+        {
+          const float score = vertices[indices[3*t]].score + vertices[indices[3*t + 1]].score + vertices[indices[3*t + 2]].score;
+          triangleScores[t] = score;
+          if (score > bestScore)
+          {
+            bestScore = score;
+            best = int(t);
+          }
+        }
+      }
+      if (cache.size() > size_t(kCacheSize))
+        cache.resize(kCacheSize);
+    }
+    return result;
+  }
+
+  template<typename T>
+  void Remap(std::vector<T>& attribute, const std::vector<uint32_t>& remap, size_t count)
+  {
+    if (attribute.empty())
+      return;
+
+    std::vector<T> remapped(count);
+    for (size_t i = 0; i < attribute.size(); ++i)
+    {
+      if (remap[i] != ~0u)
+        remapped[remap[i]] = attribute[i];
+    }
+    attribute.swap(remapped);
+  }
+}
+
+
 void VertexBuffer::initialize()
 {
   if (!m_vao) glGenVertexArrays( 1, &m_vao);
@@ -23,10 +170,13 @@ void VertexBuffer::destroy()
 {
   if (m_vao) glDeleteVertexArrays( 1, &m_vao);
   if (m_vbo) glDeleteBuffers( 1, &m_vbo);
-  
+  if (m_ibo) glDeleteBuffers( 1, &m_ibo);
+
   cleanData();
   m_vao = 0;
   m_vbo = 0;
+  m_ibo = 0;
+  m_indexCount = 0;
 }
 
 void VertexBuffer::cleanData()
@@ -34,46 +184,90 @@ void VertexBuffer::cleanData()
   m_position.clear();
   m_normal.clear();
   m_texcoord.clear();
+  m_indices.clear();
+}
+
+void VertexBuffer::optimize()
+{
+  assert(m_indices.size() % 3 == 0);
+  if (m_indices.empty())
+    return;
+
+  m_indices = OptimizeVertexCache(m_indices, m_position.size());
+
+  // Fetches follow the index order, unused vertices are dropped
+  std::vector<uint32_t> remap(m_position.size(), ~0u);
+  uint32_t count = 0;
+  for (auto& index : m_indices)
+  {
+    if (remap[index] == ~0u)
+      remap[index] = count++;
+    index = uint16_t(remap[index]);
+  }
+  Remap(m_position, remap, count);
+  Remap(m_normal, remap, count);
+  Remap(m_texcoord, remap, count);
 }
 
 void VertexBuffer::complete(GLenum usage)
 {
   assert( m_vao && m_vbo );
-  
-  
-  m_positionSize = m_normalSize = m_texcoordSize = 0;  
-  if (!m_position.empty()) m_positionSize = m_position.size() * sizeof(glm::vec3);
-  if (!m_normal.empty()) m_normalSize = m_normal.size() * sizeof(glm::vec3);
-  if (!m_texcoord.empty()) m_texcoordSize  = m_texcoord.size() * sizeof(glm::vec2);  
-  
-  GLsizeiptr bufferSize = m_positionSize + m_normalSize + m_texcoordSize;
-    
-  
-  bind();
-  {    
-    glBufferData( GL_ARRAY_BUFFER, bufferSize, 0, usage);
-      
-    m_offset = 0;
-    
-    if (!m_position.empty())
-    {
-      glBufferSubData( GL_ARRAY_BUFFER, m_offset, m_positionSize, &m_position[0]);
-      glVertexAttribPointer( VATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, 0, (void*)(m_offset));
-      m_offset += m_positionSize;
-    }
-    
-    if (!m_normal.empty())
+  assert( !m_position.empty() );
+  assert( m_normal.empty() || m_normal.size() == m_position.size() );
+  assert( m_texcoord.empty() || m_texcoord.size() == m_position.size() );
+  assert( m_indices.empty() || m_position.size() <= 65536u );
+
+
+  const size_t count = m_position.size();
+  m_stride = sizeof(glm::vec3);
+  m_normalOffset = m_texcoordOffset = 0;
+  if (!m_normal.empty())
+  {
+    m_normalOffset = m_stride;
+    m_stride += sizeof(uint32_t);
+  }
+  if (!m_texcoord.empty())
+  {
+    m_texcoordOffset = m_stride;
+    m_stride += sizeof(glm::vec2);
+  }
+
+  std::vector<uint8_t> vertices(count * m_stride);
+  for (size_t i = 0; i < count; ++i)
+  {
+    uint8_t* vertex = &vertices[i * m_stride];
+    std::memcpy(vertex, &m_position[i], sizeof(glm::vec3));
+    if (m_normalOffset != 0)
     {
-      glBufferSubData( GL_ARRAY_BUFFER, m_offset, m_normalSize, &m_normal[0]);
-      glVertexAttribPointer( VATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, 0, (void*)(m_offset));
-      m_offset += m_normalSize;
+      const uint32_t normal = glm::packSnorm3x10_1x2(glm::vec4(m_normal[i], 0.f));
+      std::memcpy(vertex + m_normalOffset, &normal, sizeof(normal));
     }
-    
-    if (!m_texcoord.empty())
+    if (m_texcoordOffset != 0)
+      std::memcpy(vertex + m_texcoordOffset, &m_texcoord[i], sizeof(glm::vec2));
+  }
+
+  bind();
+  {
+    glBufferData( GL_ARRAY_BUFFER, vertices.size(), vertices.data(), usage);
+
+    glVertexAttribPointer( VATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, m_stride, (void*)0);
+    if (m_normalOffset != 0)
+      glVertexAttribPointer( VATTRIB_NORMAL, 4, GL_INT_2_10_10_10_REV, GL_TRUE, m_stride, (void*)GLintptr(m_normalOffset));
+    if (m_texcoordOffset != 0)
+      glVertexAttribPointer( VATTRIB_TEXCOORD, 2, GL_FLOAT, GL_FALSE, m_stride, (void*)GLintptr(m_texcoordOffset));
+
+    // Attrib arrays are VAO state, drawing only has to bind the VAO
+    glEnableVertexAttribArray( VATTRIB_POSITION );
+    if (m_normalOffset != 0)    glEnableVertexAttribArray( VATTRIB_NORMAL );
+    if (m_texcoordOffset != 0)  glEnableVertexAttribArray( VATTRIB_TEXCOORD );
+
+    // So is the element buffer binding
+    m_indexCount = GLsizei(m_indices.size());
+    if (!m_indices.empty())
     {
-      glBufferSubData( GL_ARRAY_BUFFER, m_offset, m_texcoordSize, &m_texcoord[0]);
-      glVertexAttribPointer( VATTRIB_TEXCOORD, 2, GL_FLOAT, GL_FALSE, 0, (void*)(m_offset));  
-      m_offset += m_texcoordSize;
+      if (!m_ibo) glGenBuffers( 1, &m_ibo);
+      glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+      glBufferData( GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(uint16_t), m_indices.data(), usage);
     }
   }
   unbind();
@@ -93,19 +287,19 @@ void VertexBuffer::unbind()
 }
 
 void VertexBuffer::enable() const
-{  
+{
   bind();
-  
-  if (m_positionSize != 0)  glEnableVertexAttribArray( VATTRIB_POSITION );
-  if (m_normalSize != 0)    glEnableVertexAttribArray( VATTRIB_NORMAL );
-  if (m_texcoordSize != 0)  glEnableVertexAttribArray( VATTRIB_TEXCOORD );
+
+  glEnableVertexAttribArray( VATTRIB_POSITION );
+  if (m_normalOffset != 0)    glEnableVertexAttribArray( VATTRIB_NORMAL );
+  if (m_texcoordOffset != 0)  glEnableVertexAttribArray( VATTRIB_TEXCOORD );
 }
 
 void VertexBuffer::disable()
-{    
+{
  	glDisableVertexAttribArray( VATTRIB_POSITION );
   glDisableVertexAttribArray( VATTRIB_NORMAL );
   glDisableVertexAttribArray( VATTRIB_TEXCOORD );
-  
+
   unbind();
 }
@@ -2,9 +2,7 @@
  * 
  *    \file VertexBuffer.hpp  
  * 
- *    \todo # allow index buffer
- *          # allow interleaving
- *          # add tangent ?
+ *    \todo # add tangent ?
  */
  
 
@@ -16,6 +14,7 @@
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <vector>
+#include <cstdint>
 
 
 enum VertexAttribLocation
@@ -25,28 +24,33 @@ enum VertexAttribLocation
   VATTRIB_TEXCOORD
 };
 
+/**
+ *  Attributes are uploaded interleaved, one vertex after the other, with the normal
+ *  packed in 2_10_10_10. With indices the vertices are drawn through a 16-bit
+ *  element buffer bound to the VAO.
+ */
 class VertexBuffer
 {
   protected:
     GLuint m_vao;
     GLuint m_vbo;    
+    GLuint m_ibo;
 
     std::vector<glm::vec3> m_position;
     std::vector<glm::vec3> m_normal;
     std::vector<glm::vec2> m_texcoord;
+    std::vector<uint16_t> m_indices;
         
-    GLsizeiptr m_positionSize;
-    GLsizeiptr m_normalSize;
-    GLsizeiptr m_texcoordSize;
-    
-    GLintptr m_offset;
+    GLsizei m_stride;
+    GLsizei m_normalOffset;     // 0 without normals, the position comes first
+    GLsizei m_texcoordOffset;   // 0 without texcoords
+    GLsizei m_indexCount;
     
 
   public:
     VertexBuffer() 
-      : m_vao(0u), m_vbo(0u),
-        m_positionSize(0), m_normalSize(0), m_texcoordSize(0),
-        m_offset(0)
+      : m_vao(0u), m_vbo(0u), m_ibo(0u),
+        m_stride(0), m_normalOffset(0), m_texcoordOffset(0), m_indexCount(0)
     {}
                      
     virtual ~VertexBuffer() { destroy(); }
@@ -57,6 +61,10 @@ class VertexBuffer
     /** Destroy the client side memory (CPU) */
     void cleanData();
 
+    /** Reorder the triangle list indices for the post-transform vertex cache, then
+        the vertices in the order they are first used */
+    void optimize();
+
     /** Set the VAO parameters & send data to the GPU */
     void complete(GLenum usage);
     
@@ -70,13 +78,18 @@ class VertexBuffer
     static void disable();    
     
     
+    GLuint getVAO() const {return m_vao;}
     GLuint getVBO() const {return m_vbo;}
     
     std::vector<glm::vec3>& getPosition() {return m_position;}
     std::vector<glm::vec3>& getNormal() {return m_normal;}
     std::vector<glm::vec2>& getTexcoord() {return m_texcoord;}
+    /** Optional, at most 65536 vertices */
+    std::vector<uint16_t>& getIndices() {return m_indices;}
     
-    GLintptr getOffset() const { return m_offset; }
+    bool isIndexed() const { return m_indexCount > 0; }
+    GLsizei getIndexCount() const { return m_indexCount; }
+    GLsizei getStride() const { return m_stride; }
 };
 
 
@@ -89,10 +102,14 @@ class VertexBuffer
   std::vector<glm::vec3> &pos = vertexBuffer.getPosition();
   std::vector<glm::vec3> &nor = vertexBuffer.getNormal();
   std::vector<glm::vec2> &tex = vertexBuffer.getTexcoord();
+  std::vector<uint16_t> &ind = vertexBuffer.getIndices();
 
-  // Update pos, nor, tex
+  // Update pos, nor, tex and optionally the triangle indices
   // ..
 
+  // Improve the vertex cache hits of an indexed triangle list [optional]
+  m_vertexBuffer.optimize();
+
   // Generate buffer's id
   m_vertexBuffer.initialize();  
 
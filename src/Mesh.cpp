@@ -14,85 +14,99 @@
 #include <glm/glm.hpp>
 
 #include <tools/gltools.hpp>
+#include <GLType/OGLDevice.h>
+#include <GLType/GraphicsCommandList.h>
 #include "Mesh.h"
 
 
 void Mesh::destroy()
 {
+    auto device = m_Device.lock();
+    if (device)
+        device->downcast_pointer<OGLDevice>()->invalidateVertexArray(m_vertexBuffer.getVAO());
     m_vertexBuffer.destroy();
 }
 
+void Mesh::record(GraphicsCommandList& commands) const
+{
+    assert(m_bInitialized);
+    if (m_vertexBuffer.isIndexed())
+        commands.drawIndexed(m_vertexBuffer.getVAO(), getPrimitiveMode(), GL_UNSIGNED_SHORT, 0, m_count);
+    else
+        commands.draw(m_vertexBuffer.getVAO(), getPrimitiveMode(), 0, m_count);
+}
+
+void Mesh::drawPrimitives() const
+{
+    const GLenum mode = getPrimitiveMode();
+    auto device = m_Device.lock();
+    if (device)
+        device->downcast_pointer<OGLDevice>()->setVertexArray(m_vertexBuffer.getVAO());
+    else
+        m_vertexBuffer.enable();
+
+    if (m_vertexBuffer.isIndexed())
+        glDrawElements(mode, m_count, GL_UNSIGNED_SHORT, nullptr);
+    else
+        glDrawArrays(mode, 0, m_count);
+
+    if (!device)
+        m_vertexBuffer.disable();
+}
+
 /** PLANE MESH ----------------------------------------- */
 
 void PlaneMesh::create()
 {
-    /**
-     *  todo : use indexed tristrip instead
-     */
-
     assert(!m_bInitialized);
     m_bInitialized = true;
 
     const float SIZE = m_size; //
     const int RES = static_cast<int>(m_res); //  
+    const int STRIDE = RES + 1;
+    assert(STRIDE * STRIDE <= 65536);
 
     m_count = 3 * 2 * (RES*RES);
 
     std::vector<glm::vec3> &positions = m_vertexBuffer.getPosition();
     std::vector<glm::vec3> &normals = m_vertexBuffer.getNormal();
     std::vector<glm::vec2> &texCoords = m_vertexBuffer.getTexcoord();
+    std::vector<uint16_t> &indices = m_vertexBuffer.getIndices();
 
-    positions.resize(m_count);
-    normals.resize(m_count, glm::vec3(0.0f, 1.0f, 0.0f));
-    texCoords.resize(m_count);
-
-    glm::vec3 *pPos = &(positions[0]);
-    glm::vec2 *pUV = &(texCoords[0]);
+    positions.resize(STRIDE*STRIDE);
+    normals.resize(STRIDE*STRIDE, glm::vec3(0.0f, 1.0f, 0.0f));
+    texCoords.resize(STRIDE*STRIDE);
+    indices.reserve(m_count);
 
 	float UVScale = m_UVScale;
 
     const float Delta = 1.0f / float(RES);
 
+    for(int j = 0; j < STRIDE; ++j)
+    {
+        for(int i = 0; i < STRIDE; ++i)
+        {
+            glm::vec2 uv = Delta * glm::vec2(i, j);
+            positions[j*STRIDE + i] = SIZE * glm::vec3(uv.x - 0.5f, 0.0f, uv.y - 0.5f);
+            uv *= UVScale;
+            texCoords[j*STRIDE + i] = glm::vec2(uv.x, 1 - uv.y);
+        }
+    }
+
     for(int j = 0; j < RES; ++j)
     {
         for(int i = 0; i < RES; ++i)
         {
-            glm::vec4 vInd = Delta * glm::vec4(i, j, i + 1, j + 1);
-
-            *pUV = glm::vec2(vInd.x, vInd.y);
-            *pPos = SIZE * glm::vec3(pUV->x - 0.5f, 0.0f, pUV->y - 0.5f);
-			*pUV *= UVScale;
-            ++pPos; ++pUV;
-
-            *pUV = glm::vec2(vInd.x, vInd.w);
-            *pPos = SIZE * glm::vec3(pUV->x - 0.5f, 0.0f, pUV->y - 0.5f);
-			*pUV *= UVScale;
-            ++pPos; ++pUV;
-
-            *pUV = glm::vec2(vInd.z, vInd.y);
-            *pPos = SIZE * glm::vec3(pUV->x - 0.5f, 0.0f, pUV->y - 0.5f);
-			*pUV *= UVScale;
-            ++pPos; ++pUV;
+            const uint16_t a = uint16_t(j*STRIDE + i);
+            const uint16_t b = uint16_t(a + STRIDE);
+            const uint16_t c = uint16_t(a + 1);
+            const uint16_t d = uint16_t(b + 1);
 
-
-            *pUV = pUV[-1];
-            *pPos = pPos[-1];
-            ++pPos; ++pUV;
-
-            *pUV = pUV[-3];
-            *pPos = pPos[-3];
-            ++pPos; ++pUV;
-
-            *pUV = glm::vec2(vInd.z, vInd.w);
-            *pPos = SIZE * glm::vec3(pUV->x - 0.5f, 0.0f, pUV->y - 0.5f);
-			*pUV *= UVScale;
-            ++pPos; ++pUV;
+            indices.insert(indices.end(), { a, b, c, c, b, d });
         }
     }
 
-    for (auto& coord : texCoords)
-        coord.g = 1 - coord.g;
-
+    m_vertexBuffer.optimize();
     m_vertexBuffer.initialize();
     m_vertexBuffer.complete(GL_STATIC_DRAW);
     m_vertexBuffer.cleanData();
@@ -104,9 +118,7 @@ void PlaneMesh::draw() const
 {
     assert(m_bInitialized);
 
-    m_vertexBuffer.enable();
-    glDrawArrays(GL_TRIANGLES, 0, m_count);
-    m_vertexBuffer.disable();
+    drawPrimitives();
 
     CHECKGLERROR();
 }
@@ -122,86 +134,70 @@ void SphereMesh::create()
 
 
     const float RADIUS = m_radius; //
-
-    m_count = 2 * m_meshResolution*(m_meshResolution + 2);
+    const int RES = m_meshResolution;
+    // The seam and the poles repeat their position with each texture coordinate
+    const int STRIDE = RES + 1;
+    assert(STRIDE * STRIDE <= 65536);
 
     std::vector<glm::vec3> &positions = m_vertexBuffer.getPosition();
     std::vector<glm::vec3> &normals = m_vertexBuffer.getNormal();
     std::vector<glm::vec2> &texCoords = m_vertexBuffer.getTexcoord();
+    std::vector<uint16_t> &indices = m_vertexBuffer.getIndices();
 
-    positions.resize(m_count);
-    normals.resize(m_count);
-    texCoords.resize(m_count);
-
-    glm::vec3 *pPos = &(positions[0]);
-    glm::vec3 *pNor = &(normals[0]);
-    glm::vec2 *pUV = &(texCoords[0]);
+    positions.resize(STRIDE*STRIDE);
+    normals.resize(STRIDE*STRIDE);
+    texCoords.resize(STRIDE*STRIDE);
 
 
-    float theta2, phi;    // next theta angle, phi angle
+    float theta, phi;     // theta angle, phi angle
     float ct, st;         // cos(theta), sin(theta)
-    float ct2, st2;       // cos(next theta), sin(next theta)
     float cp, sp;         // cos(phi), sin(phi)
 
 
     const float TwoPI = 2.0f*(float)M_PI;
-    const float Delta = 1.0f / float(m_meshResolution);
-
-    ct2 = 0.0f; st2 = -1.0f;
+    const float Delta = 1.0f / float(RES);
 
-    /* Create the sphere from bottom to top (like a spiral) as a tristrip */
-    for(int j = 0; j < m_meshResolution; ++j)
+    /* Rings from bottom to top */
+    for(int j = 0; j < STRIDE; ++j)
     {
-        ct = ct2;
-        st = st2;
-
-        theta2 = ((j + 1) * Delta - 0.5f) * (float)M_PI;
-        ct2 = cos(theta2);
-        st2 = sin(theta2);
+        theta = (j * Delta - 0.5f) * (float)M_PI;
+        ct = cos(theta);
+        st = sin(theta);
 
-        pNor->x = ct;
-        pNor->y = st;
-        pNor->z = 0.0f;
-        *pPos = RADIUS * (*pNor);
-        pUV->x = 0.0f;
-        pUV->y = j * Delta;
-        ++pPos; ++pNor; ++pUV;
-
-        for(int i = 0; i < m_meshResolution + 1; ++i)
+        for(int i = 0; i < STRIDE; ++i)
         {
             phi = TwoPI * i * Delta;
             cp = cos(phi);
             sp = sin(phi);
 
-            pNor->x = ct2 * cp;
-            pNor->y = st2;
-            pNor->z = ct2 * sp;
-            *pPos = RADIUS * (*pNor);
-            pUV->x = i * Delta;
-            pUV->y = (j + 1) * Delta;
-            ++pPos; ++pNor; ++pUV;
-
-            pNor->x = ct * cp;
-            pNor->y = st;
-            pNor->z = ct * sp;
-            *pPos = RADIUS * (*pNor);
-            pUV->x = i * Delta;
-            pUV->y = j * Delta;
-            ++pPos; ++pNor; ++pUV;
+            glm::vec3 &normal = normals[j*STRIDE + i];
+            normal = glm::vec3(ct * cp, st, ct * sp);
+            positions[j*STRIDE + i] = RADIUS * normal;
+            texCoords[j*STRIDE + i] = glm::vec2(i * Delta, j * Delta);
         }
+    }
 
-        pNor->x = ct2;
-        pNor->y = st2;
-        pNor->z = 0.0f;
-        *pPos = RADIUS * (*pNor);
-        pUV->x = 1.0f;
-        pUV->y = 1.0f;
-        ++pPos; ++pNor; ++pUV;
+    /* Two triangles between each ring, in the winding of the former strips;
+       the one collapsed on a pole is left out */
+    for(int j = 0; j < RES; ++j)
+    {
+        for(int i = 0; i < RES; ++i)
+        {
+            const uint16_t bottom = uint16_t(j*STRIDE + i);
+            const uint16_t top = uint16_t(bottom + STRIDE);
+
+            if (j != RES - 1)
+                indices.insert(indices.end(), { top, bottom, uint16_t(top + 1) });
+            if (j != 0)
+                indices.insert(indices.end(), { uint16_t(top + 1), bottom, uint16_t(bottom + 1) });
+        }
     }
+    m_count = GLsizei(indices.size());
 
     //-------------------------
 
 
+    m_vertexBuffer.optimize();
     m_vertexBuffer.initialize();
     m_vertexBuffer.complete(GL_STATIC_DRAW);
     m_vertexBuffer.cleanData();
@@ -213,9 +209,7 @@ void SphereMesh::draw() const
 {
     assert(m_bInitialized);
 
-    m_vertexBuffer.enable();
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, m_count);
-    m_vertexBuffer.disable();
+    drawPrimitives();
 
     CHECKGLERROR();
 }
@@ -326,9 +320,7 @@ void ConeMesh::draw() const
 {
     assert(m_bInitialized);
 
-    m_vertexBuffer.enable();
-    glDrawArrays(GL_TRIANGLES, 0, m_count);
-    m_vertexBuffer.disable();
+    drawPrimitives();
 
     CHECKGLERROR();
 }
@@ -339,8 +331,6 @@ void ConeMesh::draw() const
 
 void CubeMesh::create()
 {
-    /// not optimized at all, better with indices
-
     assert(!m_bInitialized);
     m_bInitialized = true;
 
@@ -353,17 +343,18 @@ void CubeMesh::create()
     std::vector<glm::vec3> &positions = m_vertexBuffer.getPosition();
     std::vector<glm::vec3> &normals = m_vertexBuffer.getNormal();
     std::vector<glm::vec2> &coords = m_vertexBuffer.getTexcoord();
+    std::vector<uint16_t> &indices = m_vertexBuffer.getIndices();
 
-    positions.resize(m_count);
-    normals.resize(m_count);
-    coords.resize(m_count);
+    positions.resize(4u * 6u);
+    normals.resize(4u * 6u);
+    coords.resize(4u * 6u);
 
 #define PX  0u
-#define NX  6u
-#define PY  12u
-#define NY  18u
-#define PZ  24u
-#define NZ  30u
+#define NX  4u
+#define PY  8u
+#define NY  12u
+#define PZ  16u
+#define NZ  20u
 
     glm::vec3 default_normals[] =
     {
@@ -371,59 +362,63 @@ void CubeMesh::create()
     };
 
     /// POSITIVE-X
-    positions[PX + 0u] = positions[PX + 5u] = glm::vec3(1.0f, -1.0f, 1.0f);
+    positions[PX + 0u] = glm::vec3(1.0f, -1.0f, 1.0f);
     positions[PX + 1u] = glm::vec3(1.0f, -1.0f, -1.0f);
-    positions[PX + 2u] = positions[PX + 3u] = glm::vec3(1.0f, 1.0f, -1.0f);
-    positions[PX + 4u] = glm::vec3(1.0f, 1.0f, 1.0f);
-    normals[PX + 0u] = normals[PX + 1u] = normals[PX + 2u] =
-        normals[PX + 3u] = normals[PX + 4u] = normals[PX + 5u] = default_normals[0u];
+    positions[PX + 2u] = glm::vec3(1.0f, 1.0f, -1.0f);
+    positions[PX + 3u] = glm::vec3(1.0f, 1.0f, 1.0f);
+    normals[PX + 0u] = normals[PX + 1u] = normals[PX + 2u] = normals[PX + 3u] = default_normals[0u];
 
     /// NEGATIVE-X
-    positions[NX + 0u] = positions[NX + 5u] = glm::vec3(-1.0f, -1.0f, -1.0f);
+    positions[NX + 0u] = glm::vec3(-1.0f, -1.0f, -1.0f);
     positions[NX + 1u] = glm::vec3(-1.0f, -1.0f, 1.0f);
-    positions[NX + 2u] = positions[NX + 3u] = glm::vec3(-1.0f, 1.0f, 1.0f);
-    positions[NX + 4u] = glm::vec3(-1.0f, 1.0f, -1.0f);
-    normals[NX + 0u] = normals[NX + 1u] = normals[NX + 2u] =
-        normals[NX + 3u] = normals[NX + 4u] = normals[NX + 5u] = -default_normals[0u];
+    positions[NX + 2u] = glm::vec3(-1.0f, 1.0f, 1.0f);
+    positions[NX + 3u] = glm::vec3(-1.0f, 1.0f, -1.0f);
+    normals[NX + 0u] = normals[NX + 1u] = normals[NX + 2u] = normals[NX + 3u] = -default_normals[0u];
 
     /// POSITIVE-Y
-    positions[PY + 0u] = positions[PY + 5u] = glm::vec3(-1.0f, 1.0f, 1.0f);
+    positions[PY + 0u] = glm::vec3(-1.0f, 1.0f, 1.0f);
     positions[PY + 1u] = glm::vec3(1.0f, 1.0f, 1.0f);
-    positions[PY + 2u] = positions[PY + 3u] = glm::vec3(1.0f, 1.0f, -1.0f);
-    positions[PY + 4u] = glm::vec3(-1.0f, 1.0f, -1.0f);
-    normals[PY + 0u] = normals[PY + 1u] = normals[PY + 2u] =
-        normals[PY + 3u] = normals[PY + 4u] = normals[PY + 5u] = default_normals[1u];
+    positions[PY + 2u] = glm::vec3(1.0f, 1.0f, -1.0f);
+    positions[PY + 3u] = glm::vec3(-1.0f, 1.0f, -1.0f);
+    normals[PY + 0u] = normals[PY + 1u] = normals[PY + 2u] = normals[PY + 3u] = default_normals[1u];
 
     /// NEGATIVE-Y
-    positions[NY + 0u] = positions[NY + 5u] = glm::vec3(-1.0f, -1.0f, -1.0f);
+    positions[NY + 0u] = glm::vec3(-1.0f, -1.0f, -1.0f);
     positions[NY + 1u] = glm::vec3(1.0f, -1.0f, -1.0f);
-    positions[NY + 2u] = positions[NY + 3u] = glm::vec3(1.0f, -1.0f, 1.0f);
-    positions[NY + 4u] = glm::vec3(-1.0f, -1.0f, 1.0f);
-    normals[NY + 0u] = normals[NY + 1u] = normals[NY + 2u] =
-        normals[NY + 3u] = normals[NY + 4u] = normals[NY + 5u] = -default_normals[1u];
+    positions[NY + 2u] = glm::vec3(1.0f, -1.0f, 1.0f);
+    positions[NY + 3u] = glm::vec3(-1.0f, -1.0f, 1.0f);
+    normals[NY + 0u] = normals[NY + 1u] = normals[NY + 2u] = normals[NY + 3u] = -default_normals[1u];
 
     /// POSITIVE-Z
-    positions[PZ + 0u] = positions[PZ + 5u] = glm::vec3(-1.0f, -1.0f, 1.0f);
+    positions[PZ + 0u] = glm::vec3(-1.0f, -1.0f, 1.0f);
     positions[PZ + 1u] = glm::vec3(1.0f, -1.0f, 1.0f);
-    positions[PZ + 2u] = positions[PZ + 3u] = glm::vec3(1.0f, 1.0f, 1.0f);
-    positions[PZ + 4u] = glm::vec3(-1.0f, 1.0f, 1.0f);
-    normals[PZ + 0u] = normals[PZ + 1u] = normals[PZ + 2u] =
-        normals[PZ + 3u] = normals[PZ + 4u] = normals[PZ + 5u] = default_normals[2u];
+    positions[PZ + 2u] = glm::vec3(1.0f, 1.0f, 1.0f);
+    positions[PZ + 3u] = glm::vec3(-1.0f, 1.0f, 1.0f);
+    normals[PZ + 0u] = normals[PZ + 1u] = normals[PZ + 2u] = normals[PZ + 3u] = default_normals[2u];
 
     /// NEGATIVE-Z
-    positions[NZ + 0u] = positions[NZ + 5u] = glm::vec3(1.0f, -1.0f, -1.0f);
+    positions[NZ + 0u] = glm::vec3(1.0f, -1.0f, -1.0f);
     positions[NZ + 1u] = glm::vec3(-1.0f, -1.0f, -1.0f);
-    positions[NZ + 2u] = positions[NZ + 3u] = glm::vec3(-1.0f, 1.0f, -1.0f);
-    positions[NZ + 4u] = glm::vec3(1.0f, 1.0f, -1.0f);
-    normals[NZ + 0u] = normals[NZ + 1u] = normals[NZ + 2u] =
-        normals[NZ + 3u] = normals[NZ + 4u] = normals[NZ + 5u] = -default_normals[2u];
-
-    coords[PX + 0u] = coords[NX + 0u] = coords[PY + 0u] = coords[NY + 0u] = coords[PZ + 0u] = coords[NZ + 0u] = glm::vec2(1.0f, 0.f);
-    coords[PX + 1u] = coords[NX + 1u] = coords[PY + 1u] = coords[NY + 1u] = coords[PZ + 1u] = coords[NZ + 1u] = glm::vec2(0.0f, 0.f);
-    coords[PX + 2u] = coords[NX + 2u] = coords[PY + 2u] = coords[NY + 2u] = coords[PZ + 2u] = coords[NZ + 2u] = glm::vec2(0.0f, 1.f);
-    coords[PX + 3u] = coords[NX + 3u] = coords[PY + 3u] = coords[NY + 3u] = coords[PZ + 3u] = coords[NZ + 3u] = glm::vec2(0.0f, 1.f);
-    coords[PX + 4u] = coords[NX + 4u] = coords[PY + 4u] = coords[NY + 4u] = coords[PZ + 4u] = coords[NZ + 4u] = glm::vec2(1.0f, 1.f);
-    coords[PX + 5u] = coords[NX + 5u] = coords[PY + 5u] = coords[NY + 5u] = coords[PZ + 5u] = coords[NZ + 5u] = glm::vec2(1.0f, 0.f);
+    positions[NZ + 2u] = glm::vec3(-1.0f, 1.0f, -1.0f);
+    positions[NZ + 3u] = glm::vec3(1.0f, 1.0f, -1.0f);
+    normals[NZ + 0u] = normals[NZ + 1u] = normals[NZ + 2u] = normals[NZ + 3u] = -default_normals[2u];
+
+    for (uint16_t face = 0u; face < 24u; face += 4u)
+    {
+        coords[face + 0u] = glm::vec2(1.0f, 0.f);
+        coords[face + 1u] = glm::vec2(0.0f, 0.f);
+        coords[face + 2u] = glm::vec2(0.0f, 1.f);
+        coords[face + 3u] = glm::vec2(1.0f, 1.f);
+
+        indices.insert(indices.end(), { face, uint16_t(face + 1u), uint16_t(face + 2u), uint16_t(face + 2u), uint16_t(face + 3u), face });
+    }
+
+#undef PX
+#undef NX
+#undef PY
+#undef NY
+#undef PZ
+#undef NZ
 
     //-------------------------
 
@@ -438,9 +433,7 @@ void CubeMesh::draw() const
 {
     assert(m_bInitialized);
 
-    m_vertexBuffer.enable();
-    glDrawArrays(GL_TRIANGLES, 0, m_count);
-    m_vertexBuffer.disable();
+    drawPrimitives();
 
     CHECKGLERROR();
 }
@@ -482,9 +475,7 @@ void FullscreenTriangleMesh::draw() const
 {
     assert(m_bInitialized);
 
-    m_vertexBuffer.enable();
-    glDrawArrays(GL_TRIANGLES, 0, m_count);
-    m_vertexBuffer.disable();
+    drawPrimitives();
 
     CHECKGLERROR();
 }
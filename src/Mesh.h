@@ -19,6 +19,9 @@
 #include <glm/glm.hpp>
 
 #include <GLType/VertexBuffer.h>
+#include <GraphicsTypes.h>
+
+class GraphicsCommandList;
 
 #ifndef M_PI
 #define M_PI    3.14159265358979323846
@@ -39,6 +42,7 @@ protected:
 
 	VertexBuffer m_vertexBuffer;
 	GLsizei m_count;
+	GraphicsDeviceWeakPtr m_Device;
 
 	/* TODO Move in another object */
 	glm::mat4 m_model;
@@ -56,13 +60,23 @@ public:
 
 	virtual void create() {}
 	virtual void draw() const {}
+	/** Append the draw to 'commands', the mesh must outlive them */
+	void record(GraphicsCommandList& commands) const;
 	virtual void destroy();
 
+	/** With a device the VAO is bound through its state cache and left bound */
+	void setDevice(const GraphicsDevicePtr& device) { m_Device = device; }
+
 	void setModelMatrix(const glm::mat4 &model)     {m_model = model;}
 	void setNormalMatrix(const glm::mat3 &normal)   {m_normal = normal;}
 
 	const glm::mat4& getModelMatrix() const   {return m_model;}
 	const glm::mat3& getNormalMatrix() const  {return m_normal;}
+
+protected:
+	virtual GLenum getPrimitiveMode() const { return GL_TRIANGLES; }
+	/** m_count indices with an index buffer, vertices without */
+	void drawPrimitives() const;
 };
 
 
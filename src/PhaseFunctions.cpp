@@ -9,7 +9,7 @@ glm::vec3 ComputeCoefficientRayleigh(const glm::vec3& lambda)
     const float pi = glm::pi<float>();
 
     const glm::vec3 l4 = lambda*lambda*lambda*lambda;
-    return 8*pi*pi*pi*glm::pow(n*n - 1, 2) / (3*N*l4) * ((6 + 3*p)/(6 - 7*p));
+    return 8*pi*pi*pi*glm::pow(n*n - 1.f, 2.f) / (3*N*l4) * ((6 + 3*p)/(6 - 7*p));
 }
 
 glm::vec3 ComputeCoefficientMie(const glm::vec3& lambda, const glm::vec3& K, float turbidity)
@@ -20,3 +20,12 @@ glm::vec3 ComputeCoefficientMie(const glm::vec3& lambda, const glm::vec3& K, flo
     const float mie =  0.434f * c * pi * glm::pow(2*pi, jungeexp - 2);
     return mie * K / glm::pow(lambda, glm::vec3(jungeexp - 2));
 }
+
+// Linear fit of the concentration, matches PhaseFunctions.glsli
+glm::vec3 ComputeCoefficientLinearMie(const glm::vec3& lambda, const glm::vec3& K, float turbidity)
+{
+    const float pi = glm::pi<float>();
+    const float c = glm::max(0.f, 0.6544f*turbidity - 0.6510f)*1e-16f; // concentration factor
+    const float mie = 0.434f * c * pi * (2*pi) * (2*pi);
+    return mie * K / lambda;
+}
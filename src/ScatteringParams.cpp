@@ -0,0 +1,115 @@
+#include <ScatteringParams.h>
+#include <PhaseFunctions.h>
+#include <cstdio>
+
+namespace
+{
+    // for visualize parameter
+    // https://github.com/gaj-cg/ray-mmd-docs-ja/wiki/
+
+    // scale for km to m
+    const float mUnitDistance = 1000.f;
+    const float mEarthRadius = 6360.f;      // Earth radius up to 6360 km
+    const float mEarthAtmoRadius = 6420.f;  // Earth radius with its atmospheric height up to 6420km
+    // Mie scattering with its phase functions up to 0.76, 0.76 is standard
+    const float g = 0.760f;
+
+    // [Preetham99]
+    const glm::vec3 mWaveLength = glm::vec3(680e-9f, 550e-9f, 440e-9f);   // standard earth lambda of 680nm, 550nm, 450nm
+    const glm::vec3 mMieColor = glm::vec3(0.686282f, 0.677739f, 0.663365f); // spectrum, note that ray-mmd use SunColor
+    const glm::vec3 mRayleighColor = glm::vec3(1.f);
+    const glm::vec3 mCloudColor = glm::vec3(1.f);    // ray-mmd use SunColor instead
+
+    // http://www.iup.physik.uni-bremen.de/gruppen/molspec/databases/referencespectra/o3spectra2011/index.html
+    // Ozone scattering with wavelength (680nm, 550nm, 440nm) and 293K
+    const glm::vec3 mOzoneScatteringCoeff = glm::vec3(1.36820899679147f, 3.31405330400124f, 0.13601728252538f);
+
+    // https://ozonewatch.gsfc.nasa.gov/facts/ozone.html
+    // Ozone scattering with its mass up to 0.00006%, with its number density up to 2.5040
+    const float mOzoneMass = 0.6e-6f * 2.504f;
+    const float mCloudTurbidity = 80.f;
+    const float mMieHeight = 1.2f;          // Mie scattering with its water particles up to 1.2km
+    const float mRayleighHeight = 8.0f;     // Rayleigh scattering with its atmosphereic up to 8.0km
+}
+
+ScatteringParams ComputeScatteringParams(float turbidity, float sunRadius, float sunRadiance, float cloudDensity, float cloudSpeed)
+{
+    ScatteringParams setting = {};
+    setting.mieG = g;
+    setting.sunRadius = sunRadius;
+    setting.sunRadiance = sunRadiance;
+    setting.earthRadius = mEarthRadius * mUnitDistance;
+    setting.earthCenter = glm::vec3(0.f, -setting.earthRadius, 0.f);
+    setting.earthAtmTopRadius = mEarthAtmoRadius * mUnitDistance;
+    setting.waveLambdaMie = ComputeCoefficientLinearMie(mWaveLength, mMieColor, turbidity);
+    setting.waveLambdaOzone = mOzoneScatteringCoeff * mOzoneMass;
+    setting.waveLambdaRayleigh = ComputeCoefficientRayleigh(mWaveLength) * mRayleighColor;
+    setting.mieHeight = mMieHeight * mUnitDistance;
+    setting.rayleighHeight = mRayleighHeight * mUnitDistance;
+
+    setting.cloud = cloudDensity;
+    setting.cloudTop = 5.2f * mUnitDistance;
+    setting.cloudBottom = 5.f * mUnitDistance;
+    setting.clouddir = glm::vec3(1315.7f, 0.f, -3000.f) * cloudSpeed;
+    setting.cloudLambda = ComputeCoefficientLinearMie(mWaveLength, mCloudColor, mCloudTurbidity);
+    return setting;
+}
+
+bool CheckScatteringLayout(GLuint program)
+{
+    struct Member { const GLchar* name; GLint offset; };
+    const Member members[] =
+    {
+    #define SCATTERING_MEMBER(name) { "uScattering." #name, GLint(offsetof(ScatteringParams, name)) }
+        SCATTERING_MEMBER(waveLambdaMie),
+        SCATTERING_MEMBER(mieG),
+        SCATTERING_MEMBER(waveLambdaOzone),
+        SCATTERING_MEMBER(mieHeight),
+        SCATTERING_MEMBER(waveLambdaRayleigh),
+        SCATTERING_MEMBER(rayleighHeight),
+        SCATTERING_MEMBER(earthCenter),
+        SCATTERING_MEMBER(earthRadius),
+        SCATTERING_MEMBER(clouddir),
+        SCATTERING_MEMBER(earthAtmTopRadius),
+        SCATTERING_MEMBER(cloudLambda),
+        SCATTERING_MEMBER(cloud),
+        SCATTERING_MEMBER(cloudBias),
+        SCATTERING_MEMBER(cloudTop),
+        SCATTERING_MEMBER(cloudBottom),
+        SCATTERING_MEMBER(sunRadius),
+        SCATTERING_MEMBER(sunRadiance),
+    #undef SCATTERING_MEMBER
+    };
+    const GLsizei count = GLsizei(sizeof(members) / sizeof(members[0]));
+
+    const GLuint block = glGetUniformBlockIndex(program, "ScatteringUniforms");
+    if (block == GL_INVALID_INDEX)
+    {
+        printf("ScatteringParams : no ScatteringUniforms block.\n");
+        return false;
+    }
+    GLint size = 0;
+    glGetActiveUniformBlockiv(program, block, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+    bool bMatch = size <= GLint(sizeof(ScatteringParams));
+    if (!bMatch)
+        printf("ScatteringParams : block of %d bytes, %d on the CPU.\n", size, int(sizeof(ScatteringParams)));
+
+    // std140 blocks keep every member active, an unknown name is a renamed or removed one
+    const GLchar* names[sizeof(members) / sizeof(members[0])];
+    for (GLsizei i = 0; i < count; i++)
+        names[i] = members[i].name;
+    GLuint indices[sizeof(members) / sizeof(members[0])];
+    glGetUniformIndices(program, count, names, indices);
+    for (GLsizei i = 0; i < count; i++)
+    {
+        GLint offset = -1;
+        if (indices[i] != GL_INVALID_INDEX)
+            glGetActiveUniformsiv(program, 1, &indices[i], GL_UNIFORM_OFFSET, &offset);
+        if (offset != members[i].offset)
+        {
+            printf("ScatteringParams : '%s' at %d in the block, %d on the CPU.\n", members[i].name, offset, members[i].offset);
+            bMatch = false;
+        }
+    }
+    return bMatch;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <glm/glm.hpp>
+
+// CPU side of ScatteringParams in "shaders/Time of day/shader/Atmospheric.glsli",
+// uploaded as the std140 block ScatteringUniforms
+struct ScatteringParams
+{
+    glm::vec3 waveLambdaMie;
+    float mieG;
+    glm::vec3 waveLambdaOzone;
+    float mieHeight;
+    glm::vec3 waveLambdaRayleigh;
+    float rayleighHeight;
+    glm::vec3 earthCenter;
+    float earthRadius;
+    glm::vec3 clouddir;
+    float earthAtmTopRadius;
+    glm::vec3 cloudLambda;
+    float cloud;
+    float cloudBias;
+    float cloudTop;
+    float cloudBottom;
+    float sunRadius;
+    float sunRadiance;
+    float padding[3];
+};
+
+static_assert(offsetof(ScatteringParams, mieG) == 12, "ScatteringParams : std140 layout mismatch");
+static_assert(offsetof(ScatteringParams, waveLambdaOzone) == 16, "ScatteringParams : std140 layout mismatch");
+static_assert(offsetof(ScatteringParams, waveLambdaRayleigh) == 32, "ScatteringParams : std140 layout mismatch");
+static_assert(offsetof(ScatteringParams, earthCenter) == 48, "ScatteringParams : std140 layout mismatch");
+static_assert(offsetof(ScatteringParams, clouddir) == 64, "ScatteringParams : std140 layout mismatch");
+static_assert(offsetof(ScatteringParams, cloudLambda) == 80, "ScatteringParams : std140 layout mismatch");
+static_assert(offsetof(ScatteringParams, cloudBias) == 96, "ScatteringParams : std140 layout mismatch");
+static_assert(offsetof(ScatteringParams, sunRadius) == 108, "ScatteringParams : std140 layout mismatch");
+static_assert(offsetof(ScatteringParams, sunRadiance) == 112, "ScatteringParams : std140 layout mismatch");
+static_assert(sizeof(ScatteringParams) == 128, "ScatteringParams : std140 layout mismatch");
+
+// The offsets above follow std140 by hand, this compares them with those the driver gave
+// the block of a linked 'program', so a change on the GLSL side is caught at load time
+bool CheckScatteringLayout(GLuint program);
+
+// Setting of "Time of day.Fragment", 'cloudSpeed' is the offset of the clouds at the current time
+ScatteringParams ComputeScatteringParams(float turbidity, float sunRadius, float sunRadiance, float cloudDensity, float cloudSpeed);
@@ -0,0 +1,197 @@
+#include <SkyCache.h>
+#include <GL/glew.h>
+#include <glm/gtc/packing.hpp>
+#include <GLType/GraphicsDevice.h>
+#include <GLType/GraphicsTexture.h>
+#include <GLType/OGLTexture.h>
+#include <GLType/OGLCoreTexture.h>
+#include <cmath>
+#include <cassert>
+
+namespace
+{
+    GLuint GetTextureID(const GraphicsDevicePtr& device, const GraphicsTexturePtr& texture)
+    {
+        auto type = device->getGraphicsDeviceDesc().getDeviceType();
+        if (type == GraphicsDeviceType::GraphicsDeviceTypeOpenGLCore)
+            return texture->downcast_pointer<OGLCoreTexture>()->getTextureID();
+        else if (type == GraphicsDeviceType::GraphicsDeviceTypeOpenGL)
+            return texture->downcast_pointer<OGLTexture>()->getTextureID();
+        return GL_NONE;
+    }
+}
+
+SkyCacheKey::SkyCacheKey() noexcept :
+    m_Hash(14695981039346656037ull)
+{
+}
+
+void SkyCacheKey::addBytes(const void* data, size_t size) noexcept
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++)
+    {
+        m_Hash ^= bytes[i];
+        m_Hash *= 1099511628211ull;
+    }
+}
+
+void SkyCacheKey::add(int32_t value) noexcept
+{
+    addBytes(&value, sizeof(value));
+}
+
+void SkyCacheKey::add(float value, float quantum) noexcept
+{
+    assert(quantum > 0.f);
+    int64_t quantized = std::llround(value / quantum);
+    addBytes(&quantized, sizeof(quantized));
+}
+
+void SkyCacheKey::add(const glm::vec3& value, float quantum) noexcept
+{
+    for (int i = 0; i < 3; i++)
+        add(value[i], quantum);
+}
+
+void SkyCacheKey::add(const glm::mat4& value, float quantum) noexcept
+{
+    for (int i = 0; i < 4; i++)
+    for (int k = 0; k < 4; k++)
+        add(value[i][k], quantum);
+}
+
+SkyCache::SkyCache() noexcept :
+    m_Budget(256 << 20),
+    m_UsedBytes(0)
+{
+}
+
+SkyCache::~SkyCache() noexcept
+{
+}
+
+void SkyCache::setDevice(const GraphicsDevicePtr& device) noexcept
+{
+    m_Device = device;
+}
+
+void SkyCache::setBudget(size_t bytes) noexcept
+{
+    m_Budget = bytes;
+    evict(0);
+}
+
+GraphicsTexturePtr SkyCache::find(uint64_t key) noexcept
+{
+    auto it = m_Lookup.find(key);
+    if (it == m_Lookup.end())
+    {
+        m_Stats.misses++;
+        return nullptr;
+    }
+    m_Stats.hits++;
+    m_Entries.splice(m_Entries.begin(), m_Entries, it->second);
+    return it->second->texture;
+}
+
+GraphicsTexturePtr SkyCache::insert(uint64_t key, const GraphicsTexturePtr& source) noexcept
+{
+    auto device = m_Device.lock();
+    assert(device);
+    if (!device || !source) return nullptr;
+
+    const auto& desc = source->getGraphicsTextureDesc();
+    const int32_t width = desc.getWidth(), height = desc.getHeight();
+    assert(desc.getFormat() == gli::FORMAT_RGBA16_SFLOAT_PACK16);
+
+    GraphicsTexturePtr texture;
+    if (GLEW_ARB_copy_image)
+    {
+        texture = createTexture(width, height, gli::FORMAT_RGBA16_SFLOAT_PACK16, nullptr, 0);
+        if (!texture) return nullptr;
+        glCopyImageSubData(
+            GetTextureID(device, source), GL_TEXTURE_2D, 0, 0, 0, 0,
+            GetTextureID(device, texture), GL_TEXTURE_2D, 0, 0, 0, 0,
+            width, height, 1);
+    }
+    else
+    {
+        // Read back through the client, GL 4.1 has no copy image
+        std::vector<uint16_t> pixels(width*height*4);
+        glBindTexture(GL_TEXTURE_2D, GetTextureID(device, source));
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_HALF_FLOAT, pixels.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
+        texture = createTexture(width, height, gli::FORMAT_RGBA16_SFLOAT_PACK16, pixels.data(), uint32_t(pixels.size()*sizeof(uint16_t)));
+        if (!texture) return nullptr;
+    }
+    return insert(key, texture, size_t(width)*height*8);
+}
+
+GraphicsTexturePtr SkyCache::insert(uint64_t key, const std::vector<glm::vec4>& image, int32_t width, int32_t height) noexcept
+{
+    assert(image.size() >= size_t(width*height));
+
+    std::vector<uint32_t> pixels(width*height);
+    for (size_t i = 0; i < pixels.size(); i++)
+        pixels[i] = glm::packF3x9_E1x5(glm::vec3(image[i]));
+
+    auto texture = createTexture(width, height, gli::FORMAT_RGB9E5_UFLOAT_PACK32, pixels.data(), uint32_t(pixels.size()*sizeof(uint32_t)));
+    if (!texture) return nullptr;
+    return insert(key, texture, pixels.size()*sizeof(uint32_t));
+}
+
+GraphicsTexturePtr SkyCache::insert(uint64_t key, const GraphicsTexturePtr& texture, size_t bytes) noexcept
+{
+    auto it = m_Lookup.find(key);
+    if (it != m_Lookup.end())
+    {
+        m_UsedBytes -= it->second->bytes;
+        m_Entries.erase(it->second);
+        m_Lookup.erase(it);
+    }
+
+    // An image over budget is still returned, just not kept
+    if (bytes > m_Budget)
+        return texture;
+
+    evict(bytes);
+    m_Entries.push_front(Entry{ key, bytes, texture });
+    m_Lookup[key] = m_Entries.begin();
+    m_UsedBytes += bytes;
+    return texture;
+}
+
+GraphicsTexturePtr SkyCache::createTexture(int32_t width, int32_t height, GraphicsFormat format, const void* data, uint32_t size) const noexcept
+{
+    auto device = m_Device.lock();
+    assert(device);
+    if (!device) return nullptr;
+
+    GraphicsTextureDesc desc;
+    desc.setWidth(width);
+    desc.setHeight(height);
+    desc.setFormat(format);
+    desc.setStream((uint8_t*)data);
+    desc.setStreamSize(size);
+    return device->createTexture(desc);
+}
+
+void SkyCache::evict(size_t bytes) noexcept
+{
+    while (!m_Entries.empty() && m_UsedBytes + bytes > m_Budget)
+    {
+        const Entry& entry = m_Entries.back();
+        m_UsedBytes -= entry.bytes;
+        m_Lookup.erase(entry.key);
+        m_Entries.pop_back();
+        m_Stats.evictions++;
+    }
+}
+
+void SkyCache::clear() noexcept
+{
+    m_Entries.clear();
+    m_Lookup.clear();
+    m_UsedBytes = 0;
+}
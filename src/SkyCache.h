@@ -0,0 +1,84 @@
+#pragma once
+
+#include <list>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <glm/glm.hpp>
+#include <GraphicsTypes.h>
+
+// FNV-1a hash of quantized scene parameters; values closer than 'quantum' share a key
+class SkyCacheKey
+{
+public:
+    SkyCacheKey() noexcept;
+
+    void add(int32_t value) noexcept;
+    void add(float value, float quantum) noexcept;
+    void add(const glm::vec3& value, float quantum) noexcept;
+    void add(const glm::mat4& value, float quantum) noexcept;
+
+    uint64_t value() const noexcept { return m_Hash; }
+
+private:
+
+    void addBytes(const void* data, size_t size) noexcept;
+
+    uint64_t m_Hash;
+};
+
+// Least recently used cache of baked sky images, bounded by a byte budget.
+// GPU results are copied as RGBA16F, CPU results are packed to RGB9E5
+class SkyCache
+{
+public:
+
+    struct Stats
+    {
+        uint32_t hits = 0;
+        uint32_t misses = 0;
+        uint32_t evictions = 0;
+    };
+
+    SkyCache() noexcept;
+    ~SkyCache() noexcept;
+
+    void setDevice(const GraphicsDevicePtr& device) noexcept;
+    void setBudget(size_t bytes) noexcept;
+
+    // Return the cached texture and mark it as most recently used, nullptr on a miss
+    GraphicsTexturePtr find(uint64_t key) noexcept;
+
+    // Store a copy of a rendered RGBA16F texture
+    GraphicsTexturePtr insert(uint64_t key, const GraphicsTexturePtr& source) noexcept;
+    // Store a CPU image, packed to RGB9E5
+    GraphicsTexturePtr insert(uint64_t key, const std::vector<glm::vec4>& image, int32_t width, int32_t height) noexcept;
+
+    void clear() noexcept;
+
+    size_t size() const noexcept { return m_Entries.size(); }
+    size_t getUsedBytes() const noexcept { return m_UsedBytes; }
+    size_t getBudget() const noexcept { return m_Budget; }
+    const Stats& getStats() const noexcept { return m_Stats; }
+
+private:
+
+    struct Entry
+    {
+        uint64_t key;
+        size_t bytes;
+        GraphicsTexturePtr texture;
+    };
+    typedef std::list<Entry> EntryList;
+
+    GraphicsTexturePtr insert(uint64_t key, const GraphicsTexturePtr& texture, size_t bytes) noexcept;
+    GraphicsTexturePtr createTexture(int32_t width, int32_t height, GraphicsFormat format, const void* data, uint32_t size) const noexcept;
+    void evict(size_t bytes) noexcept;
+
+    size_t m_Budget;
+    size_t m_UsedBytes;
+    Stats m_Stats;
+    EntryList m_Entries; // front is the most recently used
+    std::unordered_map<uint64_t, EntryList::iterator> m_Lookup;
+    GraphicsDeviceWeakPtr m_Device;
+};
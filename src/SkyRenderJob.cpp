@@ -0,0 +1,114 @@
+#include <SkyRenderJob.h>
+#include <Atmosphere.h>
+
+SkyRenderJob::SkyRenderJob() noexcept :
+    m_bPending(false),
+    m_bQuit(false),
+    m_bBusy(false),
+    m_Generation(0),
+    m_Mailbox(nullptr)
+{
+}
+
+SkyRenderJob::~SkyRenderJob() noexcept
+{
+    shutdown();
+}
+
+void SkyRenderJob::startup() noexcept
+{
+    if (m_Thread.joinable())
+        return;
+    m_bQuit = false;
+    m_Thread = std::thread(&SkyRenderJob::run, this);
+}
+
+void SkyRenderJob::shutdown() noexcept
+{
+    if (m_Thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_bQuit = true;
+        }
+        m_Generation++;
+        m_Condition.notify_one();
+        m_Thread.join();
+    }
+    delete m_Mailbox.exchange(nullptr);
+}
+
+void SkyRenderJob::request(const glm::vec3& sunDir, int32_t width, int32_t height, uint64_t key, bool bCache) noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Request = Request{ sunDir, width, height, key, bCache };
+        m_bPending = true;
+        m_bBusy = true;
+        m_Generation++;
+    }
+    m_Condition.notify_one();
+}
+
+void SkyRenderJob::cancel() noexcept
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    // Not picked up by the worker yet, nothing will clear it otherwise
+    if (m_bPending)
+        m_bBusy = false;
+    m_bPending = false;
+    m_Generation++;
+}
+
+std::unique_ptr<SkyRenderJob::Result> SkyRenderJob::poll() noexcept
+{
+    std::unique_ptr<Result> result(m_Mailbox.exchange(nullptr, std::memory_order_acquire));
+
+    // Published just before a newer request
+    if (result && result->generation != m_Generation.load())
+        return nullptr;
+    return result;
+}
+
+void SkyRenderJob::publish(Result* result) noexcept
+{
+    // An image nobody picked up yet is replaced by the newer one
+    delete m_Mailbox.exchange(result, std::memory_order_acq_rel);
+}
+
+void SkyRenderJob::run() noexcept
+{
+    for (;;)
+    {
+        Request request;
+        uint32_t generation = 0;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Condition.wait(lock, [this] { return m_bQuit || m_bPending; });
+            if (m_bQuit)
+                return;
+            request = m_Request;
+            generation = m_Generation.load();
+            m_bPending = false;
+            m_bBusy = true;
+        }
+
+        std::unique_ptr<Result> result(new Result);
+        result->generation = generation;
+        result->key = request.key;
+        result->bCache = request.bCache;
+        result->width = request.width;
+        result->height = request.height;
+        result->image.assign(request.width*request.height, glm::vec4(0.f));
+
+        Atmosphere atmosphere(request.sunDir);
+        bool bComplete = atmosphere.renderSkyDome(result->image, request.width, request.height, &m_Generation, generation);
+        if (bComplete && m_Generation.load() == generation)
+            publish(result.release());
+
+        // A request made meanwhile keeps it set for its own run
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (!m_bPending)
+            m_bBusy = false;
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <condition_variable>
+#include <glm/glm.hpp>
+
+// Renders the CPU sky dome on a worker thread.
+// A new request bumps the generation counter, which cancels the image in flight;
+// completed images are handed back through a single-slot atomic mailbox
+class SkyRenderJob
+{
+public:
+
+    struct Result
+    {
+        uint32_t generation;
+        uint64_t key;       // SkyCache key, meaningful if 'bCache'
+        bool bCache;
+        int32_t width;
+        int32_t height;
+        std::vector<glm::vec4> image;
+    };
+
+    SkyRenderJob() noexcept;
+    ~SkyRenderJob() noexcept;
+
+    void startup() noexcept;
+    void shutdown() noexcept;
+
+    // Replace any pending or running job
+    void request(const glm::vec3& sunDir, int32_t width, int32_t height, uint64_t key, bool bCache) noexcept;
+    // Drop the job in flight, its result is never published
+    void cancel() noexcept;
+
+    // Take the latest completed image, nullptr if there is none
+    std::unique_ptr<Result> poll() noexcept;
+
+    bool isBusy() const noexcept { return m_bBusy.load(); }
+
+private:
+
+    struct Request
+    {
+        glm::vec3 sunDir;
+        int32_t width;
+        int32_t height;
+        uint64_t key;
+        bool bCache;
+    };
+
+    void run() noexcept;
+    void publish(Result* result) noexcept;
+
+    std::thread m_Thread;
+    std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    Request m_Request;
+    bool m_bPending;
+    bool m_bQuit;
+
+    std::atomic<bool> m_bBusy;
+    std::atomic<uint32_t> m_Generation;
+    std::atomic<Result*> m_Mailbox;
+};
@@ -0,0 +1,244 @@
+#include <SkyViewTable.h>
+#include <Atmosphere.h>
+#include <GL/glew.h>
+#include <GLType/GraphicsDevice.h>
+#include <GLType/GraphicsTexture.h>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <cstring>
+#include <cassert>
+#include <cstdio>
+
+namespace
+{
+    const char kMagic[4] = { 'S', 'K', 'Y', 'V' };
+    const uint32_t kVersion = 1;
+
+    // Must match ComputeSkyViewCoord in SkyView.glsl
+    glm::vec3 ComputeSkyViewDirection(float u, float v)
+    {
+        const float pi = glm::pi<float>();
+        float azimuth = u * pi;
+        float e = 2.f * v - 1.f;
+        float elevation = glm::sign(e) * e * e * pi * 0.5f;
+        return glm::vec3(glm::sin(azimuth) * glm::cos(elevation), glm::sin(elevation), -glm::cos(azimuth) * glm::cos(elevation));
+    }
+
+    void BakeTable(const Atmosphere& atmosphere, uint32_t width, uint32_t height, uint32_t* pixels)
+    {
+        // Same camera as Atmosphere::renderSkyDome
+        const float inf = 9e8f;
+        const glm::vec3 cameraPos(0.f, atmosphere.m_Er + 1000.f, 0.f);
+
+        for (uint32_t y = 0; y < height; y++)
+        for (uint32_t x = 0; x < width; x++)
+        {
+            glm::vec3 dir = ComputeSkyViewDirection((x + 0.5f) / width, (y + 0.5f) / height);
+            float tmax = inf;
+            auto t = ComputeRaySphereIntersection(cameraPos, dir, atmosphere.m_Ec, atmosphere.m_Er);
+            if (t.y > 0) tmax = std::max(0.f, t.x);
+            glm::vec4 color = atmosphere.computeIncidentLight(cameraPos, dir, 0.f, tmax);
+            pixels[y*width + x] = glm::packF3x9_E1x5(glm::vec3(color));
+        }
+    }
+}
+
+SkyViewTable::SkyViewTable() noexcept :
+    m_Blend(0.f),
+    m_UploadCount(0),
+    m_bBakeDone(false),
+    m_bBakeCancel(false),
+    m_bBakeResult(false)
+{
+    std::memset(&m_Header, 0, sizeof(m_Header));
+}
+
+SkyViewTable::~SkyViewTable() noexcept
+{
+    close();
+}
+
+void SkyViewTable::setDevice(const GraphicsDevicePtr& device) noexcept
+{
+    m_Device = device;
+}
+
+bool SkyViewTable::bake(const std::string& filename, uint32_t width, uint32_t height, float minElevation, float maxElevation, float step,
+    const std::atomic<bool>* cancel) noexcept
+{
+    assert(step > 0.f && maxElevation >= minElevation);
+
+    Header header;
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.width = width;
+    header.height = height;
+    header.count = uint32_t((maxElevation - minElevation) / step) + 1;
+    header.minElevation = minElevation;
+    header.step = step;
+    header.reserved = 0;
+
+    const size_t tableSize = size_t(width) * height;
+    auto data = std::make_shared<util::FileContainer>(sizeof(Header) + header.count * tableSize * sizeof(uint32_t));
+    std::memcpy(data->data(), &header, sizeof(header));
+    uint32_t* tables = reinterpret_cast<uint32_t*>(data->data() + sizeof(Header));
+
+    printf("SkyViewTable : baking %u tables to \"%s\".\n", header.count, filename.c_str());
+
+    std::atomic<uint32_t> next(0);
+    auto worker = [&]() {
+        for (uint32_t i = next++; i < header.count; i = next++)
+        {
+            if (cancel && cancel->load())
+                return;
+            float elevation = glm::radians(minElevation + i * step);
+            Atmosphere atmosphere(glm::vec3(0.f, glm::sin(elevation), -glm::cos(elevation)));
+            BakeTable(atmosphere, width, height, tables + i * tableSize);
+        }
+    };
+    std::vector<std::thread> threads(std::max(1u, std::thread::hardware_concurrency()));
+    for (auto& thread : threads)
+        thread = std::thread(worker);
+    for (auto& thread : threads)
+        thread.join();
+
+    if (cancel && cancel->load())
+        return false;
+    return util::WriteFileSync(filename, data);
+}
+
+bool SkyViewTable::open(const std::string& filename) noexcept
+{
+    if (isBaking())
+        return false;
+    close();
+
+    if (m_File.open(filename))
+        return validate(filename);
+
+    // The bake takes seconds, the frames go on without the table
+    m_BakeFile = filename;
+    m_bBakeDone = false;
+    m_bBakeCancel = false;
+    m_Bake = std::thread([this]() {
+        m_bBakeResult = bake(m_BakeFile, 128, 128, -10.f, 90.f, 2.f, &m_bBakeCancel);
+        m_bBakeDone = true;
+    });
+    return false;
+}
+
+bool SkyViewTable::poll() noexcept
+{
+    if (!isBaking() || !m_bBakeDone)
+        return false;
+    m_Bake.join();
+    if (!m_bBakeResult)
+    {
+        printf("SkyViewTable : can't bake \"%s\".\n", m_BakeFile.c_str());
+        return false;
+    }
+    return map(m_BakeFile);
+}
+
+void SkyViewTable::cancelBake() noexcept
+{
+    if (!isBaking())
+        return;
+    m_bBakeCancel = true;
+    m_Bake.join();
+}
+
+bool SkyViewTable::map(const std::string& filename) noexcept
+{
+    if (!m_File.open(filename))
+    {
+        printf("SkyViewTable : can't open \"%s\".\n", filename.c_str());
+        return false;
+    }
+    return validate(filename);
+}
+
+bool SkyViewTable::validate(const std::string& filename) noexcept
+{
+    bool bValid = m_File.size() >= sizeof(Header);
+    if (bValid)
+    {
+        std::memcpy(&m_Header, m_File.data(), sizeof(Header));
+        bValid = std::memcmp(m_Header.magic, kMagic, sizeof(kMagic)) == 0
+            && m_Header.version == kVersion
+            && m_Header.count > 0
+            && m_File.size() == sizeof(Header) + size_t(m_Header.count) * m_Header.width * m_Header.height * sizeof(uint32_t);
+    }
+    if (!bValid)
+    {
+        printf("SkyViewTable : \"%s\" is not a valid table.\n", filename.c_str());
+        close();
+        return false;
+    }
+    return true;
+}
+
+void SkyViewTable::close() noexcept
+{
+    cancelBake();
+    for (auto& resident : m_Resident)
+        resident = Resident();
+    m_Textures[0] = m_Textures[1] = nullptr;
+    m_File.close();
+}
+
+const uint32_t* SkyViewTable::getTableData(uint32_t index) const noexcept
+{
+    assert(index < m_Header.count);
+    const size_t tableSize = size_t(m_Header.width) * m_Header.height;
+    return reinterpret_cast<const uint32_t*>(m_File.data() + sizeof(Header)) + index * tableSize;
+}
+
+GraphicsTexturePtr SkyViewTable::acquire(uint32_t index) noexcept
+{
+    for (const auto& resident : m_Resident)
+    {
+        if (resident.texture && resident.index == index)
+            return resident.texture;
+    }
+
+    auto device = m_Device.lock();
+    assert(device);
+    if (!device) return nullptr;
+
+    // Uploaded straight from the mapping, only these pages are read from disk
+    GraphicsTextureDesc desc;
+    desc.setWidth(m_Header.width);
+    desc.setHeight(m_Header.height);
+    desc.setFormat(gli::FORMAT_RGB9E5_UFLOAT_PACK32);
+    desc.setWrapS(GL_CLAMP_TO_EDGE);
+    desc.setWrapT(GL_CLAMP_TO_EDGE);
+    desc.setMinFilter(GL_LINEAR);
+    desc.setMagFilter(GL_LINEAR);
+    desc.setStream((uint8_t*)getTableData(index));
+    desc.setStreamSize(m_Header.width * m_Header.height * sizeof(uint32_t));
+    m_UploadCount++;
+    return device->createTexture(desc);
+}
+
+void SkyViewTable::update(float sunElevation) noexcept
+{
+    if (!isOpen())
+        return;
+
+    float x = glm::clamp((sunElevation - m_Header.minElevation) / m_Header.step, 0.f, float(m_Header.count - 1));
+    uint32_t i0 = uint32_t(x);
+    uint32_t i1 = std::min(i0 + 1, m_Header.count - 1);
+    m_Blend = x - i0;
+
+    Resident next[2];
+    next[0] = Resident{ i0, acquire(i0) };
+    next[1] = Resident{ i1, i1 == i0 ? next[0].texture : acquire(i1) };
+    m_Resident[0] = next[0];
+    m_Resident[1] = next[1];
+    m_Textures[0] = next[0].texture;
+    m_Textures[1] = next[1].texture;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <string>
+#include <atomic>
+#include <thread>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <GraphicsTypes.h>
+#include <tools/FileUtility.h>
+
+// Sky-view tables baked by the CPU atmosphere at evenly spaced sun elevations.
+// Each table maps (azimuth relative to the sun, view elevation) to radiance in RGB9E5;
+// the file is memory mapped and only the two tables around the sun are uploaded.
+// A missing file is baked on a background thread, the caller keeps ray marching meanwhile
+class SkyViewTable
+{
+public:
+
+    struct Header
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t width;      // azimuth [0, pi], the sky is symmetric around the sun plane
+        uint32_t height;     // elevation [-pi/2, pi/2], denser at the horizon
+        uint32_t count;
+        float minElevation;  // sun elevation of the first table, degrees
+        float step;          // degrees between tables
+        uint32_t reserved;
+    };
+
+    SkyViewTable() noexcept;
+    ~SkyViewTable() noexcept;
+
+    void setDevice(const GraphicsDevicePtr& device) noexcept;
+
+    // Map 'filename', false while it doesn't exist yet and is baked in the background
+    bool open(const std::string& filename) noexcept;
+    // Also cancels a bake in flight
+    void close() noexcept;
+    bool isOpen() const noexcept { return m_File.isOpen(); }
+    bool isBaking() const noexcept { return m_Bake.joinable(); }
+    // Once per frame, true when a background bake finished and its file was opened
+    bool poll() noexcept;
+
+    // Stops early without writing the file once '*cancel' is set
+    static bool bake(const std::string& filename, uint32_t width, uint32_t height, float minElevation, float maxElevation, float step,
+        const std::atomic<bool>* cancel = nullptr) noexcept;
+
+    // Make the tables around 'sunElevation' (degrees) resident
+    void update(float sunElevation) noexcept;
+
+    const GraphicsTexturePtr& getTexture(int i) const noexcept { return m_Textures[i]; }
+    float getBlend() const noexcept { return m_Blend; }
+    uint32_t getUploadCount() const noexcept { return m_UploadCount; }
+
+private:
+
+    bool map(const std::string& filename) noexcept;
+    bool validate(const std::string& filename) noexcept;
+    void cancelBake() noexcept;
+    const uint32_t* getTableData(uint32_t index) const noexcept;
+    GraphicsTexturePtr acquire(uint32_t index) noexcept;
+
+    struct Resident
+    {
+        uint32_t index;
+        GraphicsTexturePtr texture;
+    };
+
+    util::MappedFile m_File;
+    Header m_Header;
+    Resident m_Resident[2];
+    GraphicsTexturePtr m_Textures[2];
+    float m_Blend;
+    uint32_t m_UploadCount;
+    GraphicsDeviceWeakPtr m_Device;
+
+    std::thread m_Bake;
+    std::string m_BakeFile;
+    std::atomic<bool> m_bBakeDone;
+    std::atomic<bool> m_bBakeCancel;
+    bool m_bBakeResult;     // written by the bake thread before m_bBakeDone
+};
@@ -0,0 +1,326 @@
+#include "StarCatalogue.h"
+#include <tools/FileUtility.h>
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <cstring>
+#include <cassert>
+#include <cstdio>
+
+namespace
+{
+    const char kPackedMagic[4] = { 'S', 'T', 'R', 'S' };
+    const uint32_t kPackedVersion = 1;
+    const int kCellResolution = 4; // tiles per cube face edge
+
+    struct PackedHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t count;
+    };
+
+    // BSC5 binary header, see http://tdc-www.harvard.edu/catalogs/catalogsb.html
+    struct YaleHeader
+    {
+        int32_t star0;  // subtract from star number to get sequence number
+        int32_t star1;  // first star number in file
+        int32_t starn;  // number of stars in file, negative if J2000 coordinates
+        int32_t stnum;  // 0: no star id numbers, 1: catalogue number, ...
+        int32_t mprop;  // 1 if proper motion is included
+        int32_t nmag;   // number of magnitudes present, negative if J2000
+        int32_t nbent;  // number of bytes per star entry
+    };
+
+    template<typename T>
+    T SwapBytes(T value)
+    {
+        char* bytes = reinterpret_cast<char*>(&value);
+        std::reverse(bytes, bytes + sizeof(T));
+        return value;
+    }
+
+    template<typename T>
+    T ReadValue(const char* data, bool bSwap)
+    {
+        T value;
+        std::memcpy(&value, data, sizeof(T));
+        return bSwap ? SwapBytes(value) : value;
+    }
+
+    // Approximate temperature of the spectral class, interpolated with the subclass digit
+    float ComputeSpectralTemperature(const char type[2])
+    {
+        const char classes[] = "OBAFGKM";
+        const float temperatures[] = { 30000.f, 15000.f, 9000.f, 7000.f, 5500.f, 4500.f, 3200.f, 2400.f };
+
+        const char* p = std::strchr(classes, type[0]);
+        if (p == nullptr || type[0] == '\0')
+            return 5800.f;
+        int index = int(p - classes);
+        float subclass = (type[1] >= '0' && type[1] <= '9') ? (type[1] - '0') / 10.f : 0.f;
+        return glm::mix(temperatures[index], temperatures[index + 1], subclass);
+    }
+
+    // Tanner Helland's fit of the black body color, returned in linear RGB
+    glm::vec3 ComputeBlackbodyColor(float kelvin)
+    {
+        float t = kelvin / 100.f;
+        glm::vec3 color;
+        color.r = t <= 66.f ? 1.f : 1.29293618f * glm::pow(t - 60.f, -0.1332047592f);
+        color.g = t <= 66.f ? 0.39008157f * glm::log(t) - 0.63184144f : 1.12989086f * glm::pow(t - 60.f, -0.0755148492f);
+        color.b = t >= 66.f ? 1.f : (t <= 19.f ? 0.f : 0.54320678f * glm::log(t - 10.f) - 1.19625408f);
+        color = glm::clamp(color, 0.f, 1.f);
+        return glm::pow(color, glm::vec3(2.2f));
+    }
+
+    int ComputeCellIndex(const glm::vec3& dir)
+    {
+        glm::vec3 a = glm::abs(dir);
+        int face = 0;
+        glm::vec2 uv;
+        if (a.x >= a.y && a.x >= a.z)
+            face = dir.x > 0 ? 0 : 1, uv = glm::vec2(dir.y, dir.z) / a.x;
+        else if (a.y >= a.z)
+            face = dir.y > 0 ? 2 : 3, uv = glm::vec2(dir.x, dir.z) / a.y;
+        else
+            face = dir.z > 0 ? 4 : 5, uv = glm::vec2(dir.x, dir.y) / a.z;
+
+        glm::ivec2 tile = glm::clamp(glm::ivec2((uv * 0.5f + 0.5f) * float(kCellResolution)), 0, kCellResolution - 1);
+        return (face * kCellResolution + tile.y) * kCellResolution + tile.x;
+    }
+}
+
+StarCatalogue::StarCatalogue() noexcept
+{
+}
+
+StarCatalogue::~StarCatalogue() noexcept
+{
+}
+
+void StarCatalogue::clear()
+{
+    m_Stars.clear();
+    m_Cells.clear();
+}
+
+bool StarCatalogue::load(const std::string& filename)
+{
+    clear();
+
+    const std::string packed = filename + ".stars";
+    if (!loadPacked(packed))
+    {
+        if (!loadYaleBSC(filename))
+        {
+            printf("StarCatalogue : can't load \"%s\".\n", filename.c_str());
+            return false;
+        }
+        if (!savePacked(packed))
+            printf("StarCatalogue : can't write \"%s\".\n", packed.c_str());
+    }
+    buildCells();
+    return !m_Stars.empty();
+}
+
+bool StarCatalogue::loadPacked(const std::string& filename)
+{
+    auto data = util::ReadFileSync(filename, std::ios::binary);
+    if (data == util::NullFile || data->size() < sizeof(PackedHeader))
+        return false;
+
+    PackedHeader header;
+    std::memcpy(&header, data->data(), sizeof(header));
+    if (std::memcmp(header.magic, kPackedMagic, sizeof(kPackedMagic)) != 0 || header.version != kPackedVersion)
+        return false;
+    if (data->size() != sizeof(PackedHeader) + header.count * sizeof(StarEntry))
+        return false;
+
+    m_Stars.resize(header.count);
+    std::memcpy(m_Stars.data(), data->data() + sizeof(PackedHeader), header.count * sizeof(StarEntry));
+    return true;
+}
+
+bool StarCatalogue::savePacked(const std::string& filename) const
+{
+    PackedHeader header;
+    std::memcpy(header.magic, kPackedMagic, sizeof(kPackedMagic));
+    header.version = kPackedVersion;
+    header.count = uint32_t(m_Stars.size());
+
+    auto data = std::make_shared<util::FileContainer>(sizeof(header) + m_Stars.size() * sizeof(StarEntry));
+    std::memcpy(data->data(), &header, sizeof(header));
+    std::memcpy(data->data() + sizeof(header), m_Stars.data(), m_Stars.size() * sizeof(StarEntry));
+    return util::WriteFileSync(filename, data);
+}
+
+bool StarCatalogue::loadYaleBSC(const std::string& filename)
+{
+    auto data = util::ReadFileSync(filename, std::ios::binary);
+    if (data == util::NullFile || data->size() < sizeof(YaleHeader))
+        return false;
+
+    const char* p = data->data();
+    YaleHeader header;
+    std::memcpy(&header, p, sizeof(header));
+
+    // The catalogue is distributed in both byte orders
+    bool bSwap = header.nbent <= 0 || header.nbent > 256;
+    if (bSwap)
+    {
+        header.starn = SwapBytes(header.starn);
+        header.stnum = SwapBytes(header.stnum);
+        header.mprop = SwapBytes(header.mprop);
+        header.nmag = SwapBytes(header.nmag);
+        header.nbent = SwapBytes(header.nbent);
+    }
+
+    const size_t count = size_t(std::abs(header.starn));
+    const size_t stride = size_t(header.nbent);
+    if (stride == 0 || sizeof(YaleHeader) + count * stride > data->size())
+        return false;
+
+    m_Stars.reserve(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        const char* entry = p + sizeof(YaleHeader) + i * stride;
+        if (header.stnum > 0)
+            entry += sizeof(float);
+
+        double ra = ReadValue<double>(entry, bSwap);
+        double dec = ReadValue<double>(entry + 8, bSwap);
+        char spectral[2] = { entry[16], entry[17] };
+        float magnitude = ReadValue<int16_t>(entry + 18, bSwap) / 100.f;
+
+        // Removed entries keep zero coordinates
+        if (ra == 0.0 && dec == 0.0)
+            continue;
+        if (magnitude > kMagnitudeLimit)
+            continue;
+
+        float cd = float(glm::cos(dec));
+        StarEntry star;
+        star.direction = glm::vec3(cd * float(glm::cos(ra)), float(glm::sin(dec)), -cd * float(glm::sin(ra)));
+        star.magnitude = magnitude;
+        star.color = glm::u8vec4(glm::round(ComputeBlackbodyColor(ComputeSpectralTemperature(spectral)) * 255.f), 255);
+        m_Stars.push_back(star);
+    }
+    return !m_Stars.empty();
+}
+
+void StarCatalogue::setStars(const std::vector<StarEntry>& stars)
+{
+    m_Stars = stars;
+    buildCells();
+}
+
+void StarCatalogue::buildCells()
+{
+    const int numCells = 6 * kCellResolution * kCellResolution;
+
+    std::stable_sort(m_Stars.begin(), m_Stars.end(), [](const StarEntry& a, const StarEntry& b) {
+        return ComputeCellIndex(a.direction) < ComputeCellIndex(b.direction);
+    });
+
+    m_Cells.clear();
+    for (uint32_t i = 0; i < m_Stars.size();)
+    {
+        int index = ComputeCellIndex(m_Stars[i].direction);
+        assert(index < numCells);
+
+        StarCell cell;
+        cell.first = i;
+        cell.axis = glm::vec3(0.f);
+        for (; i < m_Stars.size() && ComputeCellIndex(m_Stars[i].direction) == index; i++)
+            cell.axis += m_Stars[i].direction;
+        cell.count = i - cell.first;
+        cell.axis = glm::normalize(cell.axis);
+
+        float minCos = 1.f;
+        for (uint32_t k = cell.first; k < i; k++)
+            minCos = std::min(minCos, glm::dot(cell.axis, m_Stars[k].direction));
+        cell.sinHalfAngle = minCos > 0.f ? glm::sqrt(1.f - minCos * minCos) : 1.f;
+        m_Cells.push_back(cell);
+    }
+}
+
+void StarCatalogue::cull(const glm::mat4& viewProj, const glm::mat3& rotation, std::vector<glm::uvec2>& runs) const
+{
+    runs.clear();
+
+    // Stars are at infinity, only the side planes matter (w = 0)
+    glm::vec3 planes[4];
+    for (int i = 0; i < 2; i++)
+    {
+        glm::vec3 row(viewProj[0][i], viewProj[1][i], viewProj[2][i]);
+        glm::vec3 w(viewProj[0][3], viewProj[1][3], viewProj[2][3]);
+        planes[i * 2 + 0] = glm::normalize(w + row);
+        planes[i * 2 + 1] = glm::normalize(w - row);
+    }
+
+    for (const auto& cell : m_Cells)
+    {
+        glm::vec3 axis = rotation * cell.axis;
+
+        // Below the horizon
+        bool bVisible = axis.y >= -cell.sinHalfAngle;
+        for (int i = 0; i < 4 && bVisible; i++)
+            bVisible = glm::dot(planes[i], axis) >= -cell.sinHalfAngle;
+        if (!bVisible)
+            continue;
+
+        if (!runs.empty() && runs.back().x + runs.back().y == cell.first)
+            runs.back().y += cell.count;
+        else
+            runs.push_back(glm::uvec2(cell.first, cell.count));
+    }
+}
+
+float StarCatalogue::computeStarIntensity(float magnitude)
+{
+    // square root of the relative flux keeps the faint stars visible
+    return glm::pow(10.f, -0.2f * magnitude);
+}
+
+float StarCatalogue::computeStarSize(float magnitude)
+{
+    return glm::mix(1.f, 3.f, glm::clamp((kMagnitudeLimit - magnitude) / (kMagnitudeLimit + 1.5f), 0.f, 1.f));
+}
+
+void StarCatalogue::rasterize(std::vector<glm::vec4>& image, int width, int height, const glm::mat4& viewProj, const glm::mat3& rotation) const
+{
+    assert(image.size() >= size_t(width * height));
+
+    std::vector<glm::uvec2> runs;
+    cull(viewProj, rotation, runs);
+
+    for (const auto& run : runs)
+    for (uint32_t i = run.x; i < run.x + run.y; i++)
+    {
+        const StarEntry& star = m_Stars[i];
+        glm::vec3 dir = rotation * star.direction;
+        if (dir.y <= 0.f)
+            continue;
+
+        glm::vec4 position = viewProj * glm::vec4(dir, 0.f);
+        if (position.w <= 0.f)
+            continue;
+
+        glm::vec2 center = (glm::vec2(position) / position.w * 0.5f + 0.5f) * glm::vec2(width, height);
+        float size = computeStarSize(star.magnitude);
+        float fade = glm::pow(dir.y, 1.f / 1.5f);
+        glm::vec3 color = glm::vec3(star.color) / 255.f * computeStarIntensity(star.magnitude) * fade;
+
+        glm::ivec2 lo = glm::max(glm::ivec2(glm::floor(center - size)), glm::ivec2(0));
+        glm::ivec2 hi = glm::min(glm::ivec2(glm::ceil(center + size)), glm::ivec2(width, height) - 1);
+        for (int y = lo.y; y <= hi.y; y++)
+        for (int x = lo.x; x <= hi.x; x++)
+        {
+            glm::vec2 coord = (glm::vec2(x, y) + 0.5f - center) / size;
+            float r2 = glm::dot(coord, coord);
+            if (r2 > 1.f)
+                continue;
+            image[y*width + x] += glm::vec4(color * glm::exp(-4.f * r2), 0.f);
+        }
+    }
+}
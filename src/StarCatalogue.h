@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+// Packed star entry, identical on disk and in the GPU instance buffer
+struct StarEntry
+{
+    glm::vec3 direction; // unit vector in equatorial space (y = celestial pole)
+    float magnitude;     // visual magnitude
+    glm::u8vec4 color;   // linear RGB from the spectral type
+};
+
+static_assert(sizeof(StarEntry) == 20, "StarEntry is streamed as is");
+
+// Stars sorted into cube face tiles so a whole tile can be frustum culled
+struct StarCell
+{
+    glm::vec3 axis;      // average direction of the cell
+    float sinHalfAngle;  // sine of the bounding cone half angle
+    uint32_t first;
+    uint32_t count;
+};
+
+class StarCatalogue
+{
+public:
+    // Magnitude limit of the sprite model; fainter stars are dropped on load
+    static constexpr float kMagnitudeLimit = 6.5f;
+
+    StarCatalogue() noexcept;
+    ~StarCatalogue() noexcept;
+
+    // Load '<filename>.stars' if it exists, otherwise convert the Yale Bright Star
+    // Catalogue (BSC5 binary) at 'filename' and write the packed file next to it
+    bool load(const std::string& filename);
+    void clear();
+    // Replace the stars by a known set, as the headless check does
+    void setStars(const std::vector<StarEntry>& stars);
+
+    bool empty() const { return m_Stars.empty(); }
+
+    const std::vector<StarEntry>& getStars() const { return m_Stars; }
+    const std::vector<StarCell>& getCells() const { return m_Cells; }
+
+    // Return the visible [first, count) runs of stars, adjacent runs merged.
+    // 'viewProj' is the view projection and 'rotation' maps catalogue space to world
+    void cull(const glm::mat4& viewProj, const glm::mat3& rotation, std::vector<glm::uvec2>& runs) const;
+
+    // CPU reference of the 'StarField' shaders, accumulates sprites into 'image', checked headless by tools/StarRasterCheck.cpp
+    void rasterize(std::vector<glm::vec4>& image, int width, int height, const glm::mat4& viewProj, const glm::mat3& rotation) const;
+
+    // Sprite model shared with "Time of night/StarField.Vertex"
+    static float computeStarIntensity(float magnitude);
+    static float computeStarSize(float magnitude);
+
+private:
+
+    bool loadPacked(const std::string& filename);
+    bool savePacked(const std::string& filename) const;
+    bool loadYaleBSC(const std::string& filename);
+    void buildCells();
+
+    std::vector<StarEntry> m_Stars;
+    std::vector<StarCell> m_Cells;
+};
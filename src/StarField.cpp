@@ -0,0 +1,122 @@
+#include "StarField.h"
+
+#include <cstddef>
+#include <cassert>
+#include <tools/gltools.hpp>
+#include <GLType/OGLDevice.h>
+#include <GLType/GraphicsCommandList.h>
+
+enum StarAttribLocation
+{
+    SATTRIB_DIRECTION = 0, // direction + magnitude
+    SATTRIB_COLOR
+};
+
+StarField::StarField() noexcept
+    : m_vao(0u), m_vbo(0u), m_count(0)
+{
+}
+
+StarField::~StarField() noexcept
+{
+    destroy();
+}
+
+void StarField::create(const StarCatalogue& catalogue)
+{
+    assert(m_vao == 0u);
+
+    const auto& stars = catalogue.getStars();
+    m_count = GLsizei(stars.size());
+
+    glGenVertexArrays(1, &m_vao);
+    glGenBuffers(1, &m_vbo);
+
+    glBindVertexArray(m_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBufferData(GL_ARRAY_BUFFER, stars.size() * sizeof(StarEntry), stars.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(SATTRIB_DIRECTION);
+    glEnableVertexAttribArray(SATTRIB_COLOR);
+    glVertexAttribDivisor(SATTRIB_DIRECTION, 1);
+    glVertexAttribDivisor(SATTRIB_COLOR, 1);
+    setInstanceOffset(0);
+    glBindVertexArray(0u);
+    glBindBuffer(GL_ARRAY_BUFFER, 0u);
+
+    CHECKGLERROR();
+}
+
+void StarField::destroy()
+{
+    if (m_vao)
+    {
+        auto device = m_Device.lock();
+        if (device)
+            device->downcast_pointer<OGLDevice>()->invalidateVertexArray(m_vao);
+        glDeleteVertexArrays(1, &m_vao);
+        m_vao = 0u;
+    }
+    if (m_vbo)
+    {
+        glDeleteBuffers(1, &m_vbo);
+        m_vbo = 0u;
+    }
+    m_count = 0;
+}
+
+void StarField::setInstanceOffset(GLuint first) const
+{
+    const GLsizei stride = sizeof(StarEntry);
+    const size_t base = size_t(first) * stride;
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glVertexAttribPointer(SATTRIB_DIRECTION, 4, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)(base + offsetof(StarEntry, direction)));
+    glVertexAttribPointer(SATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (const GLvoid*)(base + offsetof(StarEntry, color)));
+}
+
+void StarField::draw(const std::vector<glm::uvec2>& runs) const
+{
+    if (runs.empty())
+        return;
+
+    auto device = m_Device.lock();
+    if (device)
+        device->downcast_pointer<OGLDevice>()->setVertexArray(m_vao);
+    else
+        glBindVertexArray(m_vao);
+    if (GLEW_ARB_base_instance)
+    {
+        for (const auto& run : runs)
+            glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, run.y, run.x);
+    }
+    else
+    {
+        for (const auto& run : runs)
+        {
+            setInstanceOffset(run.x);
+            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, run.y);
+        }
+        setInstanceOffset(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0u);
+    }
+    if (!device)
+        glBindVertexArray(0u);
+
+    CHECKGLERROR();
+}
+
+void StarField::record(GraphicsCommandList& commands, const std::vector<glm::uvec2>& runs) const
+{
+    if (runs.empty())
+        return;
+
+    if (GLEW_ARB_base_instance)
+    {
+        for (const auto& run : runs)
+            commands.draw(m_vao, GL_TRIANGLE_STRIP, 0, 4, run.y, run.x);
+    }
+    else
+    {
+        // Each run re-points the attributes, left to the immediate path
+        commands.call([this, runs]() { draw(runs); });
+    }
+}
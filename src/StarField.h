@@ -0,0 +1,40 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "StarCatalogue.h"
+#include <GraphicsTypes.h>
+
+class GraphicsCommandList;
+
+// GPU side of the star catalogue: one instanced sprite per star.
+// Quad corners come from gl_VertexID, only the instance stream is stored
+class StarField
+{
+public:
+    StarField() noexcept;
+    ~StarField() noexcept;
+
+    void create(const StarCatalogue& catalogue);
+    void destroy();
+
+    // The VAO is then bound through the device state cache
+    void setDevice(const GraphicsDevicePtr& device) noexcept { m_Device = device; }
+
+    bool empty() const { return m_count == 0; }
+
+    // Draw the [first, count) runs returned by StarCatalogue::cull
+    void draw(const std::vector<glm::uvec2>& runs) const;
+    void record(GraphicsCommandList& commands, const std::vector<glm::uvec2>& runs) const;
+
+private:
+
+    void setInstanceOffset(GLuint first) const;
+
+    GraphicsDeviceWeakPtr m_Device;
+    GLuint m_vao;
+    GLuint m_vbo;
+    GLsizei m_count;
+};
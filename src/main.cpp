@@ -18,6 +18,12 @@
 #include <GLType/OGLDevice.h>
 #include <GLType/ProgramShader.h>
 #include <GLType/GraphicsFramebuffer.h>
+#include <GLType/UniformRingBuffer.h>
+#include <GLType/ProgramReloader.h>
+#include <GLType/ProgramPermutation.h>
+#include <GLType/GraphicsCommandList.h>
+#include <GLType/RenderGraph.h>
+#include <GLType/ResizableRenderTarget.h>
 
 #include <GLType/OGLTexture.h>
 #include <GLType/OGLCoreTexture.h>
@@ -27,13 +33,28 @@
 #include <SkyBox.h>
 #include <PhaseFunctions.h>
 #include <Mesh.h>
+#include <StarCatalogue.h>
+#include <StarField.h>
+#include <SkyCache.h>
+#include <SkyViewTable.h>
+#include <SkyRenderJob.h>
+#include <DynamicResolution.h>
+#include <FrameUniforms.h>
+#include <ScatteringParams.h>
 
 #include <fstream>
 #include <memory>
+#include <chrono>
 #include <vector>
 #include <algorithm>
 #include <GameCore.h>
 #include "Atmosphere.h"
+#include "Ephemeris.h"
+
+// Set by CMake to the Shaders target output in the build directory
+#ifndef SHADER_BLOB_PATH
+#define SHADER_BLOB_PATH "resources/Shaders.blob"
+#endif
 
 enum ProfilerType { ProfilerTypeRender = 0 };
 
@@ -41,25 +62,113 @@ namespace
 {
     float s_CpuTick = 0.f;
     float s_GpuTick = 0.f;
+    GraphicsStateStats s_StateStats;
+    GraphicsCommandList::Stats s_CommandStats;
+    RenderGraph::Stats s_GraphStats;
+
+    // Sky domes are seen from inside
+    GraphicsPipelineState MakeSkyState()
+    {
+        GraphicsPipelineState state;
+        state.bCullFace = false;
+        return state;
+    }
+
+    // Layers composited over the sky, never depth tested
+    GraphicsPipelineState MakeOverlayState(GLenum blendSrc, GLenum blendDst)
+    {
+        GraphicsPipelineState state;
+        state.bDepthTest = false;
+        state.bDepthWrite = false;
+        state.bCullFace = false;
+        state.bBlend = true;
+        state.blendSrc = blendSrc;
+        state.blendDst = blendDst;
+        return state;
+    }
+
+    // Fullscreen sky at the far plane, drawn after opaque geometry only where none covers it
+    GraphicsPipelineState MakeFarPlaneState()
+    {
+        GraphicsPipelineState state;
+        state.bDepthWrite = false;
+        state.bCullFace = false;
+        state.depthFunc = GL_EQUAL;
+        return state;
+    }
+
+    GraphicsPipelineState MakeFullscreenState()
+    {
+        GraphicsPipelineState state;
+        state.bDepthTest = false;
+        state.bDepthWrite = false;
+        state.bCullFace = false;
+        return state;
+    }
+
+    // Compiled in as a define, each count is its own program variant
+    bool SampleCountCombo(const char* label, int& samples)
+    {
+        const int counts[] = { 8, 16, 32 };
+        int index = int(std::find(std::begin(counts), std::end(counts), samples) - std::begin(counts));
+        if (!ImGui::Combo(label, &index, "8\0" "16\0" "32\0\0"))
+            return false;
+        samples = counts[index];
+        return true;
+    }
 }
 
 enum EnumSkyModel { kNishita = 0, kTimeOfDay, kTimeOfNight, };
 
+// Program options, in the order they are added to the permutations
+enum NishitaOption { kNishitaChapman = 0, kNishitaSun, kNishitaRayleighOnly, kNishitaSamples, kNishitaToneMap, kNishitaFullscreen, };
+enum TimeOfDayOption { kTimeOfDaySamples = 0, kTimeOfDayCloud, kTimeOfDayLimbDarkening, kTimeOfDayToneMap, kTimeOfDayFullscreen, };
+enum SunDiscOption { kSunDiscSky = 0, kSunDiscChapman, kSunDiscRayleighOnly, kSunDiscFullscreen, };
+enum NightSkyOption { kNightSkyStars = 0, kNightSkyToneMap, kNightSkyFullscreen, };
+
 struct SceneSettings
 {
     bool bProfile = true;
     bool bUiChanged = false;
     bool bResized = false;
     bool bUpdated = true;
+    bool bCameraMoving = false;
 	bool bChapman = true;
+    bool bSunDisk = true;
+    bool bRayleighOnly = false;
+    int nishitaSamples = 16;
     float angle = 76.f;
     float altitude = 1.f;
     float fov = 45.f;
+    // The ray marched skies are drawn at 1/1, 1/2 or 1/4 resolution and upsampled
+    int skyDownsample = 1;
+    bool bSunFullRes = true;    // Nishita sun disc drawn at full resolution over the upsampled sky
+    // Temporal mode, one pixel in 2 or 4 is drawn per frame and the others reprojected
+    int skyInterleave = 1;
+    // Scale of the ray marched sky adjusted every frame to hold its GPU time
+    bool bDynamicResolution = false;
+    float skyBudget = 4.f; // ms
+    // The sky program tone maps straight to the backbuffer when nothing else needs the HDR image
+    bool bFuseToneMap = true;
+    // Skies drawn as a fullscreen triangle with per-pixel rays instead of the sphere
+    bool bSkyFullscreen = true;
+
+    // Ephemeris, places the sun, moon and stars for a date and location
+    bool bEphemeris = false;
+    float latitude = 37.5f;
+    float longitude = 127.f;
+    int date[3] = { 2018, 6, 21 }; // year, month, day
+    float hours = 12.f; // UT
 
     EnumSkyModel kModel = kTimeOfNight;
 
+    // Baked sky results, "Always redraw" bypasses the cache
+    bool bSkyCache = true;
+    float skyCacheBudget = 256.f; // MB
+
     // Nishita Sky model
     bool bCPU = false;
+    bool bSkyViewTable = false; // blend tables baked every 2 degrees of sun elevation
     FloatSetting sunTurbidityParams {"Sun Turbidity", glm::vec3(-7.f, -9.f, -4.f)};
 
     // Time of Day
@@ -70,12 +179,173 @@ struct SceneSettings
     // Sun light power, 10.0 is normal
     FloatSetting sunRadianceParams {"Sun Radiance", glm::vec3(10, 1.0, 20.0)}; 	
     FloatSetting sunTurbidity2Params {"Sun Turbidity", glm::vec3(100.f, 1e-5f, 1000)};
+    bool bCloud = true;
+    bool bLimbDarkening = true;
+    int atmSamples = 16;
 
     // Time of night
+    bool bStarCatalogue = true;
+    bool bNightFused = true;    // stars, moon and atmosphere in one pass instead of three
+    FloatSetting starBrightnessParams {"Star Brightness", glm::vec3(1.0, 0.0, 4.0)};
     FloatSetting moonRadianceParams {"Moon Radiance", glm::vec3(5.0, 1.0, 10.0)}; 	
     FloatSetting moonTurbidityParams {"Moon Turbidity", glm::vec3(200.f, 1e-5f, 500)};
 };
 
+// Uniforms set every frame outside of the FrameUniforms block, resolved once after the programs are linked
+struct NishitaUniforms
+{
+    UniformHandle uEarthRadius, uAtmosphereRadius, uEarthCenter, betaR0, betaM0;
+
+    void resolve(const ProgramShader& program)
+    {
+        uEarthRadius = program.getUniformHandle("uEarthRadius");
+        uAtmosphereRadius = program.getUniformHandle("uAtmosphereRadius");
+        uEarthCenter = program.getUniformHandle("uEarthCenter");
+        betaR0 = program.getUniformHandle("betaR0");
+        betaM0 = program.getUniformHandle("betaM0");
+    }
+};
+
+struct SkyViewUniforms
+{
+    UniformHandle uSkyViewBlend, uSkyViewSamp0, uSkyViewSamp1;
+
+    void resolve(const ProgramShader& program)
+    {
+        uSkyViewBlend = program.getUniformHandle("uSkyViewBlend");
+        uSkyViewSamp0 = program.getUniformHandle("uSkyViewSamp0");
+        uSkyViewSamp1 = program.getUniformHandle("uSkyViewSamp1");
+    }
+};
+
+struct PostProcessHDRUniforms
+{
+    UniformHandle uTexSource, uTexScale;
+
+    void resolve(const ProgramShader& program)
+    {
+        uTexSource = program.getUniformHandle("uTexSource");
+        uTexScale = program.getUniformHandle("uTexScale");
+    }
+};
+
+struct SkyUpsampleUniforms
+{
+    UniformHandle uTexSource, uInvViewProj, uResolution, uSourceSize, uDownsample, uHorizon;
+
+    void resolve(const ProgramShader& program)
+    {
+        uTexSource = program.getUniformHandle("uTexSource");
+        uInvViewProj = program.getUniformHandle("uInvViewProj");
+        uResolution = program.getUniformHandle("uResolution");
+        uSourceSize = program.getUniformHandle("uSourceSize");
+        uDownsample = program.getUniformHandle("uDownsample");
+        uHorizon = program.getUniformHandle("uHorizon");
+    }
+};
+
+struct SkyTemporalUniforms
+{
+    UniformHandle uTexFresh, uTexHistory, uReprojection, uResolution, uFreshSize, uHistoryScale, uInterleave, uOffset;
+
+    void resolve(const ProgramShader& program)
+    {
+        uTexFresh = program.getUniformHandle("uTexFresh");
+        uTexHistory = program.getUniformHandle("uTexHistory");
+        uReprojection = program.getUniformHandle("uReprojection");
+        uResolution = program.getUniformHandle("uResolution");
+        uFreshSize = program.getUniformHandle("uFreshSize");
+        uHistoryScale = program.getUniformHandle("uHistoryScale");
+        uInterleave = program.getUniformHandle("uInterleave");
+        uOffset = program.getUniformHandle("uOffset");
+    }
+};
+
+// Which pixels of the sky image are drawn this frame and where the others were last frame
+struct SkyTemporalFrame
+{
+    glm::ivec2 interleave = glm::ivec2(1);      // pixels of a block, one is drawn
+    glm::ivec2 offset = glm::ivec2(0);          // of the drawn pixel in its block
+    glm::ivec2 size = glm::ivec2(0);            // of the sky image viewport
+    glm::ivec2 freshSize = glm::ivec2(0);       // of the drawn pixels viewport
+    glm::mat4 jitter = glm::mat4(1.f);          // clip space offset of the drawn pixels
+    glm::mat4 viewProj = glm::mat4(1.f);        // rotation only
+    glm::mat4 reprojection = glm::mat4(1.f);
+    GraphicsTexturePtr history;
+    GraphicsTexturePtr target;
+};
+
+// Alternates the separate and fused night passes and averages the Sky pass time of each,
+// along with the color traffic of its full-screen writes and blend reads
+struct NightBenchmark
+{
+    static const uint32_t kFrames = 64;     // per mode
+    static const uint32_t kSkipped = 8;     // the timings read back are still of the other mode
+
+    uint32_t frame = 0;                     // 0 when not running
+    double total[2] = {};
+    double bytes[2] = {};
+    uint32_t count[2] = {};
+    float result[2] = {};                   // ms, separate then fused, 0 until measured
+    float traffic[2] = {};                  // MB per frame, separate then fused
+
+    bool isRunning() const noexcept { return frame > 0; }
+    bool isFused() const noexcept { return ((frame - 1) / kFrames) & 1; }
+};
+
+struct TimeOfDayUniforms
+{
+    UniformHandle uNoiseMapSamp;
+
+    void resolve(const ProgramShader& program)
+    {
+        uNoiseMapSamp = program.getUniformHandle("uNoiseMapSamp");
+    }
+};
+
+struct StarUniforms
+{
+    UniformHandle uMilkyWayMapSamp;
+
+    void resolve(const ProgramShader& program)
+    {
+        uMilkyWayMapSamp = program.getUniformHandle("uMilkyWayMapSamp");
+    }
+};
+
+struct StarFieldUniforms
+{
+    UniformHandle uStarRotation, uInvResolution, uStarBrightness;
+
+    void resolve(const ProgramShader& program)
+    {
+        uStarRotation = program.getUniformHandle("uStarRotation");
+        uInvResolution = program.getUniformHandle("uInvResolution");
+        uStarBrightness = program.getUniformHandle("uStarBrightness");
+    }
+};
+
+struct MoonUniforms
+{
+    UniformHandle uMoonMapSamp;
+
+    void resolve(const ProgramShader& program)
+    {
+        uMoonMapSamp = program.getUniformHandle("uMoonMapSamp");
+    }
+};
+
+struct NightSkyUniforms
+{
+    UniformHandle uMilkyWayMapSamp, uMoonMapSamp;
+
+    void resolve(const ProgramShader& program)
+    {
+        uMilkyWayMapSamp = program.getUniformHandle("uMilkyWayMapSamp");
+        uMoonMapSamp = program.getUniformHandle("uMoonMapSamp");
+    }
+};
+
 class LightScattering final : public gamecore::IGameApp
 {
 public:
@@ -97,6 +367,33 @@ public:
 
 private:
 
+    double getJulianDate() const noexcept;
+    glm::vec3 getSunDirection() const noexcept;
+    glm::vec3 getMoonDirection() const noexcept;
+    bool computeSkyKey(uint64_t& key) const noexcept;
+    void recordFrameUniforms(GraphicsCommandList& commands) const noexcept;
+    void recordSkyPass(GraphicsCommandList& commands, const glm::mat4& jitter, bool& bScattering) noexcept;
+    void recordNishitaUniforms(GraphicsCommandList& commands, const NishitaUniforms& uniforms) const noexcept;
+    void recordSunDisc(GraphicsCommandList& commands) noexcept;
+    void recordSkyGeometry(GraphicsCommandList& commands, bool bFullscreen) const noexcept;
+    void recordSkyUpsample(GraphicsCommandList& commands, const GraphicsTexturePtr& source, const glm::ivec2& sourceSize) noexcept;
+    void recordSkyTemporal(GraphicsCommandList& commands, const GraphicsTexturePtr& fresh, const SkyTemporalFrame& temporal) noexcept;
+    void beginSkyTemporal(const GraphicsTextureDesc& desc, const glm::ivec2& size, SkyTemporalFrame& temporal) noexcept;
+    void endSkyTemporal(const SkyTemporalFrame& temporal) noexcept;
+    bool isSkyRayMarched() const noexcept;
+    int32_t getSkyDownsample() const noexcept;
+    int32_t getSkyInterleave() const noexcept;
+    float getSkyScale() const noexcept;
+    bool isSunSeparate() const noexcept;
+    bool isNightFused() const noexcept;
+    bool isSkyPending() const noexcept;
+    bool canFuseToneMap() const noexcept;
+    bool isSkyToneMapped() const noexcept;
+    void selectSkyPrograms() noexcept;
+    void updateNightBenchmark(bool bDirect) noexcept;
+    double computeNightTraffic(bool bFused, bool bDirect) const noexcept;
+    void updatePermutations() noexcept;
+
     std::vector<glm::vec2> m_Samples;
     SphereMesh m_Sphere;
     SceneSettings m_Settings;
@@ -104,20 +401,61 @@ private:
     SimpleTimer m_Timer;
     FullscreenTriangleMesh m_ScreenTraingle;
     ProgramShader m_FlatShader;
-    ProgramShader m_NishitaSkyShader;
-    ProgramShader m_TimeOfDayShader;
+    ProgramPermutation m_NishitaSky;
+    ProgramShader m_SkyViewShader;
+    ProgramPermutation m_TimeOfDay;
+    ProgramPermutation m_SunDisc;
+    ProgramPermutation m_NightSky;
+    ProgramShader m_SkyUpsampleShader;
+    ProgramShader m_SkyTemporalShader;
     ProgramShader m_TimeOfNightShader;
     ProgramShader m_StarShader;
+    ProgramShader m_StarFieldShader;
     ProgramShader m_MoonShader;
     ProgramShader m_BlitShader;
     ProgramShader m_PostProcessHDRShader;
+    NishitaUniforms m_NishitaUniforms;
+    TimeOfDayUniforms m_TimeOfDayUniforms;
+    NishitaUniforms m_SunDiscUniforms;
+    SkyViewUniforms m_SkyViewUniforms;
+    PostProcessHDRUniforms m_PostProcessHDRUniforms;
+    SkyUpsampleUniforms m_SkyUpsampleUniforms;
+    SkyTemporalUniforms m_SkyTemporalUniforms;
+    ProgramShader* m_NishitaProgram = nullptr;   // variants the handles were resolved against
+    ProgramShader* m_TimeOfDayProgram = nullptr;
+    ProgramShader* m_SunDiscProgram = nullptr;
+    ProgramShader* m_NightSkyProgram = nullptr;
+    StarUniforms m_StarUniforms;
+    StarFieldUniforms m_StarFieldUniforms;
+    MoonUniforms m_MoonUniforms;
+    NightSkyUniforms m_NightSkyUniforms;
+    NightBenchmark m_NightBenchmark;
+    ProgramReloader m_ProgramReloader;
+    UniformRingBuffer m_FrameUniformRing;
+    UniformRingBuffer m_ScatteringRing;
+    GraphicsCommandList m_CommandList;
+    RenderGraph m_RenderGraph;
     GraphicsTexturePtr m_SkyColorTex;
-    GraphicsTexturePtr m_ScreenColorTex;
+    ResizableRenderTarget m_SkyTarget;
+    GraphicsTexturePtr m_SkyHistory[2];     // ping-ponged, pooled
+    uint32_t m_SkyHistoryIndex = 0;         // written this frame
+    uint32_t m_SkyTemporalIndex = 0;
+    uint32_t m_SkyTemporalFrames = 0;       // left before every pixel was drawn at the current camera
+    bool m_bSkyHistoryValid = false;
+    glm::mat4 m_SkyPrevViewProj;
+    glm::ivec2 m_SkyHistorySize;
+    DynamicResolution m_DynamicResolution;
 	GraphicsTexturePtr m_NoiseMapSamp;
 	GraphicsTexturePtr m_MilkywaySamp;
 	GraphicsTexturePtr m_MoonMapSamp;
-    GraphicsFramebufferPtr m_ColorRenderTarget;
     GraphicsDevicePtr m_Device;
+    SkyCache m_SkyCache;
+    SkyViewTable m_SkyViewTable;
+    SkyRenderJob m_SkyRenderJob;
+    GraphicsTexturePtr m_CachedSkyTex;
+    StarCatalogue m_StarCatalogue;
+    StarField m_StarField;
+    std::vector<glm::uvec2> m_StarRuns;
 };
 
 CREATE_APPLICATION(LightScattering);
@@ -147,55 +485,202 @@ void LightScattering::startup() noexcept
 	m_Device = createDevice(deviceDesc);
 	assert(m_Device);
 
+    m_SkyCache.setDevice(m_Device);
+    m_SkyViewTable.setDevice(m_Device);
+    m_FrameUniformRing.create(m_Device, sizeof(FrameUniforms));
+    m_ScatteringRing.create(m_Device, sizeof(ScatteringParams));
+    m_SkyTarget.create(m_Device, gli::FORMAT_RGBA16_SFLOAT_PACK16);
+    m_DynamicResolution.setBudget(m_Settings.skyBudget);
+    m_SkyRenderJob.startup();
+    m_SkyCache.setBudget(size_t(m_Settings.skyCacheBudget) << 20);
+
+    // Warm starts load the linked programs from the binary cache
+    ProgramShader::setBinaryCacheDirectory("resources/ProgramCache");
+    // Written by the Shaders build target, stale stages fall back to the sources
+    ProgramShader::loadShaderBlob(SHADER_BLOB_PATH);
+    auto programStart = std::chrono::steady_clock::now();
+
 	m_FlatShader.setDevice(m_Device);
 	m_FlatShader.initialize();
 	m_FlatShader.addShader(GL_VERTEX_SHADER, "Flat.Vertex");
 	m_FlatShader.addShader(GL_FRAGMENT_SHADER, "Flat.Fragment");
-	m_FlatShader.link();
-
-	m_NishitaSkyShader.setDevice(m_Device);
-	m_NishitaSkyShader.initialize();
-	m_NishitaSkyShader.addShader(GL_VERTEX_SHADER, "Nishita.Vertex");
-	m_NishitaSkyShader.addShader(GL_FRAGMENT_SHADER, "Nishita.Fragment");
-	m_NishitaSkyShader.link();
 
-	m_TimeOfDayShader.setDevice(m_Device);
-	m_TimeOfDayShader.initialize();
-	m_TimeOfDayShader.addShader(GL_VERTEX_SHADER, "Time of day/Time of day.Vertex");
-	m_TimeOfDayShader.addShader(GL_FRAGMENT_SHADER, "Time of day/Time of day.Fragment");
-	m_TimeOfDayShader.link();
+	m_NishitaSky.setDevice(m_Device);
+	m_NishitaSky.addShader(GL_VERTEX_SHADER, "Nishita.Vertex");
+	m_NishitaSky.addShader(GL_FRAGMENT_SHADER, "Nishita.Fragment");
+	m_NishitaSky.addOption("CHAPMAN_ENABLE", true);
+	m_NishitaSky.addOption("SUN_ENABLE", true);
+	m_NishitaSky.addOption("RAYLEIGH_SCTR_ONLY_ENABLE", false);
+	m_NishitaSky.addOption("NUM_SCATTERING_SAMPLES", { 8, 16, 32 });
+	m_NishitaSky.addOption("TONEMAP_ENABLE", false);
+	m_NishitaSky.addOption("FULLSCREEN_ENABLE", false);
+	m_NishitaSky.setCallback([this](ProgramShader& program) {
+		program.initBlockBinding("FrameUniforms");
+		m_ProgramReloader.add(program, [this](ProgramShader& program) {
+			if (&program == m_NishitaProgram)
+				m_NishitaUniforms.resolve(program);
+		});
+	});
+
+	m_SkyViewShader.setDevice(m_Device);
+	m_SkyViewShader.initialize();
+	m_SkyViewShader.addShader(GL_VERTEX_SHADER, "SkyView.Vertex");
+	m_SkyViewShader.addShader(GL_FRAGMENT_SHADER, "SkyView.Fragment");
+
+	m_TimeOfDay.setDevice(m_Device);
+	m_TimeOfDay.addShader(GL_VERTEX_SHADER, "Time of day/Time of day.Vertex");
+	m_TimeOfDay.addShader(GL_FRAGMENT_SHADER, "Time of day/Time of day.Fragment");
+	m_TimeOfDay.addOption("ATM_SAMPLES_NUMS", { 8, 16, 32 });
+	m_TimeOfDay.addOption("ATM_CLOUD_ENABLE", true);
+	m_TimeOfDay.addOption("ATM_LIMADARKENING_ENABLE", true);
+	m_TimeOfDay.addOption("TONEMAP_ENABLE", false);
+	m_TimeOfDay.addOption("FULLSCREEN_ENABLE", false);
+	// A variant or reload whose block no longer matches the CPU struct is rejected
+	m_TimeOfDay.setValidator([](const ProgramShader& program) { return CheckScatteringLayout(program.getShaderID()); });
+	m_TimeOfDay.setCallback([this](ProgramShader& program) {
+		program.initBlockBinding("FrameUniforms");
+		program.initBlockBinding("ScatteringUniforms");
+		m_ProgramReloader.add(program, [this](ProgramShader& program) {
+			if (&program == m_TimeOfDayProgram)
+				m_TimeOfDayUniforms.resolve(program);
+		});
+	});
+	m_SunDisc.setDevice(m_Device);
+	m_SunDisc.addShader(GL_VERTEX_SHADER, "Nishita.Vertex");
+	m_SunDisc.addShader(GL_FRAGMENT_SHADER, "Nishita.Fragment");
+	m_SunDisc.addOption("SKY_ENABLE", false);
+	m_SunDisc.addOption("CHAPMAN_ENABLE", true);
+	m_SunDisc.addOption("RAYLEIGH_SCTR_ONLY_ENABLE", false);
+	m_SunDisc.addOption("FULLSCREEN_ENABLE", false);
+	m_SunDisc.setCallback([this](ProgramShader& program) {
+		program.initBlockBinding("FrameUniforms");
+		m_ProgramReloader.add(program, [this](ProgramShader& program) {
+			if (&program == m_SunDiscProgram)
+				m_SunDiscUniforms.resolve(program);
+		});
+	});
+	m_NightSky.setDevice(m_Device);
+	m_NightSky.addShader(GL_VERTEX_SHADER, "Time of night/Time of night.Vertex");
+	m_NightSky.addShader(GL_FRAGMENT_SHADER, "Time of night/Night.Fragment");
+	m_NightSky.addOption("STARS_ENABLE", true);
+	m_NightSky.addOption("TONEMAP_ENABLE", false);
+	m_NightSky.addOption("FULLSCREEN_ENABLE", false);
+	m_NightSky.setCallback([this](ProgramShader& program) {
+		program.initBlockBinding("FrameUniforms");
+		m_ProgramReloader.add(program, [this](ProgramShader& program) {
+			if (&program == m_NightSkyProgram)
+				m_NightSkyUniforms.resolve(program);
+		});
+	});
+	updatePermutations();
 
 	m_TimeOfNightShader.setDevice(m_Device);
 	m_TimeOfNightShader.initialize();
 	m_TimeOfNightShader.addShader(GL_VERTEX_SHADER, "Time of night/Time of night.Vertex");
 	m_TimeOfNightShader.addShader(GL_FRAGMENT_SHADER, "Time of night/Time of night.Fragment");
-	m_TimeOfNightShader.link();
 
 	m_StarShader.setDevice(m_Device);
 	m_StarShader.initialize();
 	m_StarShader.addShader(GL_VERTEX_SHADER, "Time of night/Stars.Vertex");
 	m_StarShader.addShader(GL_FRAGMENT_SHADER, "Time of night/Stars.Fragment");
-	m_StarShader.link();
+
+	m_StarFieldShader.setDevice(m_Device);
+	m_StarFieldShader.initialize();
+	m_StarFieldShader.addShader(GL_VERTEX_SHADER, "Time of night/StarField.Vertex");
+	m_StarFieldShader.addShader(GL_FRAGMENT_SHADER, "Time of night/StarField.Fragment");
 
 	m_MoonShader.setDevice(m_Device);
 	m_MoonShader.initialize();
 	m_MoonShader.addShader(GL_VERTEX_SHADER, "Time of night/Moon.Vertex");
 	m_MoonShader.addShader(GL_FRAGMENT_SHADER, "Time of night/Moon.Fragment");
-	m_MoonShader.link();
 
 	m_BlitShader.setDevice(m_Device);
 	m_BlitShader.initialize();
 	m_BlitShader.addShader(GL_VERTEX_SHADER, "BlitTexture.Vertex");
 	m_BlitShader.addShader(GL_FRAGMENT_SHADER, "BlitTexture.Fragment");
-	m_BlitShader.link();
 
 	m_PostProcessHDRShader.setDevice(m_Device);
 	m_PostProcessHDRShader.initialize();
 	m_PostProcessHDRShader.addShader(GL_VERTEX_SHADER, "PostProcessHDR.Vertex");
 	m_PostProcessHDRShader.addShader(GL_FRAGMENT_SHADER, "PostProcessHDR.Fragment");
-	m_PostProcessHDRShader.link();
 
+	m_SkyUpsampleShader.setDevice(m_Device);
+	m_SkyUpsampleShader.initialize();
+	m_SkyUpsampleShader.addShader(GL_VERTEX_SHADER, "SkyUpsample.Vertex");
+	m_SkyUpsampleShader.addShader(GL_FRAGMENT_SHADER, "SkyUpsample.Fragment");
+
+	m_SkyTemporalShader.setDevice(m_Device);
+	m_SkyTemporalShader.initialize();
+	m_SkyTemporalShader.addShader(GL_VERTEX_SHADER, "SkyTemporal.Vertex");
+	m_SkyTemporalShader.addShader(GL_FRAGMENT_SHADER, "SkyTemporal.Fragment");
+
+    // Submitted together so the driver can compile them in parallel
+    ProgramShader* programs[] = {
+        &m_FlatShader,
+        &m_NishitaSky.prepare(),
+        &m_SkyViewShader,
+        &m_TimeOfDay.prepare(),
+        &m_TimeOfNightShader,
+        &m_StarShader,
+        &m_StarFieldShader,
+        &m_MoonShader,
+        &m_BlitShader,
+        &m_PostProcessHDRShader,
+        &m_SunDisc.prepare(),
+        &m_NightSky.prepare(),
+        &m_SkyUpsampleShader,
+        &m_SkyTemporalShader,
+    };
+    if (!ProgramShader::linkPrograms(programs, sizeof(programs) / sizeof(programs[0])))
+    {
+        fprintf(stderr, "Execution terminated.\n");
+        exit(EXIT_FAILURE);
+    }
+
+	m_NishitaProgram = &m_NishitaSky.select();
+	m_NishitaUniforms.resolve(*m_NishitaProgram);
+	m_SkyViewShader.initBlockBinding("FrameUniforms");
+	m_SkyViewUniforms.resolve(m_SkyViewShader);
+	m_PostProcessHDRUniforms.resolve(m_PostProcessHDRShader);
+	m_TimeOfDayProgram = &m_TimeOfDay.select();
+	m_TimeOfDayUniforms.resolve(*m_TimeOfDayProgram);
+	m_SunDiscProgram = &m_SunDisc.select();
+	m_SunDiscUniforms.resolve(*m_SunDiscProgram);
+	m_NightSkyProgram = &m_NightSky.select();
+	m_NightSkyUniforms.resolve(*m_NightSkyProgram);
+	m_SkyUpsampleShader.initBlockBinding("FrameUniforms");
+	m_SkyUpsampleUniforms.resolve(m_SkyUpsampleShader);
+	m_SkyTemporalUniforms.resolve(m_SkyTemporalShader);
+	m_TimeOfNightShader.initBlockBinding("FrameUniforms");
+	m_StarShader.initBlockBinding("FrameUniforms");
+	m_StarUniforms.resolve(m_StarShader);
+	m_StarFieldShader.initBlockBinding("FrameUniforms");
+	m_StarFieldUniforms.resolve(m_StarFieldShader);
+	m_MoonShader.initBlockBinding("FrameUniforms");
+	m_MoonUniforms.resolve(m_MoonShader);
+
+    // Edited shaders are rebuilt while running, the handles follow the new programs
+    m_ProgramReloader.add(m_FlatShader);
+    m_ProgramReloader.add(m_SkyViewShader, [this](ProgramShader& program) { m_SkyViewUniforms.resolve(program); });
+    m_ProgramReloader.add(m_TimeOfNightShader);
+    m_ProgramReloader.add(m_BlitShader);
+    m_ProgramReloader.add(m_PostProcessHDRShader, [this](ProgramShader& program) { m_PostProcessHDRUniforms.resolve(program); });
+    m_ProgramReloader.add(m_StarShader, [this](ProgramShader& program) { m_StarUniforms.resolve(program); });
+    m_ProgramReloader.add(m_StarFieldShader, [this](ProgramShader& program) { m_StarFieldUniforms.resolve(program); });
+    m_ProgramReloader.add(m_MoonShader, [this](ProgramShader& program) { m_MoonUniforms.resolve(program); });
+    m_ProgramReloader.add(m_SkyUpsampleShader, [this](ProgramShader& program) { m_SkyUpsampleUniforms.resolve(program); });
+    m_ProgramReloader.add(m_SkyTemporalShader, [this](ProgramShader& program) { m_SkyTemporalUniforms.resolve(program); });
+
+    auto programStats = ProgramShader::getBinaryCacheStats();
+    std::chrono::duration<double, std::milli> programTime = std::chrono::steady_clock::now() - programStart;
+    const uint32_t programCount = programStats.hits + programStats.misses;
+    printf("LightScattering : programs ready in %.1f ms (%s start, %u of %u from the binary cache).\n",
+        programTime.count(), programCount == 0 ? "uncached" : programStats.misses == 0 ? "warm" : "cold",
+        programStats.hits, programCount);
+
+    m_ScreenTraingle.setDevice(m_Device);
     m_ScreenTraingle.create();
+    m_Sphere.setDevice(m_Device);
     m_Sphere.create();
 
     GraphicsTextureDesc noise;
@@ -221,12 +706,24 @@ void LightScattering::startup() noexcept
     moon.setMagFilter(GL_LINEAR);
     moon.setFilename("resources/Skybox/moon.jpg");
     m_MoonMapSamp = m_Device->createTexture(moon);
+
+    // Yale Bright Star Catalogue (BSC5), falls back to the procedural stars if missing
+    m_StarField.setDevice(m_Device);
+    if (m_StarCatalogue.load("resources/Stars/BSC5"))
+        m_StarField.create(m_StarCatalogue);
 }
 
 void LightScattering::closeup() noexcept
 {
     m_Sphere.destroy();
     m_ScreenTraingle.destroy();
+    m_StarField.destroy();
+    m_SkyCache.clear();
+    m_SkyViewTable.close();
+    m_SkyRenderJob.shutdown();
+    m_FrameUniformRing.destroy();
+    m_ScatteringRing.destroy();
+    m_SkyTarget.destroy();
 	profiler::shutdown();
 }
 
@@ -247,22 +744,70 @@ void LightScattering::update() noexcept
         preWidth = width, preHeight = height;
         bResized = true;
     }
-    m_Settings.bUpdated = (m_Settings.bUiChanged || bCameraUpdated || bResized);
+    // Images cached from the replaced programs are stale
+    bool bReloaded = m_ProgramReloader.update();
+    if (bReloaded)
+    {
+        m_SkyCache.clear();
+        // The edit may also fix the variants that failed
+        m_NishitaSky.retryFailed();
+        m_TimeOfDay.retryFailed();
+        m_SunDisc.retryFailed();
+        m_NightSky.retryFailed();
+    }
+
+    // Redraw again once a variant still compiling is ready
+    updatePermutations();
+    bool bPending = isSkyPending();
+
+    // The sky target settled on the window size and was replaced
+    bool bReallocated = m_SkyTarget.update();
+    // The ray marched sky was drawn while the tables were baked
+    bool bTableReady = m_SkyViewTable.poll();
+    if (bTableReady)
+        m_Settings.bSkyViewTable = true;
+
+    m_Settings.bUpdated = (m_Settings.bUiChanged || bCameraUpdated || bResized || bReloaded || bPending || bReallocated || bTableReady);
+    // Every frame of a camera motion is a new key, caching them would evict the revisited settings
+    m_Settings.bCameraMoving = bCameraUpdated;
+
+    // Only the camera moving keeps the temporal history, it rotates the sky without changing it
+    if (m_Settings.bUiChanged || bResized || bReloaded || bPending || bReallocated || bTableReady)
+        m_bSkyHistoryValid = false;
+    if (m_Settings.bUpdated)
+        m_SkyTemporalFrames = getSkyInterleave() > 1 ? uint32_t(getSkyInterleave()) : 0;
     if (m_Settings.bUpdated && m_Settings.bCPU)
     {
-        float angle = glm::radians(m_Settings.angle);
-        std::vector<glm::vec4> image(width*height, glm::vec4(0.f));
-        glm::vec3 sunDir = glm::vec3(0.0f, glm::cos(angle), -glm::sin(angle));
+        uint64_t key = 0;
+        bool bCache = m_Settings.bSkyCache && computeSkyKey(key);
+        auto cached = bCache ? m_SkyCache.find(key) : nullptr;
+        if (cached)
+        {
+            m_SkyColorTex = cached;
+            m_SkyRenderJob.cancel();
+        }
+        else
+        {
+            // The last completed image keeps displaying meanwhile
+            m_SkyRenderJob.request(getSunDirection(), width, height, key, bCache && !bCameraUpdated);
+        }
+    }
 
-        Atmosphere atmosphere(sunDir);
-        atmosphere.renderSkyDome(image, width, height);
+    auto result = m_SkyRenderJob.poll();
+    if (result)
+    {
+        if (result->bCache)
+        {
+            m_SkyColorTex = m_SkyCache.insert(result->key, result->image, result->width, result->height);
+            return;
+        }
 
         GraphicsTextureDesc colorDesc;
-        colorDesc.setWidth(width);
-        colorDesc.setHeight(height);
+        colorDesc.setWidth(result->width);
+        colorDesc.setHeight(result->height);
         colorDesc.setFormat(gli::FORMAT_RGBA32_SFLOAT_PACK32);
-        colorDesc.setStream((uint8_t*)image.data());
-        colorDesc.setStreamSize(width*height*sizeof(glm::vec4));
+        colorDesc.setStream((uint8_t*)result->image.data());
+        colorDesc.setStreamSize(result->width*result->height*sizeof(glm::vec4));
         m_SkyColorTex = m_Device->createTexture(colorDesc);
     }
 }
@@ -286,6 +831,24 @@ void LightScattering::updateHUD() noexcept
         {
             ImGui::Text("CPU %s: %10.5f ms\n", "Main", s_CpuTick);
             ImGui::Text("GPU %s: %10.5f ms\n", "Main", s_GpuTick);
+            if (m_Settings.bSkyCache)
+            {
+                const auto& stats = m_SkyCache.getStats();
+                ImGui::Text("Sky cache: %d entries, %.1f MB\n", int(m_SkyCache.size()), m_SkyCache.getUsedBytes() / float(1 << 20));
+                ImGui::Text("Hits %u, misses %u, evictions %u\n", stats.hits, stats.misses, stats.evictions);
+            }
+            ImGui::Text("GL state: %u calls, %u elided\n", s_StateStats.calls, s_StateStats.elided);
+            ImGui::Text("Commands: %u (%u draws), %u bytes\n", s_CommandStats.commands,
+                s_CommandStats.counts[GraphicsCommandList::kCommandDraw], s_CommandStats.bytes);
+            ImGui::Text("Graph: %u passes, %u culled, %.1f MB (%.1f MB unaliased)\n", s_GraphStats.passes, s_GraphStats.culled,
+                s_GraphStats.transientBytes / float(1 << 20), s_GraphStats.unaliasedBytes / float(1 << 20));
+            const auto& pool = m_Device->downcast_pointer<OGLDevice>()->getTexturePoolStats();
+            ImGui::Text("Texture pool: %.1f MB, %u allocations, %u reuses, %u evictions\n", pool.bytes / float(1 << 20),
+                pool.allocations, pool.reuses, pool.evictions);
+            if (m_Settings.bDynamicResolution)
+                ImGui::Text("Sky scale: %.2f (%.2f of %.1f ms)\n", getSkyScale(), m_DynamicResolution.getTime(), m_DynamicResolution.getBudget());
+            for (const auto& timing : m_RenderGraph.getPassTimings())
+                ImGui::Text("GPU %s: %10.5f ms\n", timing.name.c_str(), timing.gpuTime);
             ImGui::Separator();
 
             ImGui::Text("Sky Models:");
@@ -297,22 +860,81 @@ void LightScattering::updateHUD() noexcept
         }
         ImGui::Separator();
         {
-            bUpdated |= ImGui::SliderFloat("Sun Angle", &m_Settings.angle, 0.f, 120.f);
+            bUpdated |= ImGui::Checkbox("Ephemeris", &m_Settings.bEphemeris);
+            if (m_Settings.bEphemeris)
+            {
+                bUpdated |= ImGui::InputInt3("Date", m_Settings.date);
+                bUpdated |= ImGui::SliderFloat("Time (UT)", &m_Settings.hours, 0.f, 24.f);
+                bUpdated |= ImGui::SliderFloat("Latitude", &m_Settings.latitude, -90.f, 90.f);
+                bUpdated |= ImGui::SliderFloat("Longitude", &m_Settings.longitude, -180.f, 180.f);
+            }
+            else
+            {
+                bUpdated |= ImGui::SliderFloat("Sun Angle", &m_Settings.angle, 0.f, 120.f);
+            }
             bUpdated |= m_Settings.sunRaidusParams.updateGUI();
             bUpdated |= ImGui::SliderFloat("Altitude (km)", &m_Settings.altitude, 0.f, 100.f);
             bUpdated |= ImGui::SliderFloat("Fov", &m_Settings.fov, 15.f, 120.f);
+            int downsample = m_Settings.skyDownsample == 4 ? 2 : m_Settings.skyDownsample - 1;
+            if (ImGui::Combo("Sky resolution", &downsample, "Full\0" "Half\0" "Quarter\0\0"))
+            {
+                m_Settings.skyDownsample = 1 << downsample;
+                bUpdated = true;
+            }
+            if (m_Settings.skyDownsample > 1 && m_Settings.kModel == kNishita && m_Settings.skyInterleave == 1)
+                bUpdated |= ImGui::Checkbox("Full resolution sun", &m_Settings.bSunFullRes);
+            if (ImGui::Checkbox("Dynamic resolution", &m_Settings.bDynamicResolution))
+            {
+                m_DynamicResolution.reset();
+                bUpdated = true;
+            }
+            if (m_Settings.bDynamicResolution && ImGui::SliderFloat("Sky budget (ms)", &m_Settings.skyBudget, 0.5f, 16.f))
+            {
+                m_DynamicResolution.setBudget(m_Settings.skyBudget);
+                m_DynamicResolution.reset();
+            }
+            bUpdated |= ImGui::Checkbox("Tone map in the sky pass", &m_Settings.bFuseToneMap);
+            bUpdated |= ImGui::Checkbox("Fullscreen sky", &m_Settings.bSkyFullscreen);
+            int interleave = m_Settings.skyInterleave / 2;
+            if (ImGui::Combo("Temporal", &interleave, "Off\0" "1 in 2\0" "1 in 4\0\0"))
+            {
+                m_Settings.skyInterleave = interleave == 0 ? 1 : interleave * 2;
+                bUpdated = true;
+            }
+            bUpdated |= ImGui::Checkbox("Sky cache", &m_Settings.bSkyCache);
+            if (m_Settings.bSkyCache && ImGui::SliderFloat("Cache budget (MB)", &m_Settings.skyCacheBudget, 16.f, 1024.f))
+                m_SkyCache.setBudget(size_t(m_Settings.skyCacheBudget) << 20);
         }
         ImGui::Separator();
         if (m_Settings.kModel == kNishita)
         {
             bUpdated |= ImGui::Checkbox("Mode CPU", &m_Settings.bCPU);
+            if (m_Settings.bCPU && m_SkyRenderJob.isBusy())
+                ImGui::Text("Rendering on the CPU...\n");
             bUpdated |= ImGui::Checkbox("Always redraw", &m_Settings.bProfile);
             bUpdated |= ImGui::Checkbox("Use chapman approximation", &m_Settings.bChapman);
+            bUpdated |= ImGui::Checkbox("Sun disk", &m_Settings.bSunDisk);
+            bUpdated |= ImGui::Checkbox("Rayleigh scattering only", &m_Settings.bRayleighOnly);
+            bUpdated |= SampleCountCombo("Samples", m_Settings.nishitaSamples);
+            if (ImGui::Checkbox("Day-cycle table", &m_Settings.bSkyViewTable))
+            {
+                bUpdated = true;
+                // Baked in the background on first use, switched on once the file is ready
+                if (m_Settings.bSkyViewTable && !m_SkyViewTable.isOpen())
+                    m_Settings.bSkyViewTable = m_SkyViewTable.open("resources/SkyView.tables");
+            }
+            if (m_SkyViewTable.isBaking())
+                ImGui::Text("Baking the day-cycle tables...\n");
+            if (m_Settings.bSkyViewTable)
+                ImGui::Text("Table uploads: %u\n", m_SkyViewTable.getUploadCount());
             bUpdated |= m_Settings.sunRadianceParams.updateGUI();
             bUpdated |= m_Settings.sunTurbidityParams.updateGUI();
         }
         if (m_Settings.kModel == kTimeOfDay)
         {
+            bUpdated |= ImGui::Checkbox("Clouds", &m_Settings.bCloud);
+            bUpdated |= ImGui::Checkbox("Limb darkening", &m_Settings.bLimbDarkening);
+            bUpdated |= SampleCountCombo("Samples", m_Settings.atmSamples);
             bUpdated |= m_Settings.cloudSpeedParams.updateGUI();
             bUpdated |= m_Settings.cloudDensityParams.updateGUI();
             bUpdated |= m_Settings.sunRadianceParams.updateGUI();
@@ -320,8 +942,31 @@ void LightScattering::updateHUD() noexcept
         }
         if (m_Settings.kModel == kTimeOfNight)
         {
+            if (!m_StarField.empty())
+            {
+                bUpdated |= ImGui::Checkbox("Star catalogue", &m_Settings.bStarCatalogue);
+                bUpdated |= m_Settings.starBrightnessParams.updateGUI();
+            }
             bUpdated |= m_Settings.moonRadianceParams.updateGUI();
             bUpdated |= m_Settings.moonTurbidityParams.updateGUI();
+            bUpdated |= ImGui::Checkbox("Fused passes", &m_Settings.bNightFused);
+            auto& bench = m_NightBenchmark;
+            if (bench.isRunning())
+            {
+                ImGui::Text("Comparing... %u / %u\n", bench.frame, 2 * NightBenchmark::kFrames);
+            }
+            else if (ImGui::Button("Compare passes"))
+            {
+                bench = NightBenchmark();
+                bench.frame = 1;
+            }
+            if (bench.result[0] > 0.f && bench.result[1] > 0.f)
+            {
+                ImGui::Text("Sky pass: %.3f ms separate, %.3f ms fused (%.2fx)\n",
+                    bench.result[0], bench.result[1], bench.result[0] / bench.result[1]);
+                ImGui::Text("Color traffic: %.1f MB separate, %.1f MB fused (%.1f MB saved)\n",
+                    bench.traffic[0], bench.traffic[1], bench.traffic[0] - bench.traffic[1]);
+            }
         }
     }
     ImGui::Unindent();
@@ -330,123 +975,618 @@ void LightScattering::updateHUD() noexcept
     m_Settings.bUiChanged = bUpdated;
 }
 
+void LightScattering::recordSkyPass(GraphicsCommandList& commands, const glm::mat4& jitter, bool& bScattering) noexcept
+{
+    // sky box, depth writes enabled before the clear
+    commands.setPipelineState(MakeSkyState());
+    commands.clear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+
+    const float time = m_Timer.duration();
+	glm::vec2 resolution(m_SkyTarget.getWidth(), m_SkyTarget.getHeight());
+    glm::vec3 sunDir = getSunDirection();
+    glm::vec3 moonDir = getMoonDirection();
+
+    // Shared by every sky program, the night shaders are lit by the moon passed as the opposite of the sun
+    FrameUniforms frame;
+    frame.modelToProj = jitter * m_Camera.getViewProjMatrix();
+    frame.cameraPosition = m_Camera.getPosition();
+    frame.time = time;
+    frame.sunDir = m_Settings.kModel == kTimeOfNight ? -moonDir : glm::normalize(sunDir);
+    frame.altitude = m_Settings.altitude*1e3f;
+    frame.moonDir = moonDir;
+    frame.turbidity = m_Settings.kModel == kTimeOfNight ? m_Settings.moonTurbidityParams.value() : m_Settings.sunTurbidity2Params.value();
+    frame.sunRadius = m_Settings.sunRaidusParams.value();
+    frame.sunRadiance = m_Settings.sunRadianceParams.value();
+    frame.moonBrightness = m_Settings.moonRadianceParams.ratio();
+    frame.padding = 0.f;
+    m_FrameUniformRing.update(&frame, sizeof(frame));
+
+    if (m_Settings.kModel == kNishita && m_Settings.bSkyViewTable)
+    {
+        m_SkyViewTable.update(glm::degrees(glm::asin(glm::clamp(sunDir.y, -1.f, 1.f))));
+
+        commands.setProgram(m_SkyViewShader);
+        recordFrameUniforms(commands);
+        commands.setUniform(m_SkyViewUniforms.uSkyViewBlend, m_SkyViewTable.getBlend());
+        commands.bindTexture(m_SkyViewUniforms.uSkyViewSamp0, m_SkyViewTable.getTexture(0), 0);
+        commands.bindTexture(m_SkyViewUniforms.uSkyViewSamp1, m_SkyViewTable.getTexture(1), 1);
+        m_Sphere.record(commands);
+    }
+    else if (m_Settings.kModel == kNishita)
+    {
+        const bool bFullscreen = m_NishitaSky.getSelectedOption(kNishitaFullscreen) != 0;
+        if (bFullscreen)
+            commands.setPipelineState(MakeFarPlaneState());
+        commands.setProgram(*m_NishitaProgram);
+        recordFrameUniforms(commands);
+        recordNishitaUniforms(commands, m_NishitaUniforms);
+        recordSkyGeometry(commands, bFullscreen);
+    }
+    if (m_Settings.kModel == kTimeOfDay)
+    {
+        ScatteringParams scattering = ComputeScatteringParams(
+            m_Settings.sunTurbidity2Params.value(),
+            m_Settings.sunRaidusParams.value(),
+            m_Settings.sunRadianceParams.value(),
+            m_Settings.cloudDensityParams.value(),
+            m_Settings.cloudSpeedParams.value() * time);
+        m_ScatteringRing.update(&scattering, sizeof(scattering));
+
+        const bool bFullscreen = m_TimeOfDay.getSelectedOption(kTimeOfDayFullscreen) != 0;
+        if (bFullscreen)
+            commands.setPipelineState(MakeFarPlaneState());
+        commands.setProgram(*m_TimeOfDayProgram);
+        recordFrameUniforms(commands);
+        commands.bindBuffer("ScatteringUniforms", m_ScatteringRing.getData(), m_ScatteringRing.getOffset(), m_ScatteringRing.getSize());
+        commands.bindTexture(m_TimeOfDayUniforms.uNoiseMapSamp, m_NoiseMapSamp, 0);
+        recordSkyGeometry(commands, bFullscreen);
+        bScattering = true;
+    }
+    if (m_Settings.kModel == kTimeOfNight)
+    {
+        const bool bFused = isNightFused();
+        if (m_Settings.bStarCatalogue && !m_StarField.empty())
+        {
+            glm::mat3 rotation = ComputeEquatorialToHorizon(getJulianDate(), m_Settings.latitude, m_Settings.longitude);
+
+            m_StarCatalogue.cull(m_Camera.getViewProjMatrix(), rotation, m_StarRuns);
+
+            commands.setPipelineState(MakeOverlayState(GL_ONE, GL_ONE));
+
+            commands.setProgram(m_StarFieldShader);
+            recordFrameUniforms(commands);
+            commands.setUniform(m_StarFieldUniforms.uStarRotation, rotation);
+            commands.setUniform(m_StarFieldUniforms.uInvResolution, 1.f / resolution);
+            commands.setUniform(m_StarFieldUniforms.uStarBrightness, m_Settings.starBrightnessParams.value());
+            m_StarField.record(commands, m_StarRuns);
+        }
+        if (bFused)
+        {
+            // The procedural stars variant covers the sky, the catalogue one is blended over the points
+            const bool bFullscreen = m_NightSky.getSelectedOption(kNightSkyFullscreen) != 0;
+            if (m_Settings.bStarCatalogue && !m_StarField.empty())
+                commands.setPipelineState(MakeOverlayState(GL_ONE, GL_SRC_ALPHA));
+            else if (bFullscreen)
+                commands.setPipelineState(MakeFarPlaneState());
+            else
+                commands.setPipelineState(MakeSkyState());
+            commands.setProgram(*m_NightSkyProgram);
+            recordFrameUniforms(commands);
+            commands.bindTexture(m_NightSkyUniforms.uMilkyWayMapSamp, m_MilkywaySamp, 0);
+            commands.bindTexture(m_NightSkyUniforms.uMoonMapSamp, m_MoonMapSamp, 1);
+            recordSkyGeometry(commands, bFullscreen);
+            return;
+        }
+        if (!m_Settings.bStarCatalogue || m_StarField.empty())
+        {
+            commands.setProgram(m_StarShader);
+            recordFrameUniforms(commands);
+            commands.bindTexture(m_StarUniforms.uMilkyWayMapSamp, m_MilkywaySamp, 0);
+            m_Sphere.record(commands);
+        }
+        commands.setPipelineState(MakeOverlayState(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
+
+        commands.setProgram(m_MoonShader);
+        recordFrameUniforms(commands);
+        commands.bindTexture(m_MoonUniforms.uMoonMapSamp, m_MoonMapSamp, 0);
+        m_Sphere.record(commands);
+
+        commands.setPipelineState(MakeOverlayState(GL_ONE, GL_SRC_ALPHA));
+        commands.setProgram(m_TimeOfNightShader);
+        recordFrameUniforms(commands);
+        m_Sphere.record(commands);
+    }
+}
+
+void LightScattering::recordNishitaUniforms(GraphicsCommandList& commands, const NishitaUniforms& uniforms) const noexcept
+{
+    // [Preetham99]
+    const glm::vec3 K = glm::vec3(0.686282f, 0.677739f, 0.663365f); // spectrum
+    const glm::vec3 lambda = glm::vec3(680e-9f, 550e-9f, 440e-9f);
+
+    float turbidity = glm::exp(m_Settings.sunTurbidityParams.value());
+    glm::vec3 mie = ComputeCoefficientMie(lambda, K, turbidity);
+    glm::vec3 rayleigh = ComputeCoefficientRayleigh(lambda);
+
+    commands.setUniform(uniforms.uEarthRadius, 6360e3f);
+    commands.setUniform(uniforms.uAtmosphereRadius, 6420e3f);
+    commands.setUniform(uniforms.uEarthCenter, glm::vec3(0.f));
+    commands.setUniform(uniforms.betaR0, rayleigh);
+    commands.setUniform(uniforms.betaM0, mie);
+}
+
+// Added over the upsampled sky, reads the frame uniforms written by recordSkyPass
+void LightScattering::recordSunDisc(GraphicsCommandList& commands) noexcept
+{
+    ProgramShader& sun = m_SunDisc.select();
+    if (&sun != m_SunDiscProgram)
+    {
+        m_SunDiscProgram = &sun;
+        m_SunDiscUniforms.resolve(sun);
+    }
+    commands.setPipelineState(MakeOverlayState(GL_ONE, GL_ONE));
+    commands.setProgram(sun);
+    recordFrameUniforms(commands);
+    recordNishitaUniforms(commands, m_SunDiscUniforms);
+    recordSkyGeometry(commands, m_SunDisc.getSelectedOption(kSunDiscFullscreen) != 0);
+}
+
+// The variant's vertex stage decides, the fullscreen one unprojects the triangle's corners
+void LightScattering::recordSkyGeometry(GraphicsCommandList& commands, bool bFullscreen) const noexcept
+{
+    if (bFullscreen)
+        m_ScreenTraingle.record(commands);
+    else
+        m_Sphere.record(commands);
+}
+
+void LightScattering::recordSkyUpsample(GraphicsCommandList& commands, const GraphicsTexturePtr& source, const glm::ivec2& sourceSize) noexcept
+{
+    const glm::vec2 resolution(m_SkyTarget.getWidth(), m_SkyTarget.getHeight());
+
+    // The horizon dips below zero elevation as the camera rises
+    const float earthRadius = 6360e3f;
+    const float height = m_Settings.altitude*1e3f + 1.f;
+    const float horizon = -glm::sqrt(1.f - glm::pow(earthRadius / (earthRadius + height), 2.f));
+
+    commands.setPipelineState(MakeFullscreenState());
+    commands.setProgram(m_SkyUpsampleShader);
+    recordFrameUniforms(commands);
+    commands.bindTexture(m_SkyUpsampleUniforms.uTexSource, source, 0);
+    commands.setUniform(m_SkyUpsampleUniforms.uInvViewProj, glm::inverse(m_Camera.getViewProjMatrix()));
+    commands.setUniform(m_SkyUpsampleUniforms.uResolution, resolution);
+    commands.setUniform(m_SkyUpsampleUniforms.uSourceSize, glm::vec2(sourceSize));
+    commands.setUniform(m_SkyUpsampleUniforms.uDownsample, resolution / glm::vec2(sourceSize));
+    commands.setUniform(m_SkyUpsampleUniforms.uHorizon, horizon);
+    m_ScreenTraingle.record(commands);
+}
+
+void LightScattering::recordSkyTemporal(GraphicsCommandList& commands, const GraphicsTexturePtr& fresh, const SkyTemporalFrame& temporal) noexcept
+{
+    const auto& desc = temporal.history->getGraphicsTextureDesc();
+    const glm::vec2 size(temporal.size);
+
+    commands.setPipelineState(MakeFullscreenState());
+    commands.setProgram(m_SkyTemporalShader);
+    commands.bindTexture(m_SkyTemporalUniforms.uTexFresh, fresh, 0);
+    commands.bindTexture(m_SkyTemporalUniforms.uTexHistory, temporal.history, 1);
+    commands.setUniform(m_SkyTemporalUniforms.uReprojection, temporal.reprojection);
+    commands.setUniform(m_SkyTemporalUniforms.uResolution, size);
+    commands.setUniform(m_SkyTemporalUniforms.uFreshSize, glm::vec2(temporal.freshSize));
+    commands.setUniform(m_SkyTemporalUniforms.uHistoryScale, size / glm::vec2(desc.getWidth(), desc.getHeight()));
+    commands.setUniform(m_SkyTemporalUniforms.uInterleave, glm::vec2(temporal.interleave));
+    commands.setUniform(m_SkyTemporalUniforms.uOffset, glm::vec2(temporal.offset));
+    m_ScreenTraingle.record(commands);
+}
+
+void LightScattering::beginSkyTemporal(const GraphicsTextureDesc& desc, const glm::ivec2& size, SkyTemporalFrame& temporal) noexcept
+{
+    // The history follows the sky image, a new size starts over
+    auto device = m_Device->downcast_pointer<OGLDevice>();
+    for (auto& history : m_SkyHistory)
+    {
+        if (history)
+        {
+            const auto& current = history->getGraphicsTextureDesc();
+            if (current.getWidth() == desc.getWidth() && current.getHeight() == desc.getHeight())
+                continue;
+            device->releaseTexture(history);
+        }
+        history = device->acquireTexture(desc);
+        m_bSkyHistoryValid = false;
+    }
+    // Scaled by the dynamic resolution, the pixels no longer match
+    if (size != m_SkyHistorySize)
+        m_bSkyHistoryValid = false;
+    m_SkyHistorySize = size;
+
+    temporal.size = size;
+    temporal.viewProj = m_Camera.getProjectionMatrix() * glm::mat4(glm::mat3(m_Camera.getViewMatrix()));
+    temporal.history = m_SkyHistory[m_SkyHistoryIndex ^ 1];
+    temporal.target = m_SkyHistory[m_SkyHistoryIndex];
+
+    // Without a history every pixel is drawn
+    if (m_bSkyHistoryValid)
+    {
+        const int32_t interleave = getSkyInterleave();
+        const int32_t index = int32_t(m_SkyTemporalIndex++ % uint32_t(interleave));
+        temporal.interleave = glm::ivec2(2, interleave / 2);
+        temporal.offset = glm::ivec2(index % 2, index / 2);
+        temporal.reprojection = m_SkyPrevViewProj * glm::inverse(temporal.viewProj);
+    }
+    temporal.freshSize = (size + temporal.interleave - 1) / temporal.interleave;
+
+    // Fresh pixel j lands on the center of pixel j*interleave + offset of the sky image
+    const glm::vec2 block(temporal.interleave);
+    const glm::vec2 span = block * glm::vec2(temporal.freshSize);
+    const glm::vec2 scale = glm::vec2(size) / span;
+    const glm::vec2 bias = scale - 1.f + 2.f * (block * 0.5f - glm::vec2(temporal.offset) - 0.5f) / span;
+    temporal.jitter = glm::mat4(1.f);
+    temporal.jitter[0][0] = scale.x;
+    temporal.jitter[1][1] = scale.y;
+    temporal.jitter[3][0] = bias.x;
+    temporal.jitter[3][1] = bias.y;
+}
+
+void LightScattering::endSkyTemporal(const SkyTemporalFrame& temporal) noexcept
+{
+    m_SkyPrevViewProj = temporal.viewProj;
+    m_SkyHistoryIndex ^= 1;
+    m_bSkyHistoryValid = true;
+    if (temporal.interleave == glm::ivec2(1))
+        m_SkyTemporalFrames = 0;
+    else if (m_SkyTemporalFrames > 0)
+        m_SkyTemporalFrames--;
+}
+
+bool LightScattering::isSkyRayMarched() const noexcept
+{
+    // The night sky is cheap and its stars are single pixels, the day-cycle table is a lookup
+    const auto& s = m_Settings;
+    return s.kModel == kTimeOfDay || (s.kModel == kNishita && !s.bSkyViewTable);
+}
+
+int32_t LightScattering::getSkyDownsample() const noexcept
+{
+    return isSkyRayMarched() ? m_Settings.skyDownsample : 1;
+}
+
+int32_t LightScattering::getSkyInterleave() const noexcept
+{
+    return isSkyRayMarched() ? m_Settings.skyInterleave : 1;
+}
+
+float LightScattering::getSkyScale() const noexcept
+{
+    return isSkyRayMarched() && m_Settings.bDynamicResolution ? m_DynamicResolution.getScale() : 1.f;
+}
+
+bool LightScattering::isSunSeparate() const noexcept
+{
+    // The full resolution pass would read the jittered projection of the temporal mode
+    const auto& s = m_Settings;
+    return getSkyDownsample() > 1 && getSkyInterleave() == 1 && s.kModel == kNishita && s.bSunDisk && s.bSunFullRes;
+}
+
+bool LightScattering::isNightFused() const noexcept
+{
+    return m_NightBenchmark.isRunning() ? m_NightBenchmark.isFused() : m_Settings.bNightFused;
+}
+
+// Only the variants the frame selects settle, the keys of the others follow the settings unused
+bool LightScattering::isSkyPending() const noexcept
+{
+    const auto& s = m_Settings;
+    // The CPU image doesn't wait on them, a request per frame would restart it
+    if (s.bCPU)
+        return false;
+    if (s.kModel == kNishita)
+        return (!s.bSkyViewTable && m_NishitaSky.isPending()) || (isSunSeparate() && m_SunDisc.isPending());
+    if (s.kModel == kTimeOfDay)
+        return m_TimeOfDay.isPending();
+    return isNightFused() && m_NightSky.isPending();
+}
+
+bool LightScattering::canFuseToneMap() const noexcept
+{
+    // The HDR image is kept for the cache, the upsampling, the temporal history and
+    // for layers blended over the sky; it must also be redrawn every frame
+    const auto& s = m_Settings;
+    if (!s.bFuseToneMap || !s.bProfile || s.bCPU)
+        return false;
+    if (getSkyDownsample() > 1 || getSkyInterleave() > 1 || getSkyScale() < 1.f)
+        return false;
+    if (s.kModel == kNishita)
+        return !s.bSkyViewTable;
+    if (s.kModel == kTimeOfNight)
+        return isNightFused() && (!s.bStarCatalogue || m_StarField.empty());
+    return true;
+}
+
+bool LightScattering::isSkyToneMapped() const noexcept
+{
+    // A variant still compiling falls back on one that may not tone map yet
+    if (!canFuseToneMap())
+        return false;
+    if (m_Settings.kModel == kNishita)
+        return m_NishitaSky.getSelectedOption(kNishitaToneMap) != 0;
+    if (m_Settings.kModel == kTimeOfDay)
+        return m_TimeOfDay.getSelectedOption(kTimeOfDayToneMap) != 0;
+    return m_NightSky.getSelectedOption(kNightSkyToneMap) != 0;
+}
+
+// Once per frame before the graph is built, whether the variant tone maps decides the passes
+void LightScattering::selectSkyPrograms() noexcept
+{
+    const auto& s = m_Settings;
+    if (s.kModel == kNishita && !s.bSkyViewTable)
+    {
+        ProgramShader& nishita = m_NishitaSky.select();
+        if (&nishita != m_NishitaProgram)
+        {
+            m_NishitaProgram = &nishita;
+            m_NishitaUniforms.resolve(nishita);
+        }
+    }
+    if (s.kModel == kTimeOfDay)
+    {
+        ProgramShader& timeOfDay = m_TimeOfDay.select();
+        if (&timeOfDay != m_TimeOfDayProgram)
+        {
+            m_TimeOfDayProgram = &timeOfDay;
+            m_TimeOfDayUniforms.resolve(timeOfDay);
+        }
+    }
+    if (s.kModel == kTimeOfNight && isNightFused())
+    {
+        ProgramShader& night = m_NightSky.select();
+        if (&night != m_NightSkyProgram)
+        {
+            m_NightSkyProgram = &night;
+            m_NightSkyUniforms.resolve(night);
+        }
+    }
+}
+
+// Bytes of color the night passes of one frame read and write, from the target size and format.
+// Only the moon sprite covers part of the screen, the catalogue points are the same in both modes
+double LightScattering::computeNightTraffic(bool bFused, bool bDirect) const noexcept
+{
+    const double pixels = double(getFrameWidth()) * getFrameHeight();
+    // The backbuffer is 8 bit RGBA
+    const double bpp = bDirect ? 4.0 : double(gli::block_size(m_SkyTarget.getTexture()->getGraphicsTextureDesc().getFormat()));
+    const bool bCatalogue = m_Settings.bStarCatalogue && !m_StarField.empty();
+
+    // The procedural stars only write, the passes blended over them also read
+    if (bFused)
+        return pixels * bpp * (bCatalogue ? 2.0 : 1.0);
+
+    // Moon.Vertex scales the sphere by 100 at 2000 away
+    double moonPixels = 0.0;
+    const glm::vec4 moon = m_Camera.getViewProjMatrix() * glm::vec4(-getMoonDirection(), 0.f);
+    if (moon.w > 0.f && glm::abs(moon.x) <= moon.w && glm::abs(moon.y) <= moon.w)
+    {
+        const double radius = glm::tan(glm::asin(100.0 / 2000.0)) / glm::tan(glm::radians(m_Settings.fov) * 0.5) * getFrameHeight() * 0.5;
+        moonPixels = glm::min(glm::pi<double>() * radius * radius, pixels);
+    }
+    const double stars = bCatalogue ? 0.0 : pixels;
+    return (stars + 2.0 * moonPixels + 2.0 * pixels) * bpp;
+}
+
+void LightScattering::updateNightBenchmark(bool bDirect) noexcept
+{
+    auto& bench = m_NightBenchmark;
+    const uint32_t mode = bench.isFused() ? 1 : 0;
+    if ((bench.frame - 1) % NightBenchmark::kFrames >= NightBenchmark::kSkipped)
+    {
+        for (const auto& timing : m_RenderGraph.getPassTimings())
+        {
+            if (timing.name == "Sky")
+            {
+                bench.total[mode] += timing.gpuTime;
+                bench.bytes[mode] += computeNightTraffic(mode == 1, bDirect);
+                bench.count[mode]++;
+            }
+        }
+    }
+    if (++bench.frame <= 2 * NightBenchmark::kFrames)
+        return;
+
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        bench.result[i] = bench.count[i] > 0 ? float(bench.total[i] / bench.count[i]) : 0.f;
+        bench.traffic[i] = bench.count[i] > 0 ? float(bench.bytes[i] / bench.count[i] / double(1 << 20)) : 0.f;
+    }
+    bench.frame = 0;
+    printf("LightScattering : night passes %.3f ms %.1f MB separate, %.3f ms %.1f MB fused.\n",
+        bench.result[0], bench.traffic[0], bench.result[1], bench.traffic[1]);
+}
+
 void LightScattering::render() noexcept
 {
-    bool bUpdate = m_Settings.bProfile || m_Settings.bUpdated;
+    // The night comparison measures the passes drawn every frame
+    const bool bBenchmark = m_NightBenchmark.isRunning() && m_Settings.kModel == kTimeOfNight;
+    bool bUpdate = m_Settings.bProfile || m_Settings.bUpdated || bBenchmark;
+
+    // Revisited settings bind the cached texture instead of rendering
+    uint64_t skyKey = 0;
+    bool bSkyCache = m_Settings.bSkyCache && !m_Settings.bProfile && !bBenchmark && !m_Settings.bCPU && computeSkyKey(skyKey);
+    if (!bSkyCache)
+        m_CachedSkyTex = nullptr;
+    else if (m_Settings.bUpdated)
+        m_CachedSkyTex = m_SkyCache.find(skyKey);
+
+    // Resources created since the last frame and the HUD bind behind the cache
+    auto device = m_Device->downcast_pointer<OGLDevice>();
+    device->invalidateState();
+    device->resetStateStats();
+
+    // Programs are selected and textures uploaded while recording, both stay on this thread
+    GraphicsCommandList& commands = m_CommandList;
+    commands.reset();
+    bool bSkyPass = false, bScattering = false;
 
     profiler::start(ProfilerTypeRender);
-    if (!m_Settings.bCPU && bUpdate)
-    {
-        // [Preetham99]
-        const glm::vec3 K = glm::vec3(0.686282f, 0.677739f, 0.663365f); // spectrum
-        const glm::vec3 lambda = glm::vec3(680e-9f, 550e-9f, 440e-9f);
-
-        auto& desc = m_ScreenColorTex->getGraphicsTextureDesc();
-        m_Device->setFramebuffer(m_ColorRenderTarget);
-        GLenum clearFlag = GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT;
-        glViewport(0, 0, desc.getWidth(), desc.getHeight());
-        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-        glClearDepthf(1.0f);
-        glClear(clearFlag);
-
-        // sky box
-        glDisable(GL_CULL_FACE);
-        glEnable(GL_DEPTH_TEST);
-        glDepthMask(GL_TRUE);
-
-        const float time = m_Timer.duration();
-        const float angle = glm::radians(m_Settings.angle);
-		glm::vec2 resolution(desc.getWidth(), desc.getHeight());
-        glm::vec3 sunDir = glm::vec3(0.0f, glm::cos(angle), -glm::sin(angle));
-        if (m_Settings.kModel == kNishita)
+    // The sky target outlives the frame, it is only redrawn on updates and read by the tone mapping after
+    RenderGraph& graph = m_RenderGraph;
+    RenderGraph::Resource backbuffer = graph.importBackbuffer(getFrameWidth(), getFrameHeight());
+    const GraphicsTexturePtr& skyTex = m_SkyTarget.getTexture();
+    RenderGraph::Resource skyColor = graph.import("SkyColor", skyTex, m_SkyTarget.getWidth(), m_SkyTarget.getHeight());
+    SkyTemporalFrame temporal;
+    const bool bTemporal = getSkyInterleave() > 1;
+    selectSkyPrograms();
+    const bool bDirect = bUpdate && isSkyToneMapped();
+    if (bDirect)
+    {
+        // Nothing else is drawn in HDR, the sky program tone maps into the backbuffer
+        graph.addPass("Sky",
+            [&](RenderGraph::Builder& builder) {
+                builder.write(backbuffer);
+            },
+            [this, &bScattering, &temporal](const RenderGraph::Resources&, GraphicsCommandList& commands) {
+                recordSkyPass(commands, temporal.jitter, bScattering);
+            });
+        bSkyPass = true;
+    }
+    else if (!m_Settings.bCPU && !m_CachedSkyTex && (bUpdate || bSkyCache || m_SkyTemporalFrames > 0))
+    {
+        // Reduced resolution targets follow the allocated size at the largest scale, they don't
+        // change while resizing or with the dynamic resolution, only their viewport does
+        const int32_t downsample = getSkyDownsample();
+        const auto& skyDesc = skyTex->getGraphicsTextureDesc();
+        GraphicsTextureDesc lowDesc;
+        lowDesc.setWidth((skyDesc.getWidth() + downsample - 1) / downsample);
+        lowDesc.setHeight((skyDesc.getHeight() + downsample - 1) / downsample);
+        lowDesc.setFormat(gli::FORMAT_RGBA16_SFLOAT_PACK16);
+        const glm::vec2 skySize(m_SkyTarget.getWidth(), m_SkyTarget.getHeight());
+        const glm::ivec2 lowSize = glm::max(glm::ivec2(glm::ceil(skySize * getSkyScale() / float(downsample))), glm::ivec2(1));
+        const bool bReduced = lowSize != glm::ivec2(skySize);
+
+        // Temporal mode draws one pixel of each block into a smaller target, the resolve fills in the others
+        GraphicsTextureDesc freshDesc = lowDesc;
+        glm::ivec2 freshSize = lowSize;
+        if (bTemporal)
         {
-            float turbidity = glm::exp(m_Settings.sunTurbidityParams.value());
-            glm::vec3 mie = ComputeCoefficientMie(lambda, K, turbidity);
-            glm::vec3 rayleigh = ComputeCoefficientRayleigh(lambda);
-
-            m_NishitaSkyShader.bind();
-            m_NishitaSkyShader.setUniform("uModelToProj", m_Camera.getViewProjMatrix());
-            m_NishitaSkyShader.setUniform("uChapman", m_Settings.bChapman);
-            m_NishitaSkyShader.setUniform("uEarthRadius", 6360e3f);
-            m_NishitaSkyShader.setUniform("uAtmosphereRadius", 6420e3f);
-            m_NishitaSkyShader.setUniform("uEarthCenter", glm::vec3(0.f));
-            m_NishitaSkyShader.setUniform("uSunDir", glm::normalize(sunDir));
-            m_NishitaSkyShader.setUniform("uAltitude", m_Settings.altitude*1e3f);
-            m_NishitaSkyShader.setUniform("uSunRadius", m_Settings.sunRaidusParams.value());
-            m_NishitaSkyShader.setUniform("uSunRadiance", m_Settings.sunRadianceParams.value());
-            m_NishitaSkyShader.setUniform("betaR0", rayleigh);
-            m_NishitaSkyShader.setUniform("betaM0", mie);
-            m_Sphere.draw();
+            beginSkyTemporal(lowDesc, lowSize, temporal);
+            freshDesc.setWidth((lowDesc.getWidth() + temporal.interleave.x - 1) / temporal.interleave.x);
+            freshDesc.setHeight((lowDesc.getHeight() + temporal.interleave.y - 1) / temporal.interleave.y);
+            freshSize = temporal.freshSize;
         }
-        if (m_Settings.kModel == kTimeOfDay)
+        GraphicsTextureDesc depthDesc = freshDesc;
+        depthDesc.setFormat(gli::FORMAT_D24_UNORM_S8_UINT_PACK32);
+
+        RenderGraph::Resource fresh = skyColor;
+        graph.addPass("Sky",
+            [&](RenderGraph::Builder& builder) {
+                if (bReduced || bTemporal)
+                    fresh = builder.create("SkyFresh", freshDesc, freshSize.x, freshSize.y);
+                builder.write(fresh);
+                builder.write(builder.create("SkyDepth", depthDesc, freshSize.x, freshSize.y));
+            },
+            [this, &bScattering, &temporal](const RenderGraph::Resources&, GraphicsCommandList& commands) {
+                recordSkyPass(commands, temporal.jitter, bScattering);
+            });
+        RenderGraph::Resource skyLow = fresh;
+        if (bTemporal)
         {
-            m_TimeOfDayShader.bind();
-            m_TimeOfDayShader.setUniform("uCameraPosition", m_Camera.getPosition());
-            m_TimeOfDayShader.setUniform("uModelToProj", m_Camera.getViewProjMatrix());
-            m_TimeOfDayShader.setUniform("uSunDir", glm::normalize(sunDir));
-            m_TimeOfDayShader.setUniform("uAltitude", m_Settings.altitude*1e3f);
-            m_TimeOfDayShader.setUniform("uCloudSpeed", m_Settings.cloudSpeedParams.value() * time);
-            m_TimeOfDayShader.setUniform("uCloudDensity", m_Settings.cloudDensityParams.value());
-            m_TimeOfDayShader.setUniform("uSunRadius", m_Settings.sunRaidusParams.value());
-			m_TimeOfDayShader.setUniform("uSunRadiance", m_Settings.sunRadianceParams.value());
-            m_TimeOfDayShader.setUniform("uTurbidity", m_Settings.sunTurbidity2Params.value());
-            m_TimeOfDayShader.bindTexture("uNoiseMapSamp", m_NoiseMapSamp, 0);
-            m_Sphere.draw();
+            RenderGraph::Resource history = graph.import("SkyHistory", temporal.history, lowSize.x, lowSize.y);
+            skyLow = graph.import("SkyResolved", temporal.target, lowSize.x, lowSize.y);
+            graph.addPass("SkyTemporal",
+                [&](RenderGraph::Builder& builder) {
+                    builder.read(fresh);
+                    builder.read(history);
+                    builder.write(skyLow);
+                    if (!bReduced)
+                        builder.write(skyColor);
+                },
+                [this, fresh, &temporal](const RenderGraph::Resources& resources, GraphicsCommandList& commands) {
+                    recordSkyTemporal(commands, resources.getTexture(fresh), temporal);
+                });
         }
-        if (m_Settings.kModel == kTimeOfNight)
+        if (bReduced)
+        {
+            graph.addPass("SkyUpsample",
+                [&](RenderGraph::Builder& builder) {
+                    builder.read(skyLow);
+                    builder.write(skyColor);
+                },
+                [this, skyLow, lowSize](const RenderGraph::Resources& resources, GraphicsCommandList& commands) {
+                    recordSkyUpsample(commands, resources.getTexture(skyLow), lowSize);
+                });
+        }
+        if (isSunSeparate())
         {
-            m_StarShader.bind();
-            m_StarShader.setUniform("uTime", time);
-            m_StarShader.setUniform("uCameraPosition", m_Camera.getPosition());
-            m_StarShader.setUniform("uModelToProj", m_Camera.getViewProjMatrix());
-            m_StarShader.setUniform("uSunDir", glm::normalize(sunDir));
-            m_StarShader.bindTexture("uMilkyWayMapSamp", m_MilkywaySamp, 0);
-            m_Sphere.draw();
-
-            glDisable(GL_DEPTH_TEST);
-            glDepthMask(GL_FALSE);
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
-
-            m_MoonShader.bind();
-            m_MoonShader.setUniform("uTime", time);
-            m_MoonShader.setUniform("uCameraPosition", m_Camera.getPosition());
-            m_MoonShader.setUniform("uModelToProj", m_Camera.getViewProjMatrix());
-            m_MoonShader.setUniform("uSunDirection", -glm::normalize(sunDir));
-            m_MoonShader.setUniform("uMoonBrightness", m_Settings.moonRadianceParams.ratio());
-            m_MoonShader.bindTexture("uMoonMapSamp", m_MoonMapSamp, 0);
-            m_Sphere.draw();
-
-            glBlendFunc(GL_ONE, GL_SRC_ALPHA);
-            m_TimeOfNightShader.bind();
-            m_TimeOfNightShader.setUniform("uCameraPosition", m_Camera.getPosition());
-            m_TimeOfNightShader.setUniform("uModelToProj", m_Camera.getViewProjMatrix());
-            m_TimeOfNightShader.setUniform("uSunDir", glm::normalize(sunDir));
-            m_TimeOfNightShader.setUniform("uTurbidity", m_Settings.moonTurbidityParams.value());
-            m_Sphere.draw();
-
-            glDisable(GL_BLEND);
-            glEnable(GL_DEPTH_TEST);
-            glDepthMask(GL_TRUE);
+            graph.addPass("SunDisc",
+                [&](RenderGraph::Builder& builder) {
+                    builder.write(skyColor);
+                },
+                [this](const RenderGraph::Resources&, GraphicsCommandList& commands) {
+                    recordSunDisc(commands);
+                });
         }
-		glEnable(GL_CULL_FACE);
+        bSkyPass = true;
     }
     // Tone mapping
+    if (!bDirect)
     {
-        GraphicsTexturePtr target = m_ScreenColorTex;
+        GraphicsTexturePtr target = skyTex;
         if (m_Settings.bCPU && m_SkyColorTex) 
             target = m_SkyColorTex;
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glViewport(0, 0, getFrameWidth(), getFrameHeight());
-
-        glDisable(GL_DEPTH_TEST);
-        m_PostProcessHDRShader.bind();
-        m_PostProcessHDRShader.bindTexture("uTexSource", target, 0);
-        m_ScreenTraingle.draw();
-        glEnable(GL_DEPTH_TEST);
+        else if (m_CachedSkyTex)
+            target = m_CachedSkyTex;
+        RenderGraph::Resource source = target == skyTex ? skyColor : graph.import("SkySource", target);
+        // The sky target is larger than the frame while the window is being resized
+        glm::vec2 scale = target == skyTex ? m_SkyTarget.getScale() : glm::vec2(1.f);
+
+        graph.addPass("Tonemap",
+            [&](RenderGraph::Builder& builder) {
+                builder.read(source);
+                builder.write(backbuffer);
+            },
+            [this, target, scale](const RenderGraph::Resources&, GraphicsCommandList& commands) {
+                commands.setPipelineState(MakeFullscreenState());
+                commands.setProgram(m_PostProcessHDRShader);
+                commands.setUniform(m_PostProcessHDRUniforms.uTexScale, scale);
+                commands.bindTexture(m_PostProcessHDRUniforms.uTexSource, target, 0);
+                m_ScreenTraingle.record(commands);
+            });
     }
+    graph.compile(*device);
+    graph.execute(*device, commands);
+    s_GraphStats = graph.getStats();
+    commands.execute(*device);
+    s_CommandStats = commands.getStats();
+
+    // The ring slots and the sky target are read by the commands just executed
+    if (bScattering)
+        m_ScatteringRing.fence();
+    if (bSkyPass)
+    {
+        m_FrameUniformRing.fence();
+        if (bTemporal)
+            endSkyTemporal(temporal);
+        if (m_Settings.bDynamicResolution && isSkyRayMarched())
+        {
+            // The timings are a few frames old, they are of a sky frame as long as the sky is redrawn
+            float skyTime = 0.f;
+            for (const auto& timing : m_RenderGraph.getPassTimings())
+            {
+                if (timing.name != "Tonemap")
+                    skyTime += timing.gpuTime;
+            }
+            m_DynamicResolution.update(skyTime);
+        }
+        if (bBenchmark)
+            updateNightBenchmark(bDirect);
+        // Images of an oversized target would be cropped when read back, temporal ones are partial until converged
+        if (bSkyCache && !m_Settings.bCameraMoving && m_SkyTarget.isSettled() && m_SkyTemporalFrames == 0)
+            m_CachedSkyTex = m_SkyCache.insert(skyKey, skyTex);
+    }
+    // The transients are retained by the commands until the next reset
+    m_RenderGraph.reset(*device);
     profiler::stop(ProfilerTypeRender);
     profiler::tick(ProfilerTypeRender, s_CpuTick, s_GpuTick);
+    s_StateStats = device->getStateStats();
 
 }
 
@@ -476,24 +1616,7 @@ void LightScattering::framesizeCallback(int32_t width, int32_t height) noexcept
 {
 	float aspectRatio = (float)width/height;
 	m_Camera.setProjectionParams(45.0f, aspectRatio, 0.1f, 10000.f);
-
-    GraphicsTextureDesc colorDesc;
-    colorDesc.setWidth(width);
-    colorDesc.setHeight(height);
-    colorDesc.setFormat(gli::FORMAT_RGBA16_SFLOAT_PACK16);
-    m_ScreenColorTex = m_Device->createTexture(colorDesc);
-
-    GraphicsTextureDesc depthDesc;
-    depthDesc.setWidth(width);
-    depthDesc.setHeight(height);
-    depthDesc.setFormat(gli::FORMAT_D24_UNORM_S8_UINT_PACK32);
-    auto depthTex = m_Device->createTexture(depthDesc);
-
-    GraphicsFramebufferDesc desc;  
-    desc.addComponent(GraphicsAttachmentBinding(m_ScreenColorTex, GL_COLOR_ATTACHMENT0));
-    desc.addComponent(GraphicsAttachmentBinding(depthTex, GL_DEPTH_ATTACHMENT));
-    
-    m_ColorRenderTarget = m_Device->createFramebuffer(desc);;
+    m_SkyTarget.resize(width, height);
 }
 
 void LightScattering::motionCallback(float xpos, float ypos, bool bPressed) noexcept
@@ -508,6 +1631,113 @@ void LightScattering::mouseCallback(float xpos, float ypos, bool bPressed) noexc
 	if (!mouseOverGui && bPressed) m_Camera.motionHandler(int(xpos), int(ypos), true); 
 }
 
+double LightScattering::getJulianDate() const noexcept
+{
+    const int* date = m_Settings.date;
+    return ComputeJulianDate(date[0], date[1], date[2], m_Settings.hours) + m_Timer.duration() / 86400.0;
+}
+
+glm::vec3 LightScattering::getSunDirection() const noexcept
+{
+    if (m_Settings.bEphemeris)
+        return ComputeSunDirection(getJulianDate(), m_Settings.latitude, m_Settings.longitude);
+
+    const float angle = glm::radians(m_Settings.angle);
+    return glm::vec3(0.0f, glm::cos(angle), -glm::sin(angle));
+}
+
+glm::vec3 LightScattering::getMoonDirection() const noexcept
+{
+    if (m_Settings.bEphemeris)
+        return ComputeMoonDirection(getJulianDate(), m_Settings.latitude, m_Settings.longitude);
+    return -getSunDirection();
+}
+
+bool LightScattering::computeSkyKey(uint64_t& key) const noexcept
+{
+    const auto& s = m_Settings;
+
+    SkyCacheKey hash;
+    hash.add(int32_t(s.bCPU));
+    hash.add(getFrameWidth());
+    hash.add(getFrameHeight());
+    hash.add(getSunDirection(), 1e-4f);
+    if (s.bCPU)
+    {
+        // The CPU path has its own fixed camera and atmosphere
+        key = hash.value();
+        return true;
+    }
+
+    // Animated skies can't be cached
+    if (s.kModel == kTimeOfNight)
+        return false;
+    if (s.kModel == kTimeOfDay && s.cloudSpeedParams.value() != 0.f)
+        return false;
+
+    hash.add(int32_t(s.kModel));
+    hash.add(m_Camera.getViewProjMatrix(), 1e-5f);
+    hash.add(m_Camera.getPosition(), 1e-3f);
+    hash.add(s.altitude, 1e-3f);
+    hash.add(s.sunRaidusParams.value(), 1e-2f);
+    hash.add(s.sunRadianceParams.value(), 1e-3f);
+    hash.add(getSkyDownsample());
+    hash.add(getSkyScale(), 1e-3f);
+    if (s.kModel == kNishita)
+    {
+        // A fallback variant is drawn meanwhile
+        if (m_NishitaSky.isPending() || (isSunSeparate() && m_SunDisc.isPending()))
+            return false;
+        hash.add(int32_t(m_NishitaSky.getKey()));
+        hash.add(int32_t(s.bSkyViewTable));
+        hash.add(s.sunTurbidityParams.value(), 1e-3f);
+    }
+    if (s.kModel == kTimeOfDay)
+    {
+        if (m_TimeOfDay.isPending())
+            return false;
+        hash.add(int32_t(m_TimeOfDay.getKey()));
+        hash.add(s.cloudDensityParams.value(), 1e-2f);
+        hash.add(s.sunTurbidity2Params.value(), 1e-3f);
+    }
+    key = hash.value();
+    return true;
+}
+
+void LightScattering::updatePermutations() noexcept
+{
+    const auto& s = m_Settings;
+    m_NishitaSky.setOption(kNishitaChapman, s.bChapman);
+    m_NishitaSky.setOption(kNishitaSun, s.bSunDisk && !isSunSeparate());
+    m_NishitaSky.setOption(kNishitaRayleighOnly, s.bRayleighOnly);
+    m_NishitaSky.setOption(kNishitaSamples, s.nishitaSamples);
+    m_TimeOfDay.setOption(kTimeOfDaySamples, s.atmSamples);
+    m_TimeOfDay.setOption(kTimeOfDayCloud, s.bCloud);
+    m_TimeOfDay.setOption(kTimeOfDayLimbDarkening, s.bLimbDarkening);
+    m_SunDisc.setOption(kSunDiscChapman, s.bChapman);
+    m_SunDisc.setOption(kSunDiscRayleighOnly, s.bRayleighOnly);
+    m_SunDisc.setOption(kSunDiscFullscreen, s.bSkyFullscreen);
+    m_NightSky.setOption(kNightSkyStars, !s.bStarCatalogue || m_StarField.empty());
+
+    // Depends on the model, the permutations of the others keep their key until they are drawn again
+    const bool bToneMap = canFuseToneMap();
+    if (s.kModel == kNishita)
+        m_NishitaSky.setOption(kNishitaToneMap, bToneMap);
+    else if (s.kModel == kTimeOfDay)
+        m_TimeOfDay.setOption(kTimeOfDayToneMap, bToneMap);
+    else
+        m_NightSky.setOption(kNightSkyToneMap, bToneMap);
+
+    m_NishitaSky.setOption(kNishitaFullscreen, s.bSkyFullscreen);
+    m_TimeOfDay.setOption(kTimeOfDayFullscreen, s.bSkyFullscreen);
+    m_NightSky.setOption(kNightSkyFullscreen, s.bSkyFullscreen);
+}
+
+void LightScattering::recordFrameUniforms(GraphicsCommandList& commands) const noexcept
+{
+    commands.bindBuffer("FrameUniforms", m_FrameUniformRing.getData(), m_FrameUniformRing.getOffset(), m_FrameUniformRing.getSize());
+}
+
 GraphicsDevicePtr LightScattering::createDevice(const GraphicsDeviceDesc& desc) noexcept
 {
 	GraphicsDeviceType deviceType = desc.getDeviceType();
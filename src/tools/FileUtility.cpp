@@ -2,6 +2,24 @@
 #include <tools/FileUtility.h>
 #include <zlib.h>
 #include <algorithm>
+#include <limits>
+#include <cstring>
+
+#ifdef _WIN32
+// std::min, std::max and numeric_limits<>::max() below would expand the macros
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+#include <sys/stat.h>
 
 using namespace util;
 
@@ -37,6 +55,33 @@ namespace util
         return true;
     }
 
+    bool MakeDirectory(const std::string& path)
+    {
+#ifdef _WIN32
+        if (CreateDirectoryA(path.c_str(), nullptr))
+            return true;
+        return GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+        if (mkdir(path.c_str(), 0755) == 0)
+            return true;
+        struct stat info;
+        return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+    }
+
+    FileStamp GetFileStamp(const std::string& fileName)
+    {
+        struct stat info;
+        if (stat(fileName.c_str(), &info) != 0)
+            return FileStamp{ 0, -1 };
+#ifdef __linux__
+        // Two saves within a second are still told apart
+        return FileStamp{ int64_t(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec, int64_t(info.st_size) };
+#else
+        return FileStamp{ int64_t(info.st_mtime), int64_t(info.st_size) };
+#endif
+    }
+
     BytesArray inflate(const BytesArray& compressedSource, int32_t& errnum, std::uint32_t chunkSize = 0x100000)
     {
         // Create a dynamic buffer to hold compressed blocks
@@ -158,6 +203,108 @@ namespace util
         return WriteFileSync(fileName, compressed);
     }
 
+#ifdef _WIN32
+    MappedFile::MappedFile() noexcept :
+        m_File(INVALID_HANDLE_VALUE),
+        m_Mapping(nullptr),
+        m_Data(nullptr),
+        m_Size(0)
+    {
+    }
+
+    bool MappedFile::open(const std::string& fileName) noexcept
+    {
+        close();
+
+        m_File = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+        if (m_File == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(m_File, &size) || size.QuadPart == 0)
+        {
+            close();
+            return false;
+        }
+        m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (m_Mapping == nullptr)
+        {
+            close();
+            return false;
+        }
+        m_Data = static_cast<const char*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+        if (m_Data == nullptr)
+        {
+            close();
+            return false;
+        }
+        m_Size = static_cast<size_t>(size.QuadPart);
+        return true;
+    }
+
+    void MappedFile::close() noexcept
+    {
+        if (m_Data != nullptr)
+            UnmapViewOfFile(m_Data);
+        if (m_Mapping != nullptr)
+            CloseHandle(m_Mapping);
+        if (m_File != INVALID_HANDLE_VALUE)
+            CloseHandle(m_File);
+        m_File = INVALID_HANDLE_VALUE;
+        m_Mapping = nullptr;
+        m_Data = nullptr;
+        m_Size = 0;
+    }
+#else
+    MappedFile::MappedFile() noexcept :
+        m_File(-1),
+        m_Data(nullptr),
+        m_Size(0)
+    {
+    }
+
+    bool MappedFile::open(const std::string& fileName) noexcept
+    {
+        close();
+
+        m_File = ::open(fileName.c_str(), O_RDONLY);
+        if (m_File < 0)
+            return false;
+
+        struct stat status;
+        if (fstat(m_File, &status) != 0 || status.st_size == 0)
+        {
+            close();
+            return false;
+        }
+        void* data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, m_File, 0);
+        if (data == MAP_FAILED)
+        {
+            close();
+            return false;
+        }
+        m_Data = static_cast<const char*>(data);
+        m_Size = static_cast<size_t>(status.st_size);
+        return true;
+    }
+
+    void MappedFile::close() noexcept
+    {
+        if (m_Data != nullptr)
+            munmap(const_cast<char*>(m_Data), m_Size);
+        if (m_File >= 0)
+            ::close(m_File);
+        m_File = -1;
+        m_Data = nullptr;
+        m_Size = 0;
+    }
+#endif
+
+    MappedFile::~MappedFile() noexcept
+    {
+        close();
+    }
+
     uint32_t ReadUint(bufferstream& is)
     {
         uint32_t t;
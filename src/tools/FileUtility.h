@@ -8,6 +8,7 @@
 #include <iostream>
 #include <sstream>
 #include <streambuf>
+#include <cstdint>
 
 namespace util
 {
@@ -41,12 +42,56 @@ namespace util
     extern BytesArray NullFile;
 
     // Reads the entire contents of a binary file.  
-    BytesArray ReadFileSync(const std::string& fileName, std::ios_base::openmode mode = 0);
+    BytesArray ReadFileSync(const std::string& fileName, std::ios_base::openmode mode = std::ios_base::openmode());
     bool WriteFileSync(const std::string& fileName, const BytesArray& plainSource);
 
+    // Create a single directory level, true if it exists afterwards
+    bool MakeDirectory(const std::string& path);
+
+    // Modification time and size of a file, to tell whether it changed
+    struct FileStamp
+    {
+        int64_t mtime;  // nanoseconds on Linux, seconds elsewhere
+        int64_t size;   // -1 if the file doesn't exist
+
+        bool operator==(const FileStamp& other) const { return mtime == other.mtime && size == other.size; }
+        bool operator!=(const FileStamp& other) const { return !(*this == other); }
+    };
+
+    FileStamp GetFileStamp(const std::string& fileName);
+
     BytesArray DecompressFile(const std::string& fileName);
     bool CompressFile(const std::string& fileName, const BytesArray& plainSource);
 
+    // Read only memory mapping of a file, pages are loaded on first access
+    class MappedFile
+    {
+    public:
+        MappedFile() noexcept;
+        ~MappedFile() noexcept;
+
+        bool open(const std::string& fileName) noexcept;
+        void close() noexcept;
+
+        bool isOpen() const noexcept { return m_Data != nullptr; }
+        const char* data() const noexcept { return m_Data; }
+        size_t size() const noexcept { return m_Size; }
+
+    private:
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+#ifdef _WIN32
+        void* m_File;
+        void* m_Mapping;
+#else
+        int m_File;
+#endif
+        const char* m_Data;
+        size_t m_Size;
+    };
+
     template <typename T, typename R>
     void Read(std::basic_istream<T, std::char_traits<T>>& is, R& t, uint32_t size)
     {
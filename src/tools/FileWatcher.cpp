@@ -0,0 +1,128 @@
+#include "FileWatcher.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace util
+{
+    namespace
+    {
+        const std::chrono::milliseconds kStatInterval(500);
+
+        std::string GetDirectory(const std::string& path)
+        {
+            size_t slash = path.find_last_of("/\\");
+            return slash == std::string::npos ? std::string(".") : path.substr(0, slash);
+        }
+    }
+
+    FileWatcher::FileWatcher() noexcept :
+        m_LastPoll(std::chrono::steady_clock::now()),
+        m_Notify(-1)
+    {
+#ifdef __linux__
+        m_Notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (m_Notify < 0)
+            printf("FileWatcher : inotify unavailable, polling instead.\n");
+#endif
+    }
+
+    FileWatcher::~FileWatcher() noexcept
+    {
+#ifdef __linux__
+        if (m_Notify >= 0)
+            close(m_Notify);
+#endif
+    }
+
+    bool FileWatcher::addFile(const std::string& path) noexcept
+    {
+        if (m_Files.count(path))
+            return true;
+        m_Files[path] = GetFileStamp(path);
+
+#ifdef __linux__
+        if (m_Notify >= 0)
+        {
+            // Editors often save by renaming a new file over the old one, watch the directory
+            std::string directory = GetDirectory(path);
+            int wd = inotify_add_watch(m_Notify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+            if (wd < 0)
+            {
+                printf("FileWatcher : can't watch \"%s\".\n", directory.c_str());
+                return false;
+            }
+            m_Directories.emplace(wd, directory);
+        }
+#endif
+        return true;
+    }
+
+    void FileWatcher::poll(std::vector<std::string>& changed) noexcept
+    {
+        const size_t first = changed.size();
+        if (m_Notify >= 0)
+            pollNotify(changed);
+        else
+            pollStat(changed);
+
+        std::sort(changed.begin() + first, changed.end());
+        changed.erase(std::unique(changed.begin() + first, changed.end()), changed.end());
+    }
+
+    void FileWatcher::pollNotify(std::vector<std::string>& changed) noexcept
+    {
+#ifdef __linux__
+        alignas(inotify_event) char buffer[4096];
+        for (;;)
+        {
+            ssize_t length = read(m_Notify, buffer, sizeof(buffer));
+            if (length <= 0)
+                break;
+
+            for (ssize_t offset = 0; offset < length; )
+            {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+                offset += sizeof(inotify_event) + event->len;
+
+                auto directory = m_Directories.find(event->wd);
+                if (directory == m_Directories.end() || event->len == 0)
+                    continue;
+
+                // Other files in the directory are not ours
+                std::string path = directory->second + "/" + event->name;
+                auto file = m_Files.find(path);
+                if (file == m_Files.end())
+                    continue;
+                file->second = GetFileStamp(path);
+                changed.push_back(path);
+            }
+        }
+#endif
+    }
+
+    void FileWatcher::pollStat(std::vector<std::string>& changed) noexcept
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (now - m_LastPoll < kStatInterval)
+            return;
+        m_LastPoll = now;
+
+        for (auto& file : m_Files)
+        {
+            FileStamp stamp = GetFileStamp(file.first);
+            if (stamp == file.second)
+                continue;
+            file.second = stamp;
+            // Deleted files come back as a change once saved again
+            if (stamp.size >= 0)
+                changed.push_back(file.first);
+        }
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+#include <tools/FileUtility.h>
+
+namespace util
+{
+    // Reports files modified since the last poll.
+    // Linux watches the parent directories with inotify, elsewhere
+    // (or if inotify is unavailable) the files are stat'ed every half second
+    class FileWatcher
+    {
+    public:
+        FileWatcher() noexcept;
+        ~FileWatcher() noexcept;
+
+        bool addFile(const std::string& path) noexcept;
+
+        // Appends each modified file once, as spelled in addFile
+        void poll(std::vector<std::string>& changed) noexcept;
+
+        bool isNotified() const noexcept { return m_Notify >= 0; }
+
+    private:
+
+        FileWatcher(const FileWatcher&) = delete;
+        FileWatcher& operator=(const FileWatcher&) = delete;
+
+        void pollNotify(std::vector<std::string>& changed) noexcept;
+        void pollStat(std::vector<std::string>& changed) noexcept;
+
+        std::unordered_map<std::string, FileStamp> m_Files;
+        std::unordered_map<int, std::string> m_Directories;  // by inotify watch descriptor
+        std::chrono::steady_clock::time_point m_LastPoll;
+        int m_Notify;
+    };
+}
@@ -0,0 +1,146 @@
+// Flattens shader stages at build time into the blob read by ProgramShader::loadShaderBlob,
+// resolving glsw sections and files and expanding includes the same way the runtime does.
+// With -v every flattened stage is also compiled by glslangValidator.
+//
+// ShaderFlatten -o <blob> -d <#version directive> [-v <glslangValidator> -t <directory>] <tag>...
+// Run from the directory holding "shaders/"
+
+#include <GLType/ProgramManager.h>
+#include <GLType/ShaderBlob.h>
+#include <tools/FileUtility.h>
+#include <glsw/glsw.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // Same lookup as ProgramShader::preprocess
+    bool LoadShader(const std::string& tag, std::string& content, std::vector<std::string>& dependencies)
+    {
+        util::BytesArray source = util::ReadFileSync("./shaders/" + tag);
+        if (source != util::NullFile)
+        {
+            content.assign(source->data(), source->size());
+            dependencies.push_back("./shaders/" + tag);
+            return true;
+        }
+
+        const char* section = glswGetShader(tag.c_str());
+        if (!section)
+        {
+            fprintf(stderr, "ShaderFlatten : shader \"%s\" not found.\n", tag.c_str());
+            return false;
+        }
+        content = section;
+        dependencies.push_back("./shaders/" + tag.substr(0, tag.find('.')) + ".glsl");
+        return true;
+    }
+
+    const char* GetStageExtension(const std::string& tag)
+    {
+        const std::string stage = tag.substr(tag.find_last_of('.') + 1);
+        if (stage == "Vertex") return "vert";
+        if (stage == "Fragment") return "frag";
+        if (stage == "Geometry") return "geom";
+        if (stage == "Compute") return "comp";
+        return nullptr;
+    }
+
+    bool Validate(const std::string& validator, const std::string& directory, const std::string& tag, const std::string& source)
+    {
+        const char* extension = GetStageExtension(tag);
+        if (!extension)
+        {
+            fprintf(stderr, "ShaderFlatten : unknown stage of \"%s\", not validated.\n", tag.c_str());
+            return true;
+        }
+
+        std::string name = tag;
+        for (auto& c : name)
+        {
+            if (c == '/' || c == '\\' || c == ' ')
+                c = '_';
+        }
+        const std::string path = directory + "/" + name + "." + extension;
+        auto data = std::make_shared<util::FileContainer>(source.begin(), source.end());
+        if (!util::WriteFileSync(path, data))
+        {
+            fprintf(stderr, "ShaderFlatten : can't write \"%s\".\n", path.c_str());
+            return false;
+        }
+
+        const std::string command = "\"" + validator + "\" \"" + path + "\"";
+        if (std::system(command.c_str()) != 0)
+        {
+            fprintf(stderr, "ShaderFlatten : \"%s\" failed validation.\n", tag.c_str());
+            return false;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::string output, directive, validator, directory;
+    std::vector<std::string> tags;
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if (arg == "-o" && i + 1 < argc) output = argv[++i];
+        else if (arg == "-d" && i + 1 < argc) directive = argv[++i];
+        else if (arg == "-v" && i + 1 < argc) validator = argv[++i];
+        else if (arg == "-t" && i + 1 < argc) directory = argv[++i];
+        else tags.push_back(arg);
+    }
+    if (output.empty() || directive.empty() || tags.empty() || (!validator.empty() && directory.empty()))
+    {
+        fprintf(stderr, "usage : ShaderFlatten -o <blob> -d <#version directive> [-v <glslangValidator> -t <directory>] <tag>...\n");
+        return EXIT_FAILURE;
+    }
+
+    // As set up by GameCore
+    glswInit();
+    glswSetPath("./shaders/", ".glsl");
+    glswAddDirectiveToken("*", directive.c_str());
+
+    if (!directory.empty())
+        util::MakeDirectory(directory);
+
+    ShaderBlob blob;
+    int failures = 0;
+    for (const auto& tag : tags)
+    {
+        std::string content;
+        std::vector<std::string> dependencies;
+        if (!LoadShader(tag, content, dependencies))
+        {
+            failures++;
+            continue;
+        }
+
+        static const nv_helpers_gl::IncludeRegistry includes;
+        static const std::vector<std::string> directories = { ".", "./shaders" };
+        std::string source = nv_helpers_gl::manualInclude(tag, content, "", directories, includes, &dependencies);
+
+        if (!validator.empty() && !Validate(validator, directory, tag, source))
+        {
+            failures++;
+            continue;
+        }
+        blob.add(tag, source, dependencies);
+    }
+    glswShutdown();
+
+    if (failures > 0)
+        return EXIT_FAILURE;
+
+    if (!blob.write(output))
+    {
+        fprintf(stderr, "ShaderFlatten : can't write \"%s\".\n", output.c_str());
+        return EXIT_FAILURE;
+    }
+    printf("ShaderFlatten : %u stages flattened to \"%s\".\n", uint32_t(blob.size()), output.c_str());
+    return EXIT_SUCCESS;
+}
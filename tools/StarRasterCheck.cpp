@@ -0,0 +1,85 @@
+// Headless check of StarCatalogue::rasterize, the CPU reference of the StarField shaders.
+// Single stars are rasterized looking up at the zenith and their sprites compared with the
+// model of computeStarIntensity and computeStarSize: the center value, the footprint radius
+// and the horizon cut. Returns non-zero on a mismatch
+//
+// StarRasterCheck
+
+#include <StarCatalogue.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+    const int kSize = 65;       // odd, the zenith projects on the center of the middle pixel
+    const int kCenter = kSize / 2;
+
+    std::vector<glm::vec4> Rasterize(const glm::vec3& direction, float magnitude)
+    {
+        StarEntry star;
+        star.direction = direction;
+        star.magnitude = magnitude;
+        star.color = glm::u8vec4(255);
+
+        StarCatalogue catalogue;
+        catalogue.setStars({ star });
+
+        const glm::mat4 proj = glm::perspective(glm::radians(60.f), 1.f, 0.1f, 100.f);
+        const glm::mat4 view = glm::lookAt(glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f), glm::vec3(0.f, 0.f, -1.f));
+        std::vector<glm::vec4> image(kSize * kSize, glm::vec4(0.f));
+        catalogue.rasterize(image, kSize, kSize, proj * view, glm::mat3(1.f));
+        return image;
+    }
+
+    bool Check(bool bCondition, const char* what, int& failures)
+    {
+        if (!bCondition)
+        {
+            fprintf(stderr, "StarRasterCheck : %s.\n", what);
+            failures++;
+        }
+        return bCondition;
+    }
+}
+
+int main()
+{
+    int failures = 0;
+    const glm::vec3 zenith(0.f, 1.f, 0.f);
+
+    for (float magnitude : { -1.f, 2.f, 5.f })
+    {
+        const auto image = Rasterize(zenith, magnitude);
+        const float intensity = StarCatalogue::computeStarIntensity(magnitude);
+        const float size = StarCatalogue::computeStarSize(magnitude);
+
+        // No fade at the zenith and the sprite peak at its center
+        const float center = image[kCenter * kSize + kCenter].r;
+        Check(std::abs(center - intensity) <= 1e-4f * intensity, "center of the sprite differs from computeStarIntensity", failures);
+
+        // Lit up to the sprite radius along the row, dark after it
+        const int inside = int(std::floor(size));
+        Check(image[kCenter * kSize + kCenter + inside].r > 0.f, "sprite narrower than computeStarSize", failures);
+        Check(image[kCenter * kSize + kCenter + inside + 1].r == 0.f, "sprite wider than computeStarSize", failures);
+        Check(image[kCenter * kSize + kCenter + inside].r < center, "sprite not falling off from its center", failures);
+    }
+
+    // Brighter by the ratio of the sprite model
+    const float ratio = Rasterize(zenith, 0.f)[kCenter * kSize + kCenter].r / Rasterize(zenith, 5.f)[kCenter * kSize + kCenter].r;
+    const float expected = StarCatalogue::computeStarIntensity(0.f) / StarCatalogue::computeStarIntensity(5.f);
+    Check(std::abs(ratio - expected) <= 1e-3f * expected, "magnitude ratio differs from computeStarIntensity", failures);
+
+    // Nothing below the horizon
+    for (const auto& pixel : Rasterize(glm::vec3(0.f, -1.f, 0.f), 0.f))
+    {
+        if (!Check(pixel.r == 0.f, "star below the horizon rasterized", failures))
+            break;
+    }
+
+    if (failures == 0)
+        printf("StarRasterCheck : passed.\n");
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}